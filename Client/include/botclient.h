@@ -0,0 +1,56 @@
+#ifndef BOTCLIENT_H
+#define BOTCLIENT_H
+
+#include "client.h"
+#include <chrono>
+#include <functional>
+
+/// Headless session driven by the load generator, nothing is printed and nothing waits for input.
+/// The text it sends starts with its send time, so whoever receives it can tell the delivery latency.
+class BotClient : public Client
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using LatencyCallback = std::function<void(const Clock::duration&)>;
+
+    /// l_onLatency is called for every timestamped message this bot receives
+    BotClient(const LatencyCallback& l_onLatency);
+
+    void onInitialization() {}
+    /// l_size bytes of text, at least the timestamp. False when the connection did not take it
+    bool sendTimestamped(const size_t& l_size);
+    /// the bots always connect over tcp
+    sf::SocketHandle getHandle() const { return SocketHandleAccess::get(*m_client.m_connection->getSocket()); }
+    /// false after the server kicked the bot or went away
+    bool isAlive() const { return m_alive; }
+private:
+    LatencyCallback m_onLatency;
+    bool m_alive;
+protected:
+    std::string onServerPasswordNeeded() { return ""; }
+
+    void onSuccessfullyConnected() {}
+    void onErrorWithSendingData() { m_alive = false; }
+    void onErrorWithReceivingData() { m_alive = false; }
+    void onDisconnected() { m_alive = false; }
+    void onServerWrongPassword() {}
+    void onArgumentsError(const char*) {}
+    void onUnableToConnect() {}
+    void onServerIsFull() {}
+    void onBlockedFromServer() {}
+    void onError(const std::string&) {}
+
+    void onMessageReceived(std::string_view l_message, std::string_view, const ClientType&);
+    void onServerMessageReceived(std::string_view) {}
+    void onKick() { m_alive = false; }
+    void onPromotion(const std::string&, const bool&) {}
+    void onConnectionNotificationReceived(std::string_view, const Type&) {}
+    void onServerExit() { m_alive = false; }
+    void onChannelJoined(std::string_view, const sf::Uint32&) {}
+    void onChannelLeft(std::string_view) {}
+    void onChannelMessageReceived(std::string_view, std::string_view l_message, std::string_view, const ClientType&) { onMessageReceived(l_message, {}, ClientType::Normie); }
+    void onDirectMessageReceived(std::string_view l_message, std::string_view, const ClientType&) { onMessageReceived(l_message, {}, ClientType::Normie); }
+    void onUnknownRecipient(std::string_view) {}
+};
+
+#endif // BOTCLIENT_H
@@ -3,13 +3,33 @@
 
 #include <SFML/Network.hpp>
 #include "../../Shared/shared.h"
+#include "../../Shared/messages.h"
 #include <string>
 #include <unordered_map>
-#include <functional>
+#include <unordered_set>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
 
 enum class Status { ServerIsFull, Connected, WrongPassword, UnableToConnect, Blocked};
 
-using Responses = std::unordered_map<Type, std::function<void(sf::Packet&)>>;
+/// other clients as announced by a protocol v2 server, keyed by their sender id
+struct Member{
+    std::string m_name;
+    ClientType m_type;
+};
+using Members = std::unordered_map<sf::Uint32, Member>;
+
+/// a v2 message whose sender the client has asked the server about, named once the answer comes
+struct HeldMessage{
+    sf::Uint32 m_id;
+    std::string m_text;
+    bool m_named;
+    Member m_sender;
+};
 
 class Client
 {
@@ -23,29 +43,86 @@ public:
     void setPort(const sf::Uint16& l_port) { m_serverPort = l_port; }
     void setIp(const sf::IpAddress& l_ip) { m_serverIp = l_ip; }
     void setNickname(const std::string& l_nick) { m_client.m_name = l_nick; }
+    /// newest protocol asked for while connecting, the server may answer with an older one
+    void setProtocol(const Protocol& l_protocol) { m_requestedProtocol = l_protocol; }
+    /// how connect() reaches the server, a TcpTransport unless replaced
+    void setTransport(const std::shared_ptr<Transport>& l_transport) { m_transport = l_transport; }
+    /// how many connects run() tries in a row after losing the server, 0 gives up right away
+    void setReconnect(const sf::Uint32& l_attempts) { m_reconnectAttempts = l_attempts; }
+    /// the n-th retry waits a random time below min(l_base * 2^n, l_max)
+    void setReconnectBackoff(const std::chrono::milliseconds& l_base, const std::chrono::milliseconds& l_max) { m_backoffBase = l_base; m_backoffMax = l_max; }
 
     ///GETTERS
     sf::Uint16 getPort() { return m_serverPort; }
     sf::IpAddress getIp() { return m_serverIp; }
     std::string getNickname() { return m_client.m_name; }
     ClientType getType() { return m_client.m_type; }
+    Protocol getProtocol() { return m_protocol; }
+    sf::Uint32 getReconnect() { return m_reconnectAttempts; }
 
     /// MAIN
     Status establishConnection();
+    /// receives and sends until quit(), reconnecting as set by setReconnect()
     virtual int run();
+    /// may be called from any thread
     void quit();
+    /// For drivers that wait for the socket themselves instead of run(), after setBlocking(false):
+    /// handles every packet already received, false once the connection is gone
+    bool receiveFromServer();
+    /// sends what is queued as far as the socket takes it, false once the connection failed
+    bool flushToServer() { return flushOutbound(); }
+    /// sends are queued, the driver waits for writability before flushToServer()
+    bool hasPendingOutput();
+    void setBlocking(const bool& l_blocking) { m_client.m_connection->setBlocking(l_blocking); }
 
     Status connect(const std::string& l_password = "");
     Status connect(const sf::Uint16& l_port, const sf::IpAddress& l_ip, const std::string& l_password = "");
     void sendToServer(const std::string& l_text);
+    void joinChannel(const std::string& l_channel);
+    void leaveChannel(const std::string& l_channel);
+    void sendToChannel(const std::string& l_channel, const std::string& l_text);
+    void sendDirectMessage(const std::string& l_recipient, const std::string& l_text);
 private:
-    Responses m_responses;
-    void unpack(sf::Packet& l_packet);
+    Members m_members;
+    // messages queued behind an unanswered Opcode::Member lookup, delivered in arrival order
+    std::deque<HeldMessage> m_held;
+    std::unordered_set<sf::Uint32> m_lookups;
+    Protocol m_requestedProtocol;
+    std::shared_ptr<Transport> m_transport;
+    std::atomic<Protocol> m_protocol;
+    sf::Uint32 m_sessionId;
+    std::string m_password;
+    sf::Uint32 m_reconnectAttempts;
+    std::chrono::milliseconds m_backoffBase;
+    std::chrono::milliseconds m_backoffMax;
+    std::mt19937 m_random;
+
+    // frames waiting for run() to send them, written to directly while it is not running
+    std::mutex m_outboundMutex;
+    std::vector<char> m_outbound;
+    std::size_t m_outboundOffset;
+    bool m_looping;
+    sf::SocketSelector m_selector;
+    sf::UdpSocket m_waker;
+    std::atomic<bool> m_wakePending;
+
+    void unpackCompact(PacketReader& l_packet);
+    void deliver(std::string_view l_message, const Member* l_sender);
+    void releaseHeld();
     bool sendClientDataToServer();
+    bool sendFrame(const Frame& l_frame);
+    /// sends what the queue holds without blocking, false when the connection failed
+    bool flushOutbound();
+    /// handles everything already received, false once the connection is gone
+    bool receiveAll();
+    void watchConnection();
+    void waitForEvents(const sf::Time& l_timeout);
+    void wakeUp();
+    bool reconnect();
 protected:
     ClientData m_client;
     Shared m_shared;
-    bool m_running;
+    std::atomic<bool> m_running;
     sf::Uint16 m_serverPort;
     sf::IpAddress m_serverIp;
     const std::string m_version;
@@ -53,6 +130,8 @@ protected:
     Status checkPassword(const std::string& l_password);
 
     bool sendToServer(sf::Packet& l_packet);
+    /// hands a received packet to its response
+    void unpack(sf::Packet& l_packet);
 
 public:
     virtual void onInitialization() = 0;
@@ -70,21 +149,42 @@ protected:
     virtual std::string onServerPasswordNeeded() = 0;
 
 
-    virtual void onMessageReceived(const std::string& l_message, const std::string& l_name, const ClientType& l_type) = 0;
-    virtual void onServerMessageReceived(const std::string&) = 0;
+    /// text arguments are views into the received packet, valid only during the call
+    virtual void onMessageReceived(std::string_view l_message, std::string_view l_name, const ClientType& l_type) = 0;
+    virtual void onServerMessageReceived(std::string_view) = 0;
     virtual void onKick() = 0;
     virtual void onPromotion(const std::string& l_text, const bool& l_promotion) = 0;
-    virtual void onConnectionNotificationReceived(const std::string&, const Type&) = 0;
+    virtual void onConnectionNotificationReceived(std::string_view, const Type&) = 0;
     virtual void onServerExit() = 0;
-
-    /// RESPONSES
-    void message(sf::Packet& l_packet);
-    void serverMessage(sf::Packet& l_packet);
-    void kick(sf::Packet& l_packet);
-    void promotion(sf::Packet& l_packet);
-    void somebodyPromotion(sf::Packet& l_packet);
-    void connectionNotification(sf::Packet& l_packet);
-    void serverExit(sf::Packet& l_packet);
+    virtual void onChannelJoined(std::string_view l_channel, const sf::Uint32& l_members) = 0;
+    virtual void onChannelLeft(std::string_view l_channel) = 0;
+    virtual void onChannelMessageReceived(std::string_view l_channel, std::string_view l_message, std::string_view l_name, const ClientType& l_type) = 0;
+    virtual void onDirectMessageReceived(std::string_view l_message, std::string_view l_name, const ClientType& l_type) = 0;
+    virtual void onUnknownRecipient(std::string_view l_name) = 0;
+
+    /// RESPONSES, called by dispatchToClient()
+    template <class Handler>
+    friend bool dispatchToClient(PacketReader& l_reader, Handler& l_handler);
+    /// whatever the schema sends to clients but a logged in client does not expect
+    template <class T>
+    void on(const T&) { onError("Unknown message received from server"); }
+    void on(const toClient::Message& l_message);
+    void on(const toClient::ServerMessage& l_message);
+    void on(const toClient::Kick& l_message);
+    void on(const toClient::Connection& l_message);
+    void on(const toClient::Promotion& l_message);
+    void on(const toClient::SomebodyPromotion& l_message);
+    void on(const toClient::ServerExit& l_message);
+    void on(const toClient::JoinChannel& l_message);
+    void on(const toClient::LeaveChannel& l_message);
+    void on(const toClient::ChannelMessage& l_message);
+    void on(const toClient::DirectMessage& l_message);
+    void on(const toClient::UnknownRecipient& l_message);
+    void welcome(PacketReader& l_packet);
+    void compactMessage(PacketReader& l_packet);
+    void compactServerMessage(PacketReader& l_packet);
+    void notice(PacketReader& l_packet);
+    void member(PacketReader& l_packet);
 };
 
 #endif // CLIENT_H
@@ -33,12 +33,17 @@ protected:
     void onError(const std::string &l_text);
 
 
-    void onMessageReceived(const std::string&, const std::string&, const ClientType& l_type);
-    void onServerMessageReceived(const std::string&);
+    void onMessageReceived(std::string_view, std::string_view, const ClientType& l_type);
+    void onServerMessageReceived(std::string_view);
     void onKick();
     void onPromotion(const std::string& l_text, const bool& l_promotion);
-    void onConnectionNotificationReceived(const std::string&, const Type&);
+    void onConnectionNotificationReceived(std::string_view, const Type&);
     void onServerExit();
+    void onChannelJoined(std::string_view l_channel, const sf::Uint32& l_members);
+    void onChannelLeft(std::string_view l_channel);
+    void onChannelMessageReceived(std::string_view l_channel, std::string_view l_message, std::string_view l_name, const ClientType& l_type);
+    void onDirectMessageReceived(std::string_view l_message, std::string_view l_name, const ClientType& l_type);
+    void onUnknownRecipient(std::string_view l_name);
 };
 
 #endif // CONSOLECLIENT_H
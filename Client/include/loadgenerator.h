@@ -0,0 +1,94 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include "botclient.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class SizeDistribution { Fixed, Uniform, Exponential };
+
+struct LoadSettings{
+    sf::IpAddress m_ip = sf::IpAddress::LocalHost;
+    sf::Uint16 m_port = 0;
+    std::string m_password;
+    Protocol m_protocol = Protocol::V2;
+    size_t m_bots = 100;
+    size_t m_threads = 0;
+    /// logins wait for the server, several run at once to keep up the connect rate
+    size_t m_connectThreads = 4;
+    /// new sessions per second
+    double m_connectRate = 100;
+    /// messages per second of every bot, sent with exponential gaps in between
+    double m_messageRate = 1;
+    size_t m_messageSize = 64;
+    size_t m_maxMessageSize = 1024;
+    SizeDistribution m_sizes = SizeDistribution::Fixed;
+    std::chrono::seconds m_duration = std::chrono::seconds(30);
+};
+
+/// Latencies in microseconds, four buckets per power of two. One thread writes, anyone reads
+class LatencyHistogram
+{
+public:
+    static constexpr size_t Buckets = 256;
+
+    void record(const std::uint64_t& l_microseconds);
+    /// counts so far, subtracting an earlier snapshot leaves a single reporting interval
+    void snapshot(std::vector<std::uint64_t>& l_counts) const;
+    static std::uint64_t percentile(const std::vector<std::uint64_t>& l_counts, const double& l_quantile);
+private:
+    std::atomic<std::uint64_t> m_buckets[Buckets] = {};
+
+    static size_t bucketOf(const std::uint64_t& l_value);
+    static std::uint64_t upperBound(const size_t& l_bucket);
+};
+
+/// Thousands of BotClient sessions driven from a few threads: one connects bots at the connect
+/// rate, workers poll the sockets of their share of the bots, read whatever arrives and send on
+/// schedule, the calling thread prints a report every second.
+class LoadGenerator
+{
+public:
+    LoadGenerator();
+    ~LoadGenerator();
+
+    bool processArguments(int& argc, char**& argv);
+    void setSettings(const LoadSettings& l_settings) { m_settings = l_settings; }
+    LoadSettings getSettings() { return m_settings; }
+
+    int run();
+private:
+    struct Session{
+        std::unique_ptr<BotClient> m_bot;
+        BotClient::Clock::time_point m_nextSend;
+    };
+    struct Worker{
+        std::thread m_thread;
+        std::mutex m_mutex;
+        /// connected by the connector, taken over on the next turn of the worker
+        std::vector<std::unique_ptr<BotClient>> m_joining;
+        LatencyHistogram m_latency;
+        std::atomic<std::uint64_t> m_sent{0};
+        std::atomic<std::uint64_t> m_delivered{0};
+        std::atomic<std::uint64_t> m_lost{0};
+    };
+
+    LoadSettings m_settings;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool> m_running;
+    std::atomic<std::uint64_t> m_connected;
+    std::atomic<std::uint64_t> m_failed;
+
+    void connectBots(const size_t& l_first);
+    void runWorker(Worker& l_worker, const size_t& l_seed);
+    size_t nextSize(std::mt19937& l_random);
+    void report(const std::chrono::seconds& l_elapsed, const std::uint64_t& l_connects, const std::uint64_t& l_sent,
+                const std::uint64_t& l_delivered, const std::vector<std::uint64_t>& l_latency);
+};
+
+#endif // LOADGENERATOR_H
@@ -0,0 +1,47 @@
+#include "botclient.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+    // fixed width hex, so the timestamp is found without a separator
+    const size_t StampDigits = 16;
+}
+
+BotClient::BotClient(const LatencyCallback &l_onLatency) :
+    m_onLatency(l_onLatency),
+    m_alive(true)
+{
+
+}
+
+bool BotClient::sendTimestamped(const size_t &l_size)
+{
+    static const char digits[] = "0123456789abcdef";
+    auto stamp = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+    std::string text(std::max(l_size, StampDigits), 'x');
+    for(size_t i = 0; i < StampDigits; ++i){
+        text[StampDigits - 1 - i] = digits[(stamp >> (4 * i)) & 0xf];
+    }
+    // queued behind what the socket has not taken yet, a failed send marks the bot dead
+    sendToServer(text);
+    return m_alive;
+}
+
+void BotClient::onMessageReceived(std::string_view l_message, std::string_view, const ClientType &)
+{
+    if(l_message.size() < StampDigits){
+        return;
+    }
+    std::uint64_t stamp = 0;
+    for(size_t i = 0; i < StampDigits; ++i){
+        char c = l_message[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if(digit < 0){
+            return;
+        }
+        stamp = (stamp << 4) | static_cast<std::uint64_t>(digit);
+    }
+    auto sent = Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(stamp)));
+    m_onLatency(Clock::now() - sent);
+}
@@ -3,18 +3,23 @@
 #include <thread>
 
 Client::Client() :
-    m_serverIp(""),
+    m_requestedProtocol(Protocol::V2),
+    m_transport(std::make_shared<TcpTransport>()),
+    m_protocol(Protocol::V1),
+    m_sessionId(0),
+    m_reconnectAttempts(0),
+    m_backoffBase(250),
+    m_backoffMax(30000),
+    m_random(std::random_device{}()),
+    m_outboundOffset(0),
+    m_looping(false),
+    m_wakePending(false),
+    m_running(false),
     m_serverPort(0),
-    m_version("1.0"),
-    m_running(false)
+    m_serverIp(""),
+    m_version("1.0")
 {
-    m_responses.emplace(Type::Message, std::bind(&Client::message, this, std::placeholders::_1));
-    m_responses.emplace(Type::ServerMessage, std::bind(&Client::serverMessage, this, std::placeholders::_1));
-    m_responses.emplace(Type::Kick, std::bind(&Client::kick, this, std::placeholders::_1));
-    m_responses.emplace(Type::Connection, std::bind(&Client::connectionNotification, this, std::placeholders::_1));
-    m_responses.emplace(Type::Promotion, std::bind(&Client::promotion, this, std::placeholders::_1));
-    m_responses.emplace(Type::SomebodyPromotion, std::bind(&Client::somebodyPromotion, this, std::placeholders::_1));
-    m_responses.emplace(Type::ServerExit, std::bind(&Client::serverExit, this, std::placeholders::_1));
+    m_client.m_connection = std::make_unique<TcpConnection>();
 }
 
 Client::~Client()
@@ -24,14 +29,16 @@ Client::~Client()
 
 Status Client::checkPassword(const std::string &l_password)
 {
-    sf::Packet packet;
-    packet << Type::Password << l_password;
-    if(m_client.m_socket.send(packet) != sf::Socket::Done){
+    Frame frame = encode(toServer::Password{l_password});
+    std::size_t sent = 0;
+    if(m_client.m_connection->send(frame->data(), frame->size(), sent) != sf::Socket::Done){
         onErrorWithSendingData();
+        return Status::UnableToConnect;
     }
-    packet.clear();
-    if(m_client.m_socket.receive(packet) != sf::Socket::Done){
+    sf::Packet packet;
+    if(m_client.m_connection->receive(packet) != sf::Socket::Done){
         onErrorWithReceivingData();
+        return Status::UnableToConnect;
     }
     Type type;
     packet >> type;
@@ -45,9 +52,16 @@ Status Client::checkPassword(const std::string &l_password)
 
 Status Client::connect(const std::string& l_password)
 {
-    if(m_client.m_socket.connect(m_serverIp, m_serverPort, sf::seconds(2)) == sf::Socket::Done){
+    m_protocol = Protocol::V1;
+    m_members.clear();
+    m_held.clear();
+    m_lookups.clear();
+    m_password = l_password;
+    auto connection = m_transport->connect(m_serverIp, m_serverPort, sf::seconds(2));
+    if(connection){
+        m_client.m_connection = std::move(connection);
         sf::Packet packet;
-        if(m_client.m_socket.receive(packet) == sf::Socket::Done){
+        if(m_client.m_connection->receive(packet) == sf::Socket::Done){
             Type type;
             packet >> type;
             switch(type)
@@ -55,11 +69,16 @@ Status Client::connect(const std::string& l_password)
                 case Type::ServerConnected:      if(sendClientDataToServer()) return Status::Connected; return Status::UnableToConnect;
                 case Type::ServerIsFull:         return Status::ServerIsFull;
                 case Type::Kick:                 return Status::Blocked;
-                case Type::ServerPasswordNeeded:
+                case Type::ServerPasswordNeeded:{
                     if(l_password.empty())
                         return Status::WrongPassword;
-                    if(checkPassword(l_password) == Status::Connected && sendClientDataToServer())
-                        return Status::Connected;
+                    // a rejected password is reported as such, reconnect() does not retry it
+                    Status status = checkPassword(l_password);
+                    if(status == Status::Connected && !sendClientDataToServer())
+                        return Status::UnableToConnect;
+                    return status;
+                }
+                default:                         break;
             }
         } else{
             onErrorWithReceivingData();
@@ -75,6 +94,8 @@ Status Client::establishConnection()
         do{
             std::string password = onServerPasswordNeeded();
             status = checkPassword(password);
+            // asked for again when reconnecting
+            m_password = password;
             if(status == Status::WrongPassword){
                 onServerWrongPassword();
             }
@@ -107,7 +128,11 @@ bool Client::sendClientDataToServer()
 {
     sf::Packet packet;
     packet << m_client.m_name << m_client.m_type;
-    if(m_client.m_socket.send(packet) != sf::Socket::Done){
+    // a v1 server stops reading after the type, a v2 server answers with Opcode::Welcome
+    if(m_requestedProtocol != Protocol::V1){
+        packet << static_cast<sf::Uint8>(m_requestedProtocol);
+    }
+    if(m_client.m_connection->send(packet) != sf::Socket::Done){
         onErrorWithSendingData();
         return false;
     }
@@ -122,6 +147,8 @@ bool Client::processArguments(int &argc, char **&argv)
     cxxopts::Options options("Client", "version: " + m_version);
     options.add_options()
         ("h,help", "View this message")
+        ("protocol", "Set newest protocol version to ask for: 1 or 2 (default is 2)", cxxopts::value<int>())
+        ("reconnect", "Set how many times to try reconnecting after losing the server (default is 0)", cxxopts::value<sf::Uint32>())
     ;
     try
     {
@@ -130,6 +157,17 @@ bool Client::processArguments(int &argc, char **&argv)
             std::cout << options.help();
             return false;
         }
+        if(result.count("protocol")){
+            int protocol = result["protocol"].as<int>();
+            if(protocol != 1 && protocol != 2){
+                onArgumentsError(("Unknown protocol version: " + std::to_string(protocol)).c_str());
+                return false;
+            }
+            setProtocol(static_cast<Protocol>(protocol));
+        }
+        if(result.count("reconnect")){
+            setReconnect(result["reconnect"].as<sf::Uint32>());
+        }
     }
     catch(std::exception& ex){
        onArgumentsError(ex.what());
@@ -142,111 +180,496 @@ bool Client::processArguments(int &argc, char **&argv)
 int Client::run()
 {
     m_running = true;
+    if(!m_waker.getLocalPort()){
+        m_waker.bind(sf::Socket::AnyPort, sf::IpAddress::LocalHost);
+        m_waker.setBlocking(false);
+    }
+    {
+        std::lock_guard<std::mutex> lk(m_outboundMutex);
+        m_looping = true;
+    }
+    watchConnection();
+    while(m_running){
+        // what arrived before the connection was watched is handled before the first wait
+        if(receiveAll() && flushOutbound()){
+            bool pending;
+            {
+                std::lock_guard<std::mutex> lk(m_outboundMutex);
+                pending = m_outboundOffset < m_outbound.size();
+            }
+            // sf::SocketSelector reports no writability, pending output is retried on a short timeout
+            waitForEvents(pending ? sf::milliseconds(5) : sf::milliseconds(50));
+            continue;
+        }
+        if(!m_running){
+            break;
+        }
+        onDisconnected();
+        if(!reconnect()){
+            m_running = false;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lk(m_outboundMutex);
+        m_looping = false;
+    }
+    m_client.m_connection->setNotifier(nullptr);
+    m_client.m_connection->disconnect();
+    m_selector.clear();
+    return 0;
+}
+
+bool Client::receiveAll()
+{
+    // a connection without a socket only signals new data, so everything is read on every wake
     while(m_running){
         sf::Packet packet;
-        auto status = m_client.m_socket.receive(packet);
+        auto status = m_client.m_connection->receive(packet);
         if(status == sf::Socket::Done){
             unpack(packet);
-        } else if(status == sf::Socket::Disconnected && m_running){
-            onDisconnected();
-            quit();
+        } else{
+            return status == sf::Socket::NotReady || status == sf::Socket::Partial;
         }
     }
-    return 0;
+    return true;
+}
+
+bool Client::flushOutbound()
+{
+    sf::Socket::Status status = sf::Socket::Done;
+    {
+        std::lock_guard<std::mutex> lk(m_outboundMutex);
+        if(m_outboundOffset < m_outbound.size()){
+            // everything queued since the last flush leaves in one send
+            std::size_t sent = 0;
+            status = m_client.m_connection->send(m_outbound.data() + m_outboundOffset, m_outbound.size() - m_outboundOffset, sent);
+            m_outboundOffset += sent;
+        }
+        if(status == sf::Socket::Done){
+            m_outbound.clear();
+            m_outboundOffset = 0;
+        }
+    }
+    if(status == sf::Socket::Done || status == sf::Socket::Partial || status == sf::Socket::NotReady){
+        return true;
+    }
+    onErrorWithSendingData();
+    return false;
+}
+
+void Client::watchConnection()
+{
+    auto& connection = *m_client.m_connection;
+    connection.setBlocking(false);
+    m_selector.clear();
+    m_selector.add(m_waker);
+    if(sf::TcpSocket* socket = connection.getSocket()){
+        m_selector.add(*socket);
+    } else{
+        connection.setNotifier([this](bool, bool){ wakeUp(); });
+    }
+}
+
+void Client::waitForEvents(const sf::Time &l_timeout)
+{
+    if(m_selector.wait(l_timeout) && m_selector.isReady(m_waker)){
+        char buffer[64];
+        std::size_t received;
+        sf::IpAddress sender;
+        unsigned short port;
+        while(m_waker.receive(buffer, sizeof(buffer), received, sender, port) == sf::Socket::Done);
+        m_wakePending = false;
+    }
+}
+
+void Client::wakeUp()
+{
+    if(m_wakePending.exchange(true)){
+        return;
+    }
+    char byte = 0;
+    m_waker.send(&byte, 1, sf::IpAddress::LocalHost, m_waker.getLocalPort());
+}
+
+bool Client::reconnect()
+{
+    m_client.m_connection->setNotifier(nullptr);
+    m_client.m_connection->disconnect();
+    {
+        // whatever was left belongs to the lost session
+        std::lock_guard<std::mutex> lk(m_outboundMutex);
+        m_outbound.clear();
+        m_outboundOffset = 0;
+    }
+    for(sf::Uint32 attempt = 0; attempt < m_reconnectAttempts && m_running; ++attempt){
+        // full jitter, clients dropped together by a restarting server come back spread out
+        std::chrono::milliseconds ceiling = std::min(m_backoffBase * (1 << std::min<sf::Uint32>(attempt, 20)), m_backoffMax);
+        std::uniform_int_distribution<std::chrono::milliseconds::rep> distribution(0, ceiling.count());
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(distribution(m_random));
+        for(auto now = std::chrono::steady_clock::now(); now < deadline && m_running; now = std::chrono::steady_clock::now()){
+            m_selector.clear();
+            m_selector.add(m_waker);
+            waitForEvents(sf::microseconds(std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count()));
+        }
+        if(!m_running){
+            return false;
+        }
+        Status status = connect(m_password);
+        if(status == Status::Connected){
+            watchConnection();
+            onSuccessfullyConnected();
+            return true;
+        }
+        // the server answered, trying again would get the same answer
+        if(status == Status::WrongPassword || status == Status::Blocked){
+            return false;
+        }
+    }
+    if(m_reconnectAttempts){
+        onUnableToConnect();
+    }
+    return false;
+}
+
+bool Client::receiveFromServer()
+{
+    while(true){
+        sf::Packet packet;
+        auto status = m_client.m_connection->receive(packet);
+        if(status != sf::Socket::Done){
+            // a packet arriving in pieces is kept by the socket until the rest comes
+            return status == sf::Socket::NotReady || status == sf::Socket::Partial;
+        }
+        unpack(packet);
+    }
+}
+
+bool Client::hasPendingOutput()
+{
+    std::lock_guard<std::mutex> lk(m_outboundMutex);
+    return m_outboundOffset < m_outbound.size();
 }
 
 void Client::quit()
 {
     m_running = false;
-    m_client.m_socket.disconnect();
+    std::lock_guard<std::mutex> lk(m_outboundMutex);
+    // run() closes the connection itself once it wakes up
+    if(m_looping){
+        wakeUp();
+        return;
+    }
+    m_client.m_connection->disconnect();
 }
 
-void Client::message(sf::Packet &l_packet)
+void Client::on(const toClient::Message &l_message)
 {
-    std::string username, message;
-    ClientType type;
-    l_packet >> type >> username >> message;
-    if(type == ClientType::Administrator){
-        username += "[ADMIN]";
+    if(l_message.type == ClientType::Administrator){
+        std::string decorated(l_message.name);
+        decorated += "[ADMIN]";
+        onMessageReceived(l_message.text, decorated, l_message.type);
+        return;
     }
-    onMessageReceived(message, username, type);
+    onMessageReceived(l_message.text, l_message.name, l_message.type);
 }
 
-void Client::serverMessage(sf::Packet &l_packet)
+void Client::on(const toClient::ServerMessage &l_message)
 {
-    std::string message;
-    l_packet >> message;
-    onServerMessageReceived(message);
+    onServerMessageReceived(l_message.text);
 }
 
-void Client::kick(sf::Packet &l_packet)
+void Client::on(const toClient::Kick &l_message)
 {
     onKick();
     m_running = false;
 }
 
-void Client::connectionNotification(sf::Packet &l_packet)
+void Client::on(const toClient::Connection &l_message)
 {
-    std::string name;
-    Type type2;
-    l_packet >> name >> type2;
-    onConnectionNotificationReceived(name, type2);
+    onConnectionNotificationReceived(l_message.name, l_message.kind);
 }
 
-void Client::promotion(sf::Packet &l_packet)
+void Client::on(const toClient::Promotion &l_message)
 {
-    ClientType type;
-    l_packet >> type;
-    if(m_client.m_type < type){
-        m_client.m_type = type;
-        onPromotion("You have been promoted to: " + m_shared.getNameFor(type), true);
+    if(m_client.m_type < l_message.type){
+        m_client.m_type = l_message.type;
+        onPromotion("You have been promoted to: " + m_shared.getNameFor(l_message.type), true);
     } else{
-        m_client.m_type = type;
-        onPromotion("You have been degraded to: " + m_shared.getNameFor(type), false);
+        m_client.m_type = l_message.type;
+        onPromotion("You have been degraded to: " + m_shared.getNameFor(l_message.type), false);
     }
 }
 
-void Client::somebodyPromotion(sf::Packet &l_packet)
+void Client::on(const toClient::SomebodyPromotion &l_message)
 {
-    ClientType type;
-    std::string name;
-    bool promoted;
-    l_packet >> type >> name >> promoted;
-    if(promoted){
-        name += " has been promoted to: " + m_shared.getNameFor(type);
+    std::string name(l_message.name);
+    for(auto& member : m_members){
+        if(member.second.m_name == name){
+            member.second.m_type = l_message.type;
+        }
+    }
+    if(l_message.promoted){
+        name += " has been promoted to: " + m_shared.getNameFor(l_message.type);
     } else{
-        name += " has been degraded to: " + m_shared.getNameFor(type);
+        name += " has been degraded to: " + m_shared.getNameFor(l_message.type);
     }
-    onPromotion(name, promoted);
+    onPromotion(name, l_message.promoted);
 }
 
-void Client::serverExit(sf::Packet &l_packet)
+void Client::on(const toClient::ServerExit &l_message)
 {
     onServerExit();
+    // a restarting server is reconnected to, run() notices the connection is gone
+    if(m_reconnectAttempts && m_looping){
+        m_client.m_connection->disconnect();
+        return;
+    }
     quit();
 }
 
+void Client::on(const toClient::JoinChannel &l_message)
+{
+    onChannelJoined(l_message.channel, l_message.members);
+}
+
+void Client::on(const toClient::LeaveChannel &l_message)
+{
+    onChannelLeft(l_message.channel);
+}
+
+void Client::on(const toClient::ChannelMessage &l_message)
+{
+    if(l_message.type == ClientType::Administrator){
+        std::string decorated(l_message.name);
+        decorated += "[ADMIN]";
+        onChannelMessageReceived(l_message.channel, l_message.text, decorated, l_message.type);
+        return;
+    }
+    onChannelMessageReceived(l_message.channel, l_message.text, l_message.name, l_message.type);
+}
+
+void Client::on(const toClient::DirectMessage &l_message)
+{
+    if(l_message.type == ClientType::Administrator){
+        std::string decorated(l_message.name);
+        decorated += "[ADMIN]";
+        onDirectMessageReceived(l_message.text, decorated, l_message.type);
+        return;
+    }
+    onDirectMessageReceived(l_message.text, l_message.name, l_message.type);
+}
+
+void Client::on(const toClient::UnknownRecipient &l_message)
+{
+    onUnknownRecipient(l_message.recipient);
+}
+
+void Client::unpackCompact(PacketReader &l_packet)
+{
+    Opcode opcode;
+    l_packet >> opcode;
+    switch(opcode)
+    {
+    case Opcode::Welcome:       welcome(l_packet); break;
+    case Opcode::Message:       compactMessage(l_packet); break;
+    case Opcode::ServerMessage: compactServerMessage(l_packet); break;
+    case Opcode::Notice:        notice(l_packet); break;
+    case Opcode::Member:        member(l_packet); break;
+    default:                    onError("Unknown message received from server"); break;
+    }
+}
+
+void Client::welcome(PacketReader &l_packet)
+{
+    Protocol protocol;
+    l_packet >> protocol;
+    if(l_packet.varint(m_sessionId)){
+        m_protocol = protocol;
+    }
+}
+
+void Client::compactMessage(PacketReader &l_packet)
+{
+    sf::Uint32 id = 0;
+    std::string_view message;
+    if(!l_packet.varint(id).text(message)){
+        return;
+    }
+    auto itr = m_members.find(id);
+    if(itr != m_members.end() && m_held.empty()){
+        deliver(message, &itr->second);
+        return;
+    }
+    // someone who was on before this client logged in, asked about once, later messages wait behind it
+    if(itr == m_members.end() && m_lookups.insert(id).second){
+        FrameWriter writer;
+        writer << Opcode::Member;
+        writer.varint(id);
+        if(!sendFrame(writer.finish())){
+            onErrorWithSendingData();
+        }
+    }
+    m_held.push_back(HeldMessage{id, std::string(message), false, Member{std::string(), ClientType::Normie}});
+}
+
+void Client::deliver(std::string_view l_message, const Member *l_sender)
+{
+    if(!l_sender){
+        onMessageReceived(l_message, "?", ClientType::Normie);
+        return;
+    }
+    if(l_sender->m_type == ClientType::Administrator){
+        onMessageReceived(l_message, l_sender->m_name + "[ADMIN]", l_sender->m_type);
+        return;
+    }
+    onMessageReceived(l_message, l_sender->m_name, l_sender->m_type);
+}
+
+void Client::releaseHeld()
+{
+    while(!m_held.empty()){
+        auto& held = m_held.front();
+        if(held.m_named){
+            deliver(held.m_text, &held.m_sender);
+        } else if(!m_lookups.count(held.m_id)){
+            auto itr = m_members.find(held.m_id);
+            deliver(held.m_text, itr == m_members.end() ? nullptr : &itr->second);
+        } else{
+            return;
+        }
+        m_held.pop_front();
+    }
+}
+
+void Client::member(PacketReader &l_packet)
+{
+    sf::Uint32 id = 0;
+    sf::Uint8 type = 0;
+    std::string_view name;
+    l_packet.varint(id) >> type;
+    if(!l_packet.text(name)){
+        return;
+    }
+    // an empty name means the sender left before the server answered, its messages show "?"
+    if(!name.empty()){
+        m_members[id] = Member{std::string(name), static_cast<ClientType>(type)};
+    }
+    m_lookups.erase(id);
+    releaseHeld();
+}
+
+void Client::compactServerMessage(PacketReader &l_packet)
+{
+    std::string_view message;
+    if(l_packet.text(message)){
+        onServerMessageReceived(message);
+    }
+}
+
+void Client::notice(PacketReader &l_packet)
+{
+    sf::Uint32 id = 0;
+    sf::Uint8 kind = 0, type = 0;
+    std::string_view name;
+    l_packet.varint(id) >> kind >> type;
+    if(!l_packet.text(name)){
+        return;
+    }
+    if(static_cast<Type>(kind) == Type::Connection){
+        m_members[id] = Member{std::string(name), static_cast<ClientType>(type)};
+    } else{
+        // messages still waiting on a lookup came from the one leaving, the id may be reused next
+        if(m_lookups.erase(id)){
+            for(auto& held : m_held){
+                if(held.m_id == id && !held.m_named){
+                    held.m_named = true;
+                    held.m_sender = Member{std::string(name), static_cast<ClientType>(type)};
+                }
+            }
+            releaseHeld();
+        }
+        m_members.erase(id);
+    }
+    onConnectionNotificationReceived(name, static_cast<Type>(kind));
+}
+
 void Client::unpack(sf::Packet &packet)
 {
-    Type type;
-    packet >> type;
-    auto itr = m_responses.find(type);
-    if(itr == m_responses.end()){
+    PacketReader reader(packet);
+    if(isCompactPayload(packet)){
+        unpackCompact(reader);
+        return;
+    }
+    if(!dispatchToClient(reader, *this)){
         onError("Unknown message received from server");
     }
-    itr->second(packet);
 }
 
 bool Client::sendToServer(sf::Packet &l_packet)
 {
-    return m_client.m_socket.send(l_packet) == sf::Socket::Done;
+    return sendFrame(makeFrame(l_packet));
+}
+
+bool Client::sendFrame(const Frame &l_frame)
+{
+    std::lock_guard<std::mutex> lk(m_outboundMutex);
+    m_outbound.insert(m_outbound.end(), l_frame->begin(), l_frame->end());
+    if(m_looping){
+        wakeUp();
+        return true;
+    }
+    std::size_t sent = 0;
+    auto status = m_client.m_connection->send(m_outbound.data() + m_outboundOffset, m_outbound.size() - m_outboundOffset, sent);
+    m_outboundOffset += sent;
+    if(status == sf::Socket::Done){
+        m_outbound.clear();
+        m_outboundOffset = 0;
+        return true;
+    }
+    // a non-blocking connection keeps the rest for the next send
+    return status == sf::Socket::Partial || status == sf::Socket::NotReady;
 }
 
 void Client::sendToServer(const std::string &l_text)
 {
-    sf::Packet packet;
-    packet << Type::Message << l_text;
-    if(!sendToServer(packet)){
+    if(m_protocol == Protocol::V2){
+        FrameWriter writer;
+        writer << Opcode::Message;
+        writer.text(l_text);
+        if(!sendFrame(writer.finish())){
+            onErrorWithSendingData();
+        }
+        return;
+    }
+    if(!sendFrame(encode(toServer::Message{l_text}))){
+        onErrorWithSendingData();
+    }
+}
+
+void Client::joinChannel(const std::string &l_channel)
+{
+    if(!sendFrame(encode(toServer::JoinChannel{l_channel}))){
+        onErrorWithSendingData();
+    }
+}
+
+void Client::leaveChannel(const std::string &l_channel)
+{
+    if(!sendFrame(encode(toServer::LeaveChannel{l_channel}))){
+        onErrorWithSendingData();
+    }
+}
+
+void Client::sendToChannel(const std::string &l_channel, const std::string &l_text)
+{
+    if(!sendFrame(encode(toServer::ChannelMessage{l_channel, l_text}))){
+        onErrorWithSendingData();
+    }
+}
+
+void Client::sendDirectMessage(const std::string &l_recipient, const std::string &l_text)
+{
+    if(!sendFrame(encode(toServer::DirectMessage{l_recipient, l_text}))){
         onErrorWithSendingData();
     }
 }
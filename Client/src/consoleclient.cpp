@@ -25,8 +25,25 @@ void ConsoleClient::inputThread()
     m_colorChanger.setConsoleTextColor(Color::White);
     while(m_running){
         std::string text;
-        std::getline(std::cin, text);
-        sendToServer(text);
+        // closed input would otherwise send empty messages as fast as the loop turns
+        if(!std::getline(std::cin, text)){
+            break;
+        }
+        // "/join name", "/leave name" and "#name text" for channels, "/msg nick text" to one client,
+        // everything else goes to all
+        if(text.compare(0, 5, "/msg ") == 0 && text.find(' ', 5) != std::string::npos){
+            size_t space = text.find(' ', 5);
+            sendDirectMessage(text.substr(5, space - 5), text.substr(space + 1));
+        } else if(text.compare(0, 6, "/join ") == 0){
+            joinChannel(text.substr(6));
+        } else if(text.compare(0, 7, "/leave ") == 0){
+            leaveChannel(text.substr(7));
+        } else if(text.size() > 1 && text[0] == '#' && text.find(' ') != std::string::npos){
+            size_t space = text.find(' ');
+            sendToChannel(text.substr(1, space - 1), text.substr(space + 1));
+        } else{
+            sendToServer(text);
+        }
     }
     m_colorChanger.setConsoleTextColor(Color::Default);
 }
@@ -122,18 +139,20 @@ void ConsoleClient::printText(const std::string &l_string, const Color &l_color)
     m_colorChanger.setConsoleTextColor(tmp);
 }
 
-void ConsoleClient::onMessageReceived(const std::string & l_string, const std::string& l_name, const ClientType& l_type)
+void ConsoleClient::onMessageReceived(std::string_view l_string, std::string_view l_name, const ClientType& l_type)
 {
+    std::string text(l_name);
+    text.append(": ").append(l_string);
     if(l_type == ClientType::Normie){
-        printText(l_name + ": " + l_string, Color::Default);
+        printText(text, Color::Default);
     } else {
-        printText(l_name + ": " + l_string, Color::Green);
+        printText(text, Color::Green);
     }
 }
 
-void ConsoleClient::onServerMessageReceived(const std::string & l_string)
+void ConsoleClient::onServerMessageReceived(std::string_view l_string)
 {
-    printText("[SERVER]: " + l_string, Color::Yellow);
+    printText(std::string("[SERVER]: ").append(l_string), Color::Yellow);
 }
 
 void ConsoleClient::onKick()
@@ -142,9 +161,9 @@ void ConsoleClient::onKick()
     std::this_thread::sleep_for(std::chrono::seconds(3));
 }
 
-void ConsoleClient::onConnectionNotificationReceived(const std::string & l_string, const Type & l_type)
+void ConsoleClient::onConnectionNotificationReceived(std::string_view l_string, const Type & l_type)
 {
-    std::string text = l_string;
+    std::string text(l_string);
     Color color;
     if(l_type == Type::Connection){
         text += " joined";
@@ -167,3 +186,32 @@ void ConsoleClient::onServerExit()
     printText("Server closed the connection", Color::Red);
     std::this_thread::sleep_for(std::chrono::seconds(3));
 }
+
+void ConsoleClient::onChannelJoined(std::string_view l_channel, const sf::Uint32 &l_members)
+{
+    printText(std::string("You are in #").append(l_channel) + " (" + std::to_string(l_members) + " members)", Color::Blue);
+}
+
+void ConsoleClient::onChannelLeft(std::string_view l_channel)
+{
+    printText(std::string("You left #").append(l_channel), Color::Blue);
+}
+
+void ConsoleClient::onChannelMessageReceived(std::string_view l_channel, std::string_view l_message, std::string_view l_name, const ClientType &l_type)
+{
+    std::string text("#");
+    text.append(l_channel).append(" ").append(l_name).append(": ").append(l_message);
+    printText(text, l_type == ClientType::Normie ? Color::Blue : Color::Green);
+}
+
+void ConsoleClient::onDirectMessageReceived(std::string_view l_message, std::string_view l_name, const ClientType &l_type)
+{
+    std::string text("[PRIVATE] ");
+    text.append(l_name).append(": ").append(l_message);
+    printText(text, l_type == ClientType::Normie ? Color::White : Color::Green);
+}
+
+void ConsoleClient::onUnknownRecipient(std::string_view l_name)
+{
+    printError(std::string(l_name) + " is not connected");
+}
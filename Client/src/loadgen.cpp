@@ -0,0 +1,10 @@
+#include "loadgenerator.h"
+
+int main(int argc, char** argv)
+{
+    LoadGenerator generator;
+    if(!generator.processArguments(argc, argv)){
+        return 0;
+    }
+    return generator.run();
+}
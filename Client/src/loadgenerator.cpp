@@ -0,0 +1,348 @@
+#include "loadgenerator.h"
+#include "../../Shared/cxxopts.h"
+#include <algorithm>
+#include <iostream>
+#ifdef _WIN32
+#include <winsock2.h>
+#define poll WSAPoll
+using PollDescriptor = WSAPOLLFD;
+#else
+#include <poll.h>
+using PollDescriptor = pollfd;
+#endif
+
+void LatencyHistogram::record(const std::uint64_t &l_microseconds)
+{
+    auto& bucket = m_buckets[bucketOf(l_microseconds)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::snapshot(std::vector<std::uint64_t> &l_counts) const
+{
+    l_counts.resize(Buckets);
+    for(size_t i = 0; i < Buckets; ++i){
+        l_counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+std::uint64_t LatencyHistogram::percentile(const std::vector<std::uint64_t> &l_counts, const double &l_quantile)
+{
+    std::uint64_t total = 0;
+    for(auto count : l_counts){
+        total += count;
+    }
+    if(!total){
+        return 0;
+    }
+    auto rank = static_cast<std::uint64_t>(l_quantile * static_cast<double>(total - 1)) + 1;
+    std::uint64_t seen = 0;
+    for(size_t i = 0; i < l_counts.size(); ++i){
+        seen += l_counts[i];
+        if(seen >= rank){
+            return upperBound(i);
+        }
+    }
+    return upperBound(l_counts.size() - 1);
+}
+
+size_t LatencyHistogram::bucketOf(const std::uint64_t &l_value)
+{
+    if(l_value < 4){
+        return static_cast<size_t>(l_value);
+    }
+    size_t exponent = 63;
+    while(!(l_value >> exponent)){
+        --exponent;
+    }
+    // the two bits below the highest one pick the quarter of [2^e, 2^(e+1))
+    size_t bucket = 4 * (exponent - 1) + ((l_value >> (exponent - 2)) & 3);
+    return std::min(bucket, Buckets - 1);
+}
+
+std::uint64_t LatencyHistogram::upperBound(const size_t &l_bucket)
+{
+    if(l_bucket < 4){
+        return l_bucket;
+    }
+    size_t exponent = l_bucket / 4 + 1;
+    return ((4 + l_bucket % 4 + 1) << (exponent - 2)) - 1;
+}
+
+LoadGenerator::LoadGenerator() :
+    m_running(false),
+    m_connected(0),
+    m_failed(0)
+{
+
+}
+
+LoadGenerator::~LoadGenerator()
+{
+
+}
+
+bool LoadGenerator::processArguments(int &argc, char **&argv)
+{
+    cxxopts::Options options("loadgen", "Simulates many chat clients against one server");
+    options.add_options()
+        ("h,help", "View this message")
+        ("ip", "Set server address (default is 127.0.0.1)", cxxopts::value<std::string>())
+        ("port", "Set server port", cxxopts::value<sf::Uint16>())
+        ("password", "Set password every bot logs in with", cxxopts::value<std::string>())
+        ("protocol", "Set newest protocol version to ask for: 1 or 2 (default is 2)", cxxopts::value<int>())
+        ("bots", "Set number of sessions (default is 100)", cxxopts::value<size_t>())
+        ("threads", "Set number of worker threads (default is one per 500 bots)", cxxopts::value<size_t>())
+        ("connect-rate", "Set new sessions per second (default is 100)", cxxopts::value<double>())
+        ("connect-threads", "Set number of threads logging bots in (default is 4)", cxxopts::value<size_t>())
+        ("message-rate", "Set messages per second of every bot (default is 1, 0 only listens)", cxxopts::value<double>())
+        ("size", "Set mean message size in bytes (default is 64)", cxxopts::value<size_t>())
+        ("max-size", "Set largest message size in bytes (default is 1024)", cxxopts::value<size_t>())
+        ("sizes", "Set message size distribution: fixed, uniform or exponential (default is fixed)", cxxopts::value<std::string>())
+        ("duration", "Set seconds to run (default is 30)", cxxopts::value<sf::Uint32>())
+    ;
+    try
+    {
+        auto result = options.parse(argc, argv);
+        if(result.count("help") || !result.count("port")){
+            std::cout << options.help();
+            return false;
+        }
+        m_settings.m_port = result["port"].as<sf::Uint16>();
+        if(result.count("ip")){
+            m_settings.m_ip = sf::IpAddress(result["ip"].as<std::string>());
+        }
+        if(result.count("password")){
+            m_settings.m_password = result["password"].as<std::string>();
+        }
+        if(result.count("protocol")){
+            int protocol = result["protocol"].as<int>();
+            if(protocol != 1 && protocol != 2){
+                std::cerr << "Unknown protocol version: " << protocol << std::endl;
+                return false;
+            }
+            m_settings.m_protocol = static_cast<Protocol>(protocol);
+        }
+        if(result.count("bots")){
+            m_settings.m_bots = result["bots"].as<size_t>();
+        }
+        if(result.count("threads")){
+            m_settings.m_threads = result["threads"].as<size_t>();
+        }
+        if(result.count("connect-threads")){
+            m_settings.m_connectThreads = std::max<size_t>(result["connect-threads"].as<size_t>(), 1);
+        }
+        if(result.count("connect-rate")){
+            m_settings.m_connectRate = result["connect-rate"].as<double>();
+        }
+        if(result.count("message-rate")){
+            m_settings.m_messageRate = result["message-rate"].as<double>();
+        }
+        if(result.count("size")){
+            m_settings.m_messageSize = result["size"].as<size_t>();
+        }
+        if(result.count("max-size")){
+            m_settings.m_maxMessageSize = result["max-size"].as<size_t>();
+        }
+        if(result.count("sizes")){
+            std::string sizes = result["sizes"].as<std::string>();
+            if(sizes == "fixed"){
+                m_settings.m_sizes = SizeDistribution::Fixed;
+            } else if(sizes == "uniform"){
+                m_settings.m_sizes = SizeDistribution::Uniform;
+            } else if(sizes == "exponential"){
+                m_settings.m_sizes = SizeDistribution::Exponential;
+            } else{
+                std::cerr << "Unknown size distribution: " << sizes << std::endl;
+                return false;
+            }
+        }
+        if(result.count("duration")){
+            m_settings.m_duration = std::chrono::seconds(result["duration"].as<sf::Uint32>());
+        }
+    }
+    catch(std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int LoadGenerator::run()
+{
+    m_running = true;
+    size_t threads = m_settings.m_threads ? m_settings.m_threads : m_settings.m_bots / 500 + 1;
+    m_workers.clear();
+    for(size_t i = 0; i < threads; ++i){
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for(size_t i = 0; i < threads; ++i){
+        m_workers[i]->m_thread = std::thread(&LoadGenerator::runWorker, this, std::ref(*m_workers[i]), i);
+    }
+    std::vector<std::thread> connectors;
+    for(size_t i = 0; i < m_settings.m_connectThreads; ++i){
+        connectors.emplace_back(&LoadGenerator::connectBots, this, i);
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::uint64_t connected = 0, sent = 0, delivered = 0;
+    std::vector<std::uint64_t> latency(LatencyHistogram::Buckets), previous(LatencyHistogram::Buckets), total(LatencyHistogram::Buckets);
+    for(auto elapsed = std::chrono::seconds(1); elapsed <= m_settings.m_duration; ++elapsed){
+        std::this_thread::sleep_until(started + elapsed);
+        std::uint64_t nowSent = 0, nowDelivered = 0;
+        std::fill(total.begin(), total.end(), 0);
+        for(auto& worker : m_workers){
+            nowSent += worker->m_sent;
+            nowDelivered += worker->m_delivered;
+            worker->m_latency.snapshot(latency);
+            for(size_t i = 0; i < total.size(); ++i){
+                total[i] += latency[i];
+            }
+        }
+        std::uint64_t nowConnected = m_connected;
+        for(size_t i = 0; i < total.size(); ++i){
+            latency[i] = total[i] - previous[i];
+        }
+        report(elapsed, nowConnected - connected, nowSent - sent, nowDelivered - delivered, latency);
+        connected = nowConnected;
+        sent = nowSent;
+        delivered = nowDelivered;
+        previous = total;
+    }
+
+    m_running = false;
+    for(auto& connector : connectors){
+        connector.join();
+    }
+    for(auto& worker : m_workers){
+        worker->m_thread.join();
+    }
+    std::uint64_t lost = 0;
+    for(auto& worker : m_workers){
+        lost += worker->m_lost;
+    }
+    auto seconds = static_cast<double>(std::max<std::int64_t>(m_settings.m_duration.count(), 1));
+    std::cout << "total: connected " << m_connected << ", failed " << m_failed << ", lost " << lost
+              << ", sent " << sent << " (" << static_cast<std::uint64_t>(sent / seconds) << "/s)"
+              << ", delivered " << delivered << " (" << static_cast<std::uint64_t>(delivered / seconds) << "/s)"
+              << ", latency us p50 " << LatencyHistogram::percentile(total, 0.5)
+              << " p90 " << LatencyHistogram::percentile(total, 0.9)
+              << " p99 " << LatencyHistogram::percentile(total, 0.99)
+              << " p99.9 " << LatencyHistogram::percentile(total, 0.999) << std::endl;
+    return m_failed == m_settings.m_bots ? 1 : 0;
+}
+
+void LoadGenerator::report(const std::chrono::seconds &l_elapsed, const std::uint64_t &l_connects, const std::uint64_t &l_sent,
+                           const std::uint64_t &l_delivered, const std::vector<std::uint64_t> &l_latency)
+{
+    std::cout << l_elapsed.count() << "s: bots " << m_connected << ", connects/s " << l_connects
+              << ", messages/s " << l_sent << ", delivered/s " << l_delivered
+              << ", latency us p50 " << LatencyHistogram::percentile(l_latency, 0.5)
+              << " p90 " << LatencyHistogram::percentile(l_latency, 0.9)
+              << " p99 " << LatencyHistogram::percentile(l_latency, 0.99)
+              << " max " << LatencyHistogram::percentile(l_latency, 1) << std::endl;
+}
+
+void LoadGenerator::connectBots(const size_t &l_first)
+{
+    // every connector takes every m_connectThreads-th bot, all of them keep to one schedule
+    auto started = std::chrono::steady_clock::now();
+    auto gap = std::chrono::duration<double>(m_settings.m_connectRate > 0 ? 1 / m_settings.m_connectRate : 0);
+    for(size_t i = l_first; i < m_settings.m_bots && m_running; i += m_settings.m_connectThreads){
+        std::this_thread::sleep_until(started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(gap * static_cast<double>(i)));
+        Worker& worker = *m_workers[i % m_workers.size()];
+        // the bot only ever runs on its worker, which is the only writer of the histogram
+        auto bot = std::make_unique<BotClient>([&worker](const BotClient::Clock::duration& l_latency){
+            worker.m_latency.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(l_latency).count()));
+            ++worker.m_delivered;
+        });
+        bot->setNickname("bot" + std::to_string(i));
+        bot->setProtocol(m_settings.m_protocol);
+        if(bot->connect(m_settings.m_port, m_settings.m_ip, m_settings.m_password) != Status::Connected){
+            ++m_failed;
+            continue;
+        }
+        ++m_connected;
+        // one bot stuck on a partial packet or a full send buffer would hold up its whole worker
+        bot->setBlocking(false);
+        std::lock_guard<std::mutex> lk(worker.m_mutex);
+        worker.m_joining.push_back(std::move(bot));
+    }
+}
+
+void LoadGenerator::runWorker(Worker &l_worker, const size_t &l_seed)
+{
+    std::mt19937 random(static_cast<std::mt19937::result_type>(l_seed * 7919 + 1));
+    std::exponential_distribution<double> gaps(m_settings.m_messageRate > 0 ? m_settings.m_messageRate : 1);
+    auto nextGap = [&](){
+        return std::chrono::duration_cast<BotClient::Clock::duration>(std::chrono::duration<double>(gaps(random)));
+    };
+    std::vector<Session> sessions;
+    std::vector<PollDescriptor> descriptors;
+    while(m_running){
+        {
+            std::lock_guard<std::mutex> lk(l_worker.m_mutex);
+            for(auto& bot : l_worker.m_joining){
+                descriptors.push_back(PollDescriptor{bot->getHandle(), POLLIN, 0});
+                sessions.push_back(Session{std::move(bot), BotClient::Clock::now() + nextGap()});
+            }
+            l_worker.m_joining.clear();
+        }
+        if(sessions.empty()){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        // poll() has no FD_SETSIZE limit, unlike sf::SocketSelector
+        poll(descriptors.data(), static_cast<decltype(descriptors.size())>(descriptors.size()), 5);
+        auto now = BotClient::Clock::now();
+        size_t i = 0;
+        while(i < sessions.size()){
+            Session& session = sessions[i];
+            bool alive = true;
+            if(descriptors[i].revents & (POLLIN | POLLERR | POLLHUP)){
+                alive = session.m_bot->receiveFromServer();
+            }
+            if(alive && (descriptors[i].revents & POLLOUT)){
+                alive = session.m_bot->flushToServer();
+            }
+            if(alive && m_settings.m_messageRate > 0 && session.m_nextSend <= now){
+                if(session.m_bot->sendTimestamped(nextSize(random))){
+                    ++l_worker.m_sent;
+                }
+                session.m_nextSend += nextGap();
+            }
+            if(!alive || !session.m_bot->isAlive()){
+                ++l_worker.m_lost;
+                session.m_bot->quit();
+                std::swap(sessions[i], sessions.back());
+                std::swap(descriptors[i], descriptors.back());
+                sessions.pop_back();
+                descriptors.pop_back();
+                continue;
+            }
+            descriptors[i].revents = 0;
+            descriptors[i].events = session.m_bot->hasPendingOutput() ? POLLIN | POLLOUT : POLLIN;
+            ++i;
+        }
+    }
+    for(auto& session : sessions){
+        session.m_bot->quit();
+    }
+}
+
+size_t LoadGenerator::nextSize(std::mt19937 &l_random)
+{
+    double size = static_cast<double>(m_settings.m_messageSize);
+    switch(m_settings.m_sizes)
+    {
+    case SizeDistribution::Uniform:
+        // mean stays at m_messageSize
+        size = std::uniform_real_distribution<double>(0, 2 * size)(l_random);
+        break;
+    case SizeDistribution::Exponential:
+        size = std::exponential_distribution<double>(1 / std::max(size, 1.0))(l_random);
+        break;
+    default:
+        break;
+    }
+    return std::min(static_cast<size_t>(size), m_settings.m_maxMessageSize);
+}
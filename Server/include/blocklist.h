@@ -0,0 +1,70 @@
+#ifndef BLOCKLIST_H
+#define BLOCKLIST_H
+
+#include <SFML/Network.hpp>
+#include <string>
+#include <vector>
+#include <utility>
+
+/// Peer address in network byte order as accept() reports it: 4 bytes for IPv4, including
+/// IPv4-mapped IPv6 addresses, or 16 bytes for IPv6
+struct PeerAddress{
+    PeerAddress() : m_bytes{}, m_length(0) {}
+    sf::Uint8 m_bytes[16];
+    size_t m_length;
+
+    bool isValid() const { return m_length != 0; }
+    std::string toString() const;
+    /// "10.0.0.1", "2001:db8::1", with l_prefix set from an optional "/bits" suffix
+    static bool parse(const std::string& l_text, PeerAddress& l_address, size_t* l_prefix = nullptr);
+};
+
+/// Blocked IPv4/IPv6 ranges in a binary prefix trie, one bit per level. A lookup walks at most
+/// 32 or 128 nodes and stops at the first blocked prefix, whatever the number of ranges.
+/// Not synchronized, see Server for how it is shared.
+///
+/// On disk: "BLK" and a version byte, a 32-bit big-endian count, then for every range its
+/// address length (4 or 16), the prefix length and only the bytes the prefix covers.
+class Blocklist
+{
+public:
+    Blocklist();
+
+    /// "10.0.0.0/8", "2001:db8::/32" or a single address; false when l_range does not parse
+    /// or is already blocked
+    bool insert(const std::string& l_range);
+    /// false when exactly this range was not blocked
+    bool insert(const PeerAddress& l_address, const size_t& l_prefix);
+    bool erase(const std::string& l_range);
+    bool contains(const std::string& l_range) const;
+    /// true when some blocked range covers l_address
+    bool matches(const PeerAddress& l_address) const;
+    bool matches(const std::string& l_ip) const;
+    void clear();
+
+    size_t size() const { return m_size; }
+    /// every blocked range, single addresses without the "/bits" suffix
+    std::vector<std::string> getRanges() const;
+
+    /// goes through a temporary file renamed over l_path, so a reader never sees half of it
+    bool save(const std::string& l_path) const;
+    /// replaces every range with the ones in l_path, nothing changes when it cannot be read
+    bool load(const std::string& l_path);
+private:
+    using Range = std::pair<PeerAddress, size_t>;
+
+    struct Node{
+        Node() : m_children{-1, -1}, m_blocked(false) {}
+        sf::Int32 m_children[2];
+        bool m_blocked;
+    };
+    // m_nodes[0] is the IPv4 root, m_nodes[1] the IPv6 one
+    std::vector<Node> m_nodes;
+    size_t m_size;
+
+    sf::Int32 find(const PeerAddress& l_address, const size_t& l_prefix) const;
+    std::vector<Range> collect() const;
+    void collect(const sf::Int32& l_node, PeerAddress& l_address, const size_t& l_depth, std::vector<Range>& l_ranges) const;
+};
+
+#endif // BLOCKLIST_H
@@ -0,0 +1,37 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+/// Subscribers of every channel counted per shard, so a channel message is handed only to
+/// the shards that have members. The members themselves are indexed by their own shard.
+class ChannelDirectory
+{
+public:
+    ChannelDirectory() : m_shards(1) {}
+
+    void setShards(const size_t& l_shards);
+    void join(const std::string& l_channel, const size_t& l_shard);
+    void leave(const std::string& l_channel, const size_t& l_shard);
+    void clear();
+
+    /// shards with at least one member of l_channel
+    std::vector<size_t> getShards(const std::string& l_channel) const;
+    size_t getMembers(const std::string& l_channel) const;
+    /// every channel with its number of members, sorted by name
+    std::vector<std::pair<std::string, size_t>> getCounts() const;
+private:
+    struct Channel{
+        std::vector<size_t> m_perShard;
+        size_t m_members = 0;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Channel> m_channels;
+    size_t m_shards;
+};
+
+#endif // CHANNELS_H
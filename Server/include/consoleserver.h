@@ -17,23 +17,31 @@ public:
     void printError(const std::string& l_string);
     void printText(const std::string& l_string, const Color& l_color);
     void printServerInfo();
+    void printMetrics();
 
 private:
     Commands m_commands;
     CommandsDescriptions m_commandsDescriptions;
     ColorChanger m_colorChanger;
+    // callbacks arrive from every reactor thread
+    std::mutex m_printMutex;
 
     void inputThread();
 
     /// COMMANDS
     void changeMaxClients();
     void changePassword();
+    void changeTracing();
+    void dumpTrace();
     void viewAllCommands();
     void viewAllClients();
+    void viewAllChannels();
     void sendMessage();
     void kick();
     void block();
     void unblock();
+    void viewBlocked();
+    void reloadBlocklist();
     void promote();
     void helpPromote();
 
@@ -43,14 +51,16 @@ private:
     std::string getline();
 
 protected:
-    void onClientBlocked(std::unique_ptr<ClientServerData>& l_client);
+    void onClientBlocked(const std::string& l_ip);
     void onClientRejected(std::unique_ptr<ClientServerData>& l_client);
     void onClientConnected(std::unique_ptr<ClientServerData>& l_client);
     void onClientDisconnected(std::unique_ptr<ClientServerData>& l_client);
     void onClientPromoted(std::unique_ptr<ClientServerData>& l_client, const bool& l_promoted);
-    void onClientMessageReceived(std::unique_ptr<ClientServerData> &l_client, const std::string &l_text);
+    void onClientMessageReceived(std::unique_ptr<ClientServerData> &l_client, std::string_view l_text);
     void onErrorWithReceivingData(std::unique_ptr<ClientServerData>& l_client);
     void onErrorWithSendingData(std::unique_ptr<ClientServerData>& l_client);
+    void onClientTooSlow(std::unique_ptr<ClientServerData>& l_client);
+    void onHandshakeTimeout(std::unique_ptr<ClientServerData>& l_client);
     void onArgumentsError(const char * l_what);
     void error(const std::string& l_text);
 };
@@ -0,0 +1,42 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <deque>
+#include <mutex>
+#include <cstdint>
+#include "../../Shared/frame.h"
+
+/// Most recent broadcast frames, kept encoded and bounded by their total size in bytes.
+/// Frames are shared with the broadcast that produced them, recording one copies nothing.
+class ChatHistory
+{
+public:
+    ChatHistory(const size_t& l_capacity = 64 * 1024) : m_capacity(l_capacity), m_bytes(0), m_sequence(0), m_replaySequence(0) {}
+
+    /// 0 disables the history, shrinking drops the oldest frames right away
+    void setCapacity(const size_t& l_capacity);
+    size_t getCapacity() const { return m_capacity; }
+
+    /// evicts the oldest frames until l_frame fits, a frame larger than the capacity is not kept.
+    /// Returns the sequence number of l_frame, 0 when the history is off
+    std::uint64_t record(const Frame& l_frame);
+    /// every kept frame back to back as one frame, nullptr when empty. l_sequence is set to the
+    /// newest frame it covers. Built once and reused by every client joining before the next record()
+    Frame replay(std::uint64_t& l_sequence);
+    void clear();
+
+    size_t size() const;
+    size_t bytes() const;
+private:
+    mutable std::mutex m_mutex;
+    std::deque<Frame> m_frames;
+    Frame m_replay;
+    size_t m_capacity;
+    size_t m_bytes;
+    std::uint64_t m_sequence;
+    std::uint64_t m_replaySequence;
+
+    void evict(const size_t& l_needed);
+};
+
+#endif // HISTORY_H
@@ -0,0 +1,96 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <SFML/Network.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+/// Message payloads are the v1 frames that were broadcast, Promotion and Kick hold
+/// name(string) ip(string) followed by the new ClientType or whether the ip was blocked
+enum class JournalKind : sf::Uint8 { Message = 1, Promotion, Kick };
+
+struct JournalRecord{
+    JournalKind m_kind;
+    std::uint64_t m_sequence;
+    /// points into the mapped segment, valid only during the replay callback
+    std::string_view m_payload;
+};
+
+/// Append-only log split into segment files named after their first sequence number.
+/// append() only copies into memory, a writer thread writes and fdatasync()s whatever piled
+/// up meanwhile in one go (group commit). Every segment has an .idx file with the offset of
+/// each record, so the tail is found without scanning. A new segment is started once the
+/// current one reaches the segment size, the oldest ones are deleted beyond the retained size.
+class Journal
+{
+public:
+    Journal() : m_segmentBytes(4 * 1024 * 1024), m_retainedBytes(64 * 1024 * 1024) {}
+    ~Journal();
+
+    void setSegmentBytes(const size_t& l_bytes) { m_segmentBytes = l_bytes; }
+    void setRetainedBytes(const size_t& l_bytes) { m_retainedBytes = l_bytes; }
+
+    /// creates l_directory when needed, appending continues after the newest record found there
+    bool open(const std::string& l_directory);
+    /// writes out everything appended so far, then stops the writer
+    void close();
+    bool isOpen() const { return m_writer.joinable(); }
+    /// false once a write failed, nothing is written after that
+    bool isHealthy() const;
+
+    /// never waits for the disk, returns the sequence number of the record (0 when closed)
+    std::uint64_t append(const JournalKind& l_kind, std::string_view l_payload);
+    /// blocks until every record appended so far is durable
+    void sync();
+    /// records of the newest segments, oldest first, skipping the ones that would exceed l_bytes.
+    /// Only call before appending, segments are read as they are on disk
+    void replayTail(const size_t& l_bytes, const std::function<void(const JournalRecord&)>& l_callback);
+
+    std::uint64_t getLastSequence();
+    size_t getSegmentCount();
+private:
+    struct Segment{
+        std::uint64_t m_first;
+        std::string m_path;
+        size_t m_size;
+    };
+
+    std::string m_directory;
+    size_t m_segmentBytes;
+    size_t m_retainedBytes;
+    std::deque<Segment> m_segments;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_pendingReady;
+    std::condition_variable m_durable;
+    std::vector<char> m_pending;
+    std::vector<size_t> m_pendingStarts;
+    std::uint64_t m_nextSequence = 1;
+    std::uint64_t m_durableSequence = 0;
+    bool m_stopping = false;
+    bool m_failed = false;
+    std::thread m_writer;
+
+    int m_log = -1;
+    int m_index = -1;
+
+    void runWriter();
+    bool writeBatch(const std::vector<char>& l_batch, const std::vector<size_t>& l_starts);
+    bool startSegment(const std::uint64_t& l_first);
+    void closeSegment();
+    void applyRetention();
+    void loadSegments();
+    static void readSegment(const Segment& l_segment, const size_t& l_from,
+                            const std::function<void(const JournalRecord&)>& l_callback, std::uint64_t* l_last);
+    static size_t tailOffset(const Segment& l_segment, const size_t& l_bytes);
+    static std::uint64_t lastSequence(const Segment& l_segment);
+};
+
+#endif // JOURNAL_H
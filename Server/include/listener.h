@@ -0,0 +1,69 @@
+#ifndef LISTENER_H
+#define LISTENER_H
+
+#include <SFML/Network.hpp>
+#include <memory>
+#include "../../Shared/transport.h"
+#include "../../Shared/memorytransport.h"
+#include "blocklist.h"
+#include "slabpool.h"
+
+/// Where Server takes new connections from. A peer is looked at before anything is allocated
+/// for it: accept() only reports its address, adopt() or reject() decides what happens to it.
+class Listener : public Pollable
+{
+public:
+    virtual bool listen(const sf::Uint16& l_port) = 0;
+    virtual void close() = 0;
+    /// takes the next pending peer, false when nobody is waiting
+    virtual bool accept(PeerAddress& l_address) = 0;
+    /// the connection to the peer of the last accept()
+    virtual std::unique_ptr<Connection> adopt() = 0;
+    /// sends l_data if the peer of the last accept() takes it right away and closes the connection
+    virtual void reject(const char* l_data, const size_t& l_size) = 0;
+};
+
+/// What TcpListener hands out, pooled like the client records so accepting stays off the heap
+class PooledTcpConnection : public TcpConnection
+{
+public:
+    static void* operator new(std::size_t l_size);
+    static void operator delete(void* l_pointer, std::size_t l_size);
+    static SlabPool<PooledTcpConnection>& pool();
+};
+
+class TcpListener : public Listener
+{
+public:
+    bool listen(const sf::Uint16& l_port);
+    void close() { m_listener.close(); }
+    bool accept(PeerAddress& l_address);
+    std::unique_ptr<Connection> adopt();
+    void reject(const char* l_data, const size_t& l_size);
+    sf::Socket* getSocket() { return &m_listener; }
+private:
+    sf::TcpListener m_listener;
+    sf::SocketHandle m_pending;
+};
+
+/// Listens on a port of a MemoryNetwork, every peer comes from 127.0.0.1
+class MemoryListener : public Listener
+{
+public:
+    MemoryListener(const std::shared_ptr<MemoryNetwork>& l_network) : m_network(l_network), m_port(0) {}
+    ~MemoryListener() { close(); }
+
+    bool listen(const sf::Uint16& l_port);
+    void close();
+    bool accept(PeerAddress& l_address);
+    std::unique_ptr<Connection> adopt() { return std::move(m_pending); }
+    void reject(const char* l_data, const size_t& l_size);
+    void setNotifier(const Notifier& l_notifier);
+private:
+    std::shared_ptr<MemoryNetwork> m_network;
+    std::shared_ptr<MemoryBacklog> m_backlog;
+    sf::Uint16 m_port;
+    std::unique_ptr<Connection> m_pending;
+};
+
+#endif // LISTENER_H
@@ -0,0 +1,111 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "../../Shared/shared.h"
+#include "../../Shared/protocol.h"
+
+/// Slots of the per-kind packet counters: every Type, then the v2 opcodes, then anything undecodable
+constexpr size_t TypeCount = static_cast<size_t>(Type::UnknownRecipient) + 1;
+constexpr size_t OpcodeCount = static_cast<size_t>(Opcode::Member) - static_cast<size_t>(Opcode::Welcome) + 1;
+constexpr size_t PacketKinds = TypeCount + OpcodeCount + 1;
+
+/// slot of a packet payload as sent on the wire, v1 Type or v2 opcode. The login packet has
+/// no Type of its own, its leading name length makes it count as a Message
+size_t packetKind(const char* l_payload, const size_t& l_size);
+constexpr size_t packetKind(const Opcode& l_opcode) { return TypeCount + static_cast<size_t>(l_opcode) - static_cast<size_t>(Opcode::Welcome); }
+const char* packetKindName(const size_t& l_kind);
+
+/// Only ever written by whoever holds the owning shard's mutex, so a plain load and store is
+/// enough and no locked instruction is paid on the hot path. Readers may be any thread.
+class Counter
+{
+public:
+    void add(const std::uint64_t& l_value = 1) { m_value.store(m_value.load(std::memory_order_relaxed) + l_value, std::memory_order_relaxed); }
+    std::uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+private:
+    std::atomic<std::uint64_t> m_value{0};
+};
+
+class Gauge
+{
+public:
+    void add(const std::int64_t& l_delta) { m_value.store(m_value.load(std::memory_order_relaxed) + l_delta, std::memory_order_relaxed); }
+    void set(const std::int64_t& l_value) { m_value.store(l_value, std::memory_order_relaxed); }
+    std::int64_t get() const { return m_value.load(std::memory_order_relaxed); }
+private:
+    std::atomic<std::int64_t> m_value{0};
+};
+
+struct HistogramSnapshot{
+    /// bucket 0 counts values below 1, bucket i values in [2^(i-1), 2^i)
+    static constexpr size_t Buckets = 32;
+    std::uint64_t m_buckets[Buckets] = {};
+    std::uint64_t m_count = 0;
+    std::uint64_t m_sum = 0;
+    std::uint64_t m_max = 0;
+
+    void merge(const HistogramSnapshot& l_other);
+    /// upper bound of the bucket holding the l_quantile-th value
+    std::uint64_t percentile(const double& l_quantile) const;
+};
+
+/// Power-of-two buckets, same single writer rule as Counter
+class Histogram
+{
+public:
+    void record(const std::uint64_t& l_value);
+    HistogramSnapshot snapshot() const;
+private:
+    Counter m_buckets[HistogramSnapshot::Buckets];
+    Counter m_count;
+    Counter m_sum;
+    std::atomic<std::uint64_t> m_max{0};
+};
+
+/// What one reactor thread measures, on its own cache lines so shards never share them
+struct alignas(64) ShardMetrics{
+    Counter m_packetsIn[PacketKinds];
+    Counter m_packetsOut[PacketKinds];
+    Counter m_bytesIn;
+    Counter m_bytesOut;
+    Counter m_disconnected;
+    Counter m_handshakeFailures;
+    Counter m_sendErrors;
+    Counter m_receiveErrors;
+    Counter m_slowConsumers;
+    /// frames sitting in outbound queues, clients waiting for the socket to take them
+    Gauge m_queuedFrames;
+    Gauge m_waitingClients;
+    /// microseconds spent handling one wake of the reactor, waiting excluded
+    Histogram m_loop;
+};
+
+/// Everything added up over the shards at one moment
+struct MetricsSnapshot{
+    std::uint64_t m_accepted = 0;
+    std::uint64_t m_blocked = 0;
+    std::uint64_t m_disconnected = 0;
+    std::uint64_t m_packetsIn[PacketKinds] = {};
+    std::uint64_t m_packetsOut[PacketKinds] = {};
+    std::uint64_t m_bytesIn = 0;
+    std::uint64_t m_bytesOut = 0;
+    std::uint64_t m_handshakeFailures = 0;
+    std::uint64_t m_sendErrors = 0;
+    std::uint64_t m_receiveErrors = 0;
+    std::uint64_t m_slowConsumers = 0;
+    std::int64_t m_queuedFrames = 0;
+    std::int64_t m_waitingClients = 0;
+    sf::Uint32 m_connected = 0;
+    sf::Uint32 m_handshaking = 0;
+    HistogramSnapshot m_loop;
+
+    void add(const ShardMetrics& l_shard);
+    /// one line of JSON, packet kinds that were never seen are left out
+    std::string toJson() const;
+};
+
+#endif // METRICS_H
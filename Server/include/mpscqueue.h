@@ -0,0 +1,57 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+/// Lock-free unbounded queue, any thread may push, only the owning thread may pop
+template <class T>
+class MpscQueue
+{
+    struct Node{
+        Node() : m_next(nullptr) {}
+        std::atomic<Node*> m_next;
+        T m_value;
+    };
+public:
+    MpscQueue() : m_head(new Node), m_tail(m_head.load()) {}
+    ~MpscQueue()
+    {
+        T value;
+        while(pop(value));
+        delete m_tail;
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T&& l_value)
+    {
+        Node* node = new Node;
+        node->m_value = std::move(l_value);
+        Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->m_next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T& l_value)
+    {
+        Node* tail = m_tail;
+        Node* next = tail->m_next.load(std::memory_order_acquire);
+        if(!next){
+            return false;
+        }
+        l_value = std::move(next->m_value);
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+    bool empty() const
+    {
+        return m_tail->m_next.load(std::memory_order_acquire) == nullptr;
+    }
+private:
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+};
+
+#endif // MPSCQUEUE_H
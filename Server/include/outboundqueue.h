@@ -0,0 +1,61 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+#include <SFML/Network.hpp>
+#include <vector>
+#include "../../Shared/frame.h"
+#include "../../Shared/transport.h"
+
+/// What happens to a client whose outbound queue is already full
+enum class SlowConsumerPolicy { Disconnect, DropOldest, Conflate };
+
+/// Bounded ring of frames waiting for the socket to become writable,
+/// remembers how much of the front frame has already been written.
+/// The ring is allocated on first use, a client that keeps up never needs it.
+class OutboundQueue
+{
+public:
+    OutboundQueue(const size_t& l_capacity = 256);
+
+    void setCapacity(const size_t& l_capacity);
+    size_t getCapacity() const { return m_capacity; }
+
+    /// returns false only when the queue is full and l_policy is SlowConsumerPolicy::Disconnect
+    bool push(const Frame& l_frame, const SlowConsumerPolicy& l_policy);
+    /// only while empty(): sends l_frame straight away and queues just the part the socket did not take
+    sf::Socket::Status write(const Frame& l_frame, sf::TcpSocket& l_socket);
+    sf::Socket::Status write(const Frame& l_frame, Connection& l_connection);
+    /// Done when everything was written, NotReady/Partial when the socket would block.
+    /// Queued frames are gathered into one sendmsg() call where it is available,
+    /// l_cork keeps the socket corked while a backlog takes more than one call.
+    sf::Socket::Status flush(sf::TcpSocket& l_socket, const bool& l_cork = false);
+    /// gathered into sendmsg() when l_connection has a socket, otherwise frame by frame
+    sf::Socket::Status flush(Connection& l_connection, const bool& l_cork = false);
+    void clear();
+
+    bool empty() const { return m_count == 0; }
+    size_t size() const { return m_count; }
+    size_t bytes() const { return m_bytes; }
+    size_t dropped() const { return m_dropped; }
+private:
+    std::vector<Frame> m_ring;
+    size_t m_capacity;
+    size_t m_head;
+    size_t m_count;
+    size_t m_offset;
+    size_t m_bytes;
+    size_t m_dropped;
+
+    Frame& at(const size_t& l_index) { return m_ring[(m_head + l_index) % m_ring.size()]; }
+    void consume(size_t l_bytes);
+    void popFront();
+    void eraseAt(const size_t& l_index);
+    bool conflate(const Frame& l_frame);
+    // the same for sf::TcpSocket and Connection, both send like sf::TcpSocket
+    template <class T>
+    sf::Socket::Status writeTo(const Frame& l_frame, T& l_stream);
+    template <class T>
+    sf::Socket::Status flushEach(T& l_stream);
+};
+
+#endif // OUTBOUNDQUEUE_H
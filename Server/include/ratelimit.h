@@ -0,0 +1,128 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <initializer_list>
+#include <unordered_map>
+
+/// l_rate tokens per second, at most l_burst saved up (defaults to one second worth), 0 is unlimited
+struct RateLimit{
+    RateLimit(const double& l_rate = 0, const double& l_burst = 0) : m_rate(l_rate), m_burst(l_burst > 0 ? l_burst : l_rate) {}
+    double m_rate;
+    double m_burst;
+
+    bool isEnabled() const { return m_rate > 0; }
+};
+
+class TokenBucket
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket() : m_tokens(0), m_started(false) {}
+
+    /// whether there are l_cost tokens, a fresh bucket starts full
+    bool covers(const RateLimit& l_limit, const double& l_cost, const Clock::time_point& l_now)
+    {
+        if(!l_limit.isEnabled()){
+            return true;
+        }
+        refill(l_limit, l_now);
+        return m_tokens >= l_cost;
+    }
+    /// takes l_cost tokens if there are enough of them
+    bool take(const RateLimit& l_limit, const double& l_cost, const Clock::time_point& l_now)
+    {
+        if(!covers(l_limit, l_cost, l_now)){
+            return false;
+        }
+        if(l_limit.isEnabled()){
+            m_tokens -= l_cost;
+        }
+        return true;
+    }
+    /// a full bucket holds no state, it can be dropped and recreated
+    bool isFull(const RateLimit& l_limit, const Clock::time_point& l_now)
+    {
+        if(!l_limit.isEnabled()){
+            return true;
+        }
+        refill(l_limit, l_now);
+        return m_tokens >= l_limit.m_burst;
+    }
+private:
+    double m_tokens;
+    bool m_started;
+    Clock::time_point m_last;
+
+    void refill(const RateLimit& l_limit, const Clock::time_point& l_now)
+    {
+        if(!m_started){
+            m_tokens = l_limit.m_burst;
+            m_started = true;
+        } else{
+            std::chrono::duration<double> elapsed = l_now - m_last;
+            m_tokens = std::min(l_limit.m_burst, m_tokens + elapsed.count() * l_limit.m_rate);
+        }
+        m_last = l_now;
+    }
+};
+
+/// What the receive path meters: packets after the login, their bytes and password attempts
+enum class RateKind { Messages, Bytes, Passwords };
+
+/// what one packet takes from the buckets of one kind
+struct RateCost{
+    RateKind m_kind;
+    double m_tokens;
+};
+
+struct RateLimits{
+    RateLimit m_messages;
+    RateLimit m_bytes;
+    RateLimit m_passwords;
+
+    const RateLimit& get(const RateKind& l_kind) const { return l_kind == RateKind::Messages ? m_messages : l_kind == RateKind::Bytes ? m_bytes : m_passwords; }
+    bool isEnabled() const { return m_messages.isEnabled() || m_bytes.isEnabled() || m_passwords.isEnabled(); }
+};
+
+struct RateBuckets{
+    TokenBucket m_buckets[3];
+
+    TokenBucket& get(const RateKind& l_kind) { return m_buckets[static_cast<size_t>(l_kind)]; }
+};
+
+/// Buckets shared by every connection from one address, possibly on different shards
+struct AddressBuckets{
+    std::mutex m_mutex;
+    RateBuckets m_buckets;
+};
+
+/// Per address buckets that outlive the connections, so reconnecting does not refill them.
+/// Idle entries are dropped once their buckets are full again.
+class AddressLimiter
+{
+public:
+    AddressLimiter() : m_acquired(0) {}
+
+    void setLimits(const RateLimits& l_limits) { m_limits = l_limits; }
+    const RateLimits& getLimits() const { return m_limits; }
+
+    /// nullptr when no per address limit is set
+    std::shared_ptr<AddressBuckets> acquire(const std::string& l_ip);
+    void clear();
+    size_t size();
+private:
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<AddressBuckets>> m_addresses;
+    RateLimits m_limits;
+    size_t m_acquired;
+
+    void sweep();
+};
+
+#endif // RATELIMIT_H
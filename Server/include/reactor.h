@@ -0,0 +1,105 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <SFML/Network.hpp>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include "../../Shared/transport.h"
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+enum class Backend { Selector, Epoll };
+
+struct ReadyEvent{
+    void* m_data;
+    bool m_readable;
+    bool m_writable;
+};
+
+using ReadyList = std::vector<ReadyEvent>;
+
+/// Waits for readiness on a set of sockets and reports only the ones that are ready
+class Reactor
+{
+public:
+    Reactor();
+    virtual ~Reactor() {}
+
+    virtual bool add(sf::Socket& l_socket, void* l_data) = 0;
+    virtual void remove(sf::Socket& l_socket) = 0;
+    /// a source without a socket is watched through its notifier, with every backend
+    bool add(Pollable& l_source, void* l_data);
+    void remove(Pollable& l_source);
+    void clear();
+    /// returns false on timeout or wake up, otherwise l_ready holds every socket that became ready
+    bool wait(const sf::Time& l_timeout, ReadyList& l_ready);
+    /// interrupts wait() from any thread
+    void wakeUp();
+
+    /// true when a readiness is reported once per edge, sockets have to be drained until NotReady
+    virtual bool isEdgeTriggered() const = 0;
+    /// false when writability is never reported, pending output has to be retried by the caller
+    virtual bool notifiesWritable() const = 0;
+
+    /// falls back to Backend::Selector when the requested backend is unavailable on this platform
+    static std::unique_ptr<Reactor> create(const Backend& l_backend);
+protected:
+    virtual bool poll(const sf::Time& l_timeout, ReadyList& l_ready) = 0;
+    virtual void removeAll() = 0;
+private:
+    // loopback datagram socket used as a self-pipe, works with every backend
+    sf::UdpSocket m_waker;
+    unsigned short m_wakerPort;
+    std::atomic<bool> m_wakePending;
+    // sources reporting readiness themselves, only touched by the waiting thread
+    std::unordered_map<Pollable*, void*> m_signaling;
+    // readiness they reported from any thread since the last wait()
+    std::mutex m_signalMutex;
+    ReadyList m_signaled;
+
+    void signal(void* l_data, const bool& l_readable, const bool& l_writable);
+};
+
+/// Portable backend on top of sf::SocketSelector (select(), limited by FD_SETSIZE)
+class SelectorReactor : public Reactor
+{
+public:
+    bool add(sf::Socket& l_socket, void* l_data);
+    void remove(sf::Socket& l_socket);
+    bool isEdgeTriggered() const { return false; }
+    bool notifiesWritable() const { return false; }
+protected:
+    bool poll(const sf::Time& l_timeout, ReadyList& l_ready);
+    void removeAll();
+private:
+    sf::SocketSelector m_selector;
+    std::vector<std::pair<sf::Socket*, void*>> m_sockets;
+    std::unordered_map<sf::Socket*, size_t> m_indexes;
+};
+
+#ifdef __linux__
+/// Edge-triggered epoll backend, cost of a wake depends only on the number of ready sockets
+class EpollReactor : public Reactor
+{
+public:
+    EpollReactor();
+    ~EpollReactor();
+
+    bool add(sf::Socket& l_socket, void* l_data);
+    void remove(sf::Socket& l_socket);
+    bool isEdgeTriggered() const { return true; }
+    bool notifiesWritable() const { return true; }
+protected:
+    bool poll(const sf::Time& l_timeout, ReadyList& l_ready);
+    void removeAll();
+private:
+    int m_epoll;
+    std::vector<epoll_event> m_events;
+};
+#endif
+
+#endif // REACTOR_H
@@ -0,0 +1,93 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <SFML/Network.hpp>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "../../Shared/shared.h"
+
+struct ClientServerData;
+struct Shard;
+
+/// Stable reference to a client, goes stale instead of dangling once the client is removed
+struct ClientHandle{
+    ClientHandle() : m_slot(0), m_generation(0) {}
+    ClientHandle(const sf::Uint32& l_slot, const sf::Uint32& l_generation) : m_slot(l_slot), m_generation(l_generation) {}
+    sf::Uint32 m_slot;
+    sf::Uint32 m_generation;
+
+    bool isValid() const { return m_generation != 0; }
+    bool operator==(const ClientHandle& l_other) const { return m_slot == l_other.m_slot && m_generation == l_other.m_generation; }
+    bool operator!=(const ClientHandle& l_other) const { return !(*this == l_other); }
+};
+
+struct RegistryMember{
+    ClientHandle m_handle;
+    std::string m_name;
+    ClientType m_type;
+};
+
+/// Every client of every shard by handle, indexed by ip from accept and by nickname once logged in.
+/// A resolved pointer stays valid only while the lock of the shard owning the client is held.
+class ClientRegistry
+{
+public:
+    ClientRegistry() : m_byName(&Slot::m_name, &Slot::m_nextByName), m_byIp(&Slot::m_ip, &Slot::m_nextByIp), m_size(0) {}
+
+    ClientHandle add(ClientServerData* l_client, Shard* l_shard, const std::string& l_ip);
+    void setName(const ClientHandle& l_handle, const std::string& l_name, const ClientType& l_type);
+    void setType(const ClientHandle& l_handle, const ClientType& l_type);
+    void remove(const ClientHandle& l_handle);
+    void clear();
+
+    ClientServerData* get(const ClientHandle& l_handle) const;
+    Shard* getShard(const ClientHandle& l_handle) const;
+    ClientHandle findByName(const std::string& l_name) const;
+    /// a logged in client at l_ip if there is one
+    ClientHandle findByIp(const std::string& l_ip) const;
+    size_t size() const;
+    /// the client in a slot if it has a name, i.e. finished logging in
+    bool getMember(const sf::Uint32& l_slot, RegistryMember& l_member) const;
+    /// memory one client takes in the registry
+    static constexpr size_t bytesPerClient() { return sizeof(Slot) + 2 * sizeof(sf::Uint32); }
+private:
+    static constexpr sf::Uint32 None = sf::Uint32(-1);
+    struct Slot{
+        Slot() : m_client(nullptr), m_shard(nullptr), m_generation(1), m_type(ClientType::Normie), m_nextByName(None), m_nextByIp(None) {}
+        ClientServerData* m_client;
+        Shard* m_shard;
+        sf::Uint32 m_generation;
+        ClientType m_type;
+        // recycled slots keep the capacity of their strings
+        std::string m_name;
+        std::string m_ip;
+        // chains of the indexes run through the slots
+        sf::Uint32 m_nextByName;
+        sf::Uint32 m_nextByIp;
+    };
+    /// Hash of slots by m_name or m_ip. The chains are links in the slots themselves, so indexing a
+    /// client allocates nothing, only the bucket array grows, by doubling like m_slots does
+    struct Index{
+        Index(std::string Slot::* l_key, sf::Uint32 Slot::* l_next) : m_key(l_key), m_next(l_next), m_size(0) {}
+        std::string Slot::* m_key;
+        sf::Uint32 Slot::* m_next;
+        std::vector<sf::Uint32> m_buckets;
+        size_t m_size;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<Slot> m_slots;
+    std::vector<sf::Uint32> m_free;
+    Index m_byName;
+    Index m_byIp;
+    size_t m_size;
+
+    const Slot* resolve(const ClientHandle& l_handle) const;
+    void index(Index& l_index, const sf::Uint32& l_slot);
+    void unindex(Index& l_index, const sf::Uint32& l_slot);
+    sf::Uint32 find(const Index& l_index, const std::string& l_key) const;
+    void clearIndex(Index& l_index);
+};
+
+#endif // REGISTRY_H
@@ -10,17 +10,122 @@
 #include <unordered_map>
 #include <functional>
 #include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include "../../Shared/shared.h"
+#include "../../Shared/frame.h"
+#include "../../Shared/packetreader.h"
+#include "../../Shared/messages.h"
+#include "reactor.h"
+#include "mpscqueue.h"
+#include "outboundqueue.h"
+#include "registry.h"
+#include "slabpool.h"
+#include "socketoptions.h"
+#include "history.h"
+#include "journal.h"
+#include "channels.h"
+#include "ratelimit.h"
+#include "blocklist.h"
+#include "metrics.h"
+#include "tracing.h"
+#include "listener.h"
+
+struct Shard;
+
+/// Steps of the login driven by the reactor: ServerPasswordNeeded -> Password -> ServerConnected -> name/type
+enum class HandshakeState { AwaitingPassword, AwaitingClientData, Connected };
 
 struct ClientServerData{
-    ClientServerData() : m_connected(false) {}
+    ClientServerData() : m_state(HandshakeState::AwaitingPassword), m_protocol(Protocol::V1), m_connected(false), m_removed(false), m_flushPending(false), m_batched(false),
+                         m_index(0), m_handshakeIndex(0), m_historySequence(0), m_traced(0), m_shard(nullptr) {}
     ClientData m_client;
     std::string m_ip;
+    OutboundQueue m_outbound;
+    HandshakeState m_state;
+    Protocol m_protocol;
+    ClientHandle m_handle;
+    std::chrono::steady_clock::time_point m_deadline;
     bool m_connected;
+    bool m_removed;
+    bool m_flushPending;
+    bool m_batched;
+    size_t m_index;
+    size_t m_handshakeIndex;
+    /// newest history frame replayed on join, broadcasts up to it were already delivered
+    std::uint64_t m_historySequence;
+    /// traced packet whose frame is the newest one waiting in m_outbound
+    std::uint64_t m_traced;
+    std::vector<std::string> m_channels;
+    RateBuckets m_buckets;
+    std::shared_ptr<AddressBuckets> m_address;
+    Shard* m_shard;
+
+    /// records are recycled through a slab pool, see getStats() for its footprint
+    static void* operator new(std::size_t l_size);
+    static void operator delete(void* l_pointer, std::size_t l_size);
+    static SlabPool<ClientServerData>& pool();
 };
 
 using Clients = std::vector<std::unique_ptr<ClientServerData>>;
-using Blocked = std::unordered_set<std::string>;
+
+/// Work handed to a shard by other threads: an accepted connection or a broadcast to forward
+struct ShardTask{
+    std::unique_ptr<ClientServerData> m_client;
+    Frame m_frame;
+    Frame m_compact;
+    std::uint64_t m_sequence = 0;
+    /// set for a channel message, only members of the channel get m_frame
+    std::string m_channel;
+    /// set for a direct message, only this client gets m_frame
+    ClientHandle m_target;
+    /// traced packet the frame was made for
+    std::uint64_t m_traced = 0;
+};
+
+/// Reactor thread together with the partition of clients it owns
+struct Shard{
+    Shard(const size_t& l_id, const Backend& l_backend) : m_id(l_id), m_reactor(Reactor::create(l_backend)) {}
+    size_t m_id;
+    std::unique_ptr<Reactor> m_reactor;
+    std::mutex m_mutex;
+    Clients m_clients;
+    ReadyList m_ready;
+    std::vector<ClientServerData*> m_removals;
+    std::vector<ClientServerData*> m_pendingFlush;
+    std::vector<ClientServerData*> m_handshaking;
+    std::chrono::steady_clock::time_point m_lastSweep;
+    /// clients with frames held back by the coalescing window, all flushed at m_batchDeadline
+    std::vector<ClientServerData*> m_batch;
+    std::chrono::steady_clock::time_point m_batchDeadline;
+    std::thread::id m_owner;
+    /// channel -> members owned by this shard
+    std::unordered_map<std::string, std::vector<ClientServerData*>> m_channels;
+    MpscQueue<ShardTask> m_tasks;
+    std::thread m_thread;
+    ShardMetrics m_metrics;
+};
+
+using Shards = std::vector<std::unique_ptr<Shard>>;
+
+/// Snapshot of the live counters, m_connected also holds slots reserved by logins in progress
+struct ServerStats{
+    sf::Uint32 m_connected;
+    sf::Uint32 m_handshaking;
+    sf::Uint32 m_normies;
+    sf::Uint32 m_administrators;
+    sf::Uint32 m_max;
+    size_t m_pooledRecords;
+    /// memory of every connection: its pooled record, its pooled socket and its registry entry
+    size_t m_recordBytes;
+    /// added for a connection once its outbound ring is allocated, i.e. it fell behind once
+    size_t m_ringBytes;
+    /// packets dropped by the rate limits, by what ran out
+    sf::Uint64 m_throttledMessages;
+    sf::Uint64 m_throttledBytes;
+    sf::Uint64 m_throttledPasswords;
+};
 
 class Server
 {
@@ -34,19 +139,74 @@ public:
     void setPassword(const std::string& l_password) { m_password = l_password; }
     void setPort(const sf::Uint16& l_port) { m_port = l_port; }
     void setMaxNumberOfClients(const sf::Uint32& l_max) { m_max = l_max; }
+    void setBackend(const Backend& l_backend);
+    void setReactorThreads(const size_t& l_threads);
+    void setSlowConsumerPolicy(const SlowConsumerPolicy& l_policy) { m_slowConsumerPolicy = l_policy; }
+    void setOutboundLimit(const size_t& l_frames) { m_outboundLimit = l_frames; }
+    void setHandshakeTimeout(const std::chrono::milliseconds& l_timeout) { m_handshakeTimeout = l_timeout; }
+    void setMaxProtocol(const Protocol& l_protocol) { m_maxProtocol = l_protocol; }
+    /// 0 sends every frame right away, otherwise frames are batched for up to l_window
+    void setCoalesceWindow(const std::chrono::microseconds& l_window) { m_coalesceWindow = l_window; }
+    void setNoDelay(const bool& l_noDelay) { m_noDelay = l_noDelay; }
+    void setCork(const bool& l_cork) { m_cork = l_cork; }
+    /// bytes of recent messages replayed to every client that joins, 0 turns the history off
+    void setHistoryBytes(const size_t& l_bytes) { m_history.setCapacity(l_bytes); }
+    /// directory of the message journal, empty keeps nothing on disk
+    void setJournal(const std::string& l_directory) { m_journalDirectory = l_directory; }
+    void setJournalSegmentBytes(const size_t& l_bytes) { m_journal.setSegmentBytes(l_bytes); }
+    void setJournalRetainedBytes(const size_t& l_bytes) { m_journal.setRetainedBytes(l_bytes); }
+    /// file the blocklist is loaded from on start and saved to on every change, empty keeps it in memory
+    void setBlocklist(const std::string& l_path) { m_blocklistPath = l_path; }
+    /// appends getMetrics().toJson() to l_path every l_interval while running, empty turns it off
+    void setMetricsDump(const std::string& l_path, const std::chrono::seconds& l_interval) { m_metricsPath = l_path; m_metricsInterval = l_interval; }
+    /// lifecycle events kept per thread for dumpTrace(), 0 turns tracing off
+    void setTraceEvents(const size_t& l_events) { m_tracer.setCapacity(l_events); }
+    /// token buckets of every single connection and of all connections from one ip together
+    void setConnectionLimits(const RateLimits& l_limits) { m_connectionLimits = l_limits; }
+    void setAddressLimits(const RateLimits& l_limits) { m_addressLimiter.setLimits(l_limits); }
+    /// where connections come from, a TcpListener unless replaced before run()
+    void setListener(std::unique_ptr<Listener> l_listener) { m_listener = std::move(l_listener); }
 
     /// GETTERS
     std::string getPassword() { return m_password; }
     sf::Uint16 getPort() { return m_port; }
     sf::Uint32 getMaxNumberOfClients() { return m_max; }
+    Backend getBackend() { return m_backend; }
+    size_t getReactorThreads() { return m_shards.size(); }
+    SlowConsumerPolicy getSlowConsumerPolicy() { return m_slowConsumerPolicy; }
+    size_t getOutboundLimit() { return m_outboundLimit; }
+    std::chrono::milliseconds getHandshakeTimeout() { return m_handshakeTimeout; }
+    Protocol getMaxProtocol() { return m_maxProtocol; }
+    std::chrono::microseconds getCoalesceWindow() { return m_coalesceWindow; }
+    bool getNoDelay() { return m_noDelay; }
+    bool getCork() { return m_cork; }
+    size_t getHistoryBytes() { return m_history.getCapacity(); }
+    std::string getJournal() { return m_journalDirectory; }
+    std::string getBlocklist() { return m_blocklistPath; }
+    size_t getTraceEvents() { return m_tracer.getCapacity(); }
+    RateLimits getConnectionLimits() { return m_connectionLimits; }
+    RateLimits getAddressLimits() { return m_addressLimiter.getLimits(); }
+    ServerStats getStats() const;
+    MetricsSnapshot getMetrics() const;
+    /// writes the traced packets as Chrome trace-event JSON
+    bool dumpTrace(const std::string& l_path) { return m_tracer.dump(l_path); }
+    /// every channel with its number of members, sorted by name
+    std::vector<std::pair<std::string, size_t>> getChannels() const { return m_channelDirectory.getCounts(); }
 
     /// UTILITIES
+    /// l_ip is a single address or a CIDR range such as 10.0.0.0/24
     bool block(const std::string& l_ip);
     bool unblock(const std::string& l_ip);
     bool isBlocked(const std::string& l_ip);
+    bool isBlocked(const PeerAddress& l_address);
+    /// reads the blocklist file again and publishes it, the old one stays when the file is unreadable
+    bool reloadBlocklist();
+    std::vector<std::string> getBlockedRanges();
     bool kick(const std::string& l_ip, const bool& l_block = false);
     bool promote(const std::string& l_ip, const ClientType& l_type);
     bool promoteClient(std::unique_ptr<ClientServerData> &l_data, const ClientType &l_type);
+    /// connected client by nickname or ip (host names are resolved), invalid handle when there is none
+    ClientHandle findClient(const std::string& l_nameOrIp, bool* l_byIp = nullptr);
 
     bool sendMessageToAllClients(const std::string& l_text);
 
@@ -54,40 +214,119 @@ public:
     virtual int run();
     void quit();
 private:
-    sf::TcpListener m_listener;
-    sf::SocketSelector m_selector;
+    std::unique_ptr<Listener> m_listener;
+    Backend m_backend;
+    size_t m_nextShard;
+    SlowConsumerPolicy m_slowConsumerPolicy;
+    size_t m_outboundLimit;
+    std::chrono::milliseconds m_handshakeTimeout;
+    Protocol m_maxProtocol;
+    std::atomic<sf::Uint32> m_compactClients;
+    std::chrono::microseconds m_coalesceWindow;
+    bool m_noDelay;
+    bool m_cork;
+    ChatHistory m_history;
+    Journal m_journal;
+    std::string m_journalDirectory;
+    RateLimits m_connectionLimits;
+    AddressLimiter m_addressLimiter;
+    std::atomic<sf::Uint64> m_throttled[3];
+    // counted by whichever thread accepts, the rest of the metrics live in the shards
+    std::atomic<std::uint64_t> m_accepted;
+    std::atomic<std::uint64_t> m_blockedPeers;
+    std::string m_metricsPath;
+    std::chrono::seconds m_metricsInterval;
+    Tracer m_tracer;
 
+    void createShards(const size_t& l_count);
+    void runShard(Shard& l_shard);
+    void dumpMetrics();
+    void processTasks(Shard& l_shard);
+    void acceptNewClients();
+    void receiveFrom(std::unique_ptr<ClientServerData>& l_client);
+    bool admitPacket(std::unique_ptr<ClientServerData>& l_client, const sf::Packet& l_packet);
+    bool takeTokens(std::unique_ptr<ClientServerData>& l_client, std::initializer_list<RateCost> l_costs, const TokenBucket::Clock::time_point& l_now);
+    void scheduleRemoval(std::unique_ptr<ClientServerData>& l_client);
+    void processRemovals(Shard& l_shard);
+    void sendToShard(Shard& l_shard, const ShardTask& l_task, std::unique_ptr<ClientServerData>* l_except);
+    void sendWelcome(std::unique_ptr<ClientServerData>& l_client);
+    void sendMember(std::unique_ptr<ClientServerData>& l_client, const sf::Uint32& l_slot);
+    void sendHistory(std::unique_ptr<ClientServerData>& l_client);
+    bool openJournal();
+    bool updateBlocklist(const std::function<bool(Blocklist&)>& l_change);
+    void journalEvent(const JournalKind& l_kind, std::unique_ptr<ClientServerData>& l_client, const sf::Uint8& l_detail);
+    bool flushClient(std::unique_ptr<ClientServerData>& l_client);
+    bool handleSendStatus(std::unique_ptr<ClientServerData>& l_client, const sf::Socket::Status& l_status);
+    void flushPending(Shard& l_shard);
+    void addToBatch(std::unique_ptr<ClientServerData>& l_client);
+    void flushBatch(Shard& l_shard);
+    void dropClient(std::unique_ptr<ClientServerData>& l_client, const Type& l_notification = Type::Disconnection);
 
-    void processNewClient(std::unique_ptr<ClientServerData> && l_socket);
-    void finishNewClient(std::unique_ptr<ClientServerData>& l_socket);
-    void prepareNewClient(std::unique_ptr<ClientServerData>& l_socket);
+    void processNewClient(Shard& l_shard, std::unique_ptr<ClientServerData> && l_socket);
+    void admitNewClient(std::unique_ptr<ClientServerData>& l_client);
+    void finishNewClient(std::unique_ptr<ClientServerData>& l_socket, sf::Packet& l_packet);
+    void leaveHandshake(ClientServerData* l_client);
+    void sweepHandshakes(Shard& l_shard);
+    bool reserveSlot();
+    void onHandshakePacketReceived(std::unique_ptr<ClientServerData>& l_client, sf::Packet& l_packet);
 
     void onClientPacketReceived(std::unique_ptr<ClientServerData>& l_client, sf::Packet& l_packet);
+    void relayMessage(std::unique_ptr<ClientServerData>& l_client, std::string_view l_text);
+    void joinChannel(std::unique_ptr<ClientServerData>& l_client, std::string_view l_channel);
+    void leaveChannel(std::unique_ptr<ClientServerData>& l_client, std::string_view l_channel);
+    void relayChannelMessage(std::unique_ptr<ClientServerData>& l_client, std::string_view l_channel, std::string_view l_text);
+    void sendToChannelShard(Shard& l_shard, const std::string& l_channel, const Frame& l_frame, std::unique_ptr<ClientServerData>* l_except);
+    static void unindexChannel(Shard& l_shard, const std::string& l_channel, ClientServerData* l_client);
+    void relayDirectMessage(std::unique_ptr<ClientServerData>& l_client, std::string_view l_recipient, std::string_view l_text);
+    void sendToTarget(Shard& l_shard, const ShardTask& l_task);
 protected:
+    ClientRegistry m_registry;
+    ChannelDirectory m_channelDirectory;
     Shared m_shared;
-    std::mutex m_mutex;
-    Clients m_clients;
-    Blocked m_blocked;
+    Shards m_shards;
+    // the listener only ever reads a published snapshot, changes copy it and publish the copy
+    std::shared_ptr<const Blocklist> m_blocked;
+    // serializes the writers, so no change is lost between copying and publishing
+    std::mutex m_blockedMutex;
+    std::string m_blocklistPath;
     sf::Uint16 m_port;
     sf::Uint32 m_max;
     std::string m_password;
     std::string m_version;
-    bool m_running;
+    std::atomic<bool> m_running;
+    std::atomic<sf::Uint32> m_connectedClients;
+    std::atomic<sf::Uint32> m_handshakingClients;
+    std::atomic<sf::Uint32> m_clientsOfType[2];
+
+    void countClientOfType(const ClientType& l_type, const int& l_delta);
+    /// locks the shard owning l_handle, nullptr when the client is already gone
+    std::unique_ptr<ClientServerData>* lockClient(const ClientHandle& l_handle, std::unique_lock<std::mutex>& l_lock);
 
-    bool sendMessageToAllClientsFrom(std::unique_ptr<ClientServerData>& l_client, const std::string& l_text);
+    bool sendMessageToAllClientsFrom(std::unique_ptr<ClientServerData>& l_client, std::string_view l_text);
     bool sendMessageToAllClients(sf::Packet& l_packet, std::unique_ptr<ClientServerData>* l_except = nullptr);
+    /// l_compact is the protocol v2 encoding of l_frame, clients on v2 get it when it is set.
+    /// l_sequence is the history number of l_frame, clients that joined with it replayed skip it
+    bool sendFrameToAllClients(const Frame& l_frame, std::unique_ptr<ClientServerData>* l_except = nullptr, const Frame& l_compact = nullptr,
+                               const std::uint64_t& l_sequence = 0);
+    bool hasCompactClients() const { return m_compactClients != 0; }
+    /// reaches only the members of l_channel, in O(members)
+    bool sendFrameToChannel(const std::string& l_channel, const Frame& l_frame, std::unique_ptr<ClientServerData>* l_except = nullptr);
     bool sendMessageTo(std::unique_ptr<ClientServerData>& l_data, const std::string& l_text);
     bool sendMessageTo(std::unique_ptr<ClientServerData>& l_data, sf::Packet& l_text);
-    bool sendConnectionNotification(const std::string& l_name, const Type& l_type, std::unique_ptr<ClientServerData>* l_except = nullptr);
+    bool sendFrameTo(std::unique_ptr<ClientServerData>& l_data, const Frame& l_frame);
+    /// tells everyone but l_client that it connected, disconnected or was kicked
+    bool sendConnectionNotification(std::unique_ptr<ClientServerData>& l_client, const Type& l_type);
 
-    virtual void onClientBlocked(std::unique_ptr<ClientServerData>& l_client) = 0;
+    virtual void onClientBlocked(const std::string& l_ip) = 0;
     virtual void onClientRejected(std::unique_ptr<ClientServerData>& l_client) = 0;
     virtual void onClientConnected(std::unique_ptr<ClientServerData>& l_client) = 0;
     virtual void onClientDisconnected(std::unique_ptr<ClientServerData>& l_client) = 0;
-    virtual void onClientMessageReceived(std::unique_ptr<ClientServerData>& l_client, const std::string& l_text) = 0;
+    virtual void onClientMessageReceived(std::unique_ptr<ClientServerData>& l_client, std::string_view l_text) = 0;
     virtual void onClientPromoted(std::unique_ptr<ClientServerData>& l_client, const bool& l_promoted) = 0;
     virtual void onErrorWithReceivingData(std::unique_ptr<ClientServerData>& l_client) = 0;
     virtual void onErrorWithSendingData(std::unique_ptr<ClientServerData>& l_client) = 0;
+    virtual void onClientTooSlow(std::unique_ptr<ClientServerData>& l_client) = 0;
+    virtual void onHandshakeTimeout(std::unique_ptr<ClientServerData>& l_client) = 0;
     virtual void onArgumentsError(const char*) = 0;
     virtual void error(const std::string& l_error) = 0;
 };
@@ -0,0 +1,68 @@
+#ifndef SLABPOOL_H
+#define SLABPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/// Fixed-size storage for T carved out of slabs of SlabSize slots. Freed slots are
+/// recycled LIFO and slabs are never returned, so steady churn does not touch the heap.
+template <class T, size_t SlabSize = 256>
+class SlabPool
+{
+    union Slot{
+        Slot* m_next;
+        alignas(T) unsigned char m_storage[sizeof(T)];
+    };
+public:
+    SlabPool() : m_free(nullptr), m_inUse(0) {}
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    void* allocate()
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if(!m_free){
+            grow();
+        }
+        Slot* slot = m_free;
+        m_free = slot->m_next;
+        ++m_inUse;
+        return slot->m_storage;
+    }
+
+    void deallocate(void* l_pointer)
+    {
+        if(!l_pointer){
+            return;
+        }
+        std::lock_guard<std::mutex> lk(m_mutex);
+        Slot* slot = reinterpret_cast<Slot*>(l_pointer);
+        slot->m_next = m_free;
+        m_free = slot;
+        --m_inUse;
+    }
+
+    size_t inUse() const { std::lock_guard<std::mutex> lk(m_mutex); return m_inUse; }
+    size_t capacity() const { std::lock_guard<std::mutex> lk(m_mutex); return m_slabs.size() * SlabSize; }
+    static constexpr size_t bytesPerSlot() { return sizeof(Slot); }
+private:
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Slot[]>> m_slabs;
+    Slot* m_free;
+    size_t m_inUse;
+
+    void grow()
+    {
+        m_slabs.emplace_back(new Slot[SlabSize]);
+        Slot* slab = m_slabs.back().get();
+        for(size_t i = 0; i < SlabSize; ++i){
+            slab[i].m_next = i + 1 < SlabSize ? &slab[i + 1] : m_free;
+        }
+        m_free = slab;
+    }
+};
+
+#endif // SLABPOOL_H
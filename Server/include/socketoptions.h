@@ -0,0 +1,21 @@
+#ifndef SOCKETOPTIONS_H
+#define SOCKETOPTIONS_H
+
+#include <SFML/Network.hpp>
+#include "blocklist.h"
+
+/// SFML turns Nagle's algorithm off for every tcp socket, this switches it back on or off
+bool setNoDelay(sf::TcpSocket& l_socket, const bool& l_noDelay);
+/// Linux TCP_CORK: while corked only full segments leave, uncorking sends the remainder at once.
+/// Returns false where the option does not exist.
+bool setCork(sf::TcpSocket& l_socket, const bool& l_cork);
+
+/// accept() without an sf::TcpSocket, so the peer can be looked at before anything is allocated.
+/// False when no connection is pending
+bool acceptPeer(sf::TcpListener& l_listener, sf::SocketHandle& l_handle, PeerAddress& l_address);
+/// hands a connection from acceptPeer() over to l_socket, as sf::TcpListener::accept() would
+void adoptPeer(sf::TcpSocket& l_socket, const sf::SocketHandle& l_handle);
+/// sends l_data if the socket takes it right away and closes the connection
+void rejectPeer(const sf::SocketHandle& l_handle, const char* l_data, const size_t& l_size);
+
+#endif // SOCKETOPTIONS_H
@@ -0,0 +1,86 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// Steps of a packet through the server, Enqueue once per recipient
+enum class TracePoint : sf::Uint8 { Receive, Decode, HandlerEnter, HandlerExit, Enqueue, Flush };
+
+struct TraceEvent{
+    /// nanoseconds since the tracer was created
+    std::uint64_t m_time;
+    std::uint64_t m_packet;
+    TracePoint m_point;
+};
+
+/// Packet lifecycle events kept in one ring per recording thread, the oldest are overwritten.
+/// A thread only ever locks its own ring, which nobody else touches except a dump.
+/// Every hook starts with a relaxed load of the enabled flag, that is all tracing costs while off.
+///
+/// The packet being handled is tracked per thread, work handed to another shard carries its id along.
+class Tracer
+{
+public:
+    Tracer();
+
+    /// events kept per thread, 0 turns tracing off. Recorded events are dropped
+    void setCapacity(const size_t& l_events);
+    size_t getCapacity() const { return m_capacity; }
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    /// records Receive of a new packet and makes it the current one of this thread, 0 while off
+    std::uint64_t begin()
+    {
+        if(!isEnabled()){
+            return 0;
+        }
+        return beginPacket();
+    }
+    void record(const TracePoint& l_point, const std::uint64_t& l_packet)
+    {
+        if(l_packet && isEnabled()){
+            append(l_point, l_packet);
+        }
+    }
+    /// the packet this thread is handling, 0 when none or while off
+    std::uint64_t currentPacket() const { return isEnabled() ? current() : 0; }
+    static void setCurrent(const std::uint64_t& l_packet);
+
+    /// Chrome trace-event JSON, opens in chrome://tracing or Perfetto
+    std::string toJson();
+    bool dump(const std::string& l_path);
+private:
+    struct Ring{
+        std::mutex m_mutex;
+        std::vector<TraceEvent> m_events;
+        size_t m_next = 0;
+        bool m_wrapped = false;
+        size_t m_thread = 0;
+    };
+
+    std::atomic<bool> m_enabled;
+    size_t m_capacity;
+    std::uint64_t m_id;
+    std::atomic<std::uint64_t> m_nextPacket;
+    std::chrono::steady_clock::time_point m_epoch;
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    // the ring of every thread that recorded, for threads whose cached ring belongs to another tracer
+    std::unordered_map<std::thread::id, Ring*> m_byThread;
+
+    static std::uint64_t current();
+    std::uint64_t beginPacket();
+    void append(const TracePoint& l_point, const std::uint64_t& l_packet);
+    Ring& ring();
+};
+
+#endif // TRACING_H
@@ -0,0 +1,297 @@
+#include "blocklist.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    bool bitAt(const PeerAddress& l_address, const size_t& l_bit)
+    {
+        return (l_address.m_bytes[l_bit / 8] >> (7 - l_bit % 8)) & 1;
+    }
+
+    const sf::Uint8 MappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    const char FileMagic[4] = {'B', 'L', 'K', 1};
+}
+
+std::string PeerAddress::toString() const
+{
+    char text[INET6_ADDRSTRLEN] = {};
+    if(m_length == 4){
+        inet_ntop(AF_INET, m_bytes, text, sizeof(text));
+    } else if(m_length == 16){
+        inet_ntop(AF_INET6, m_bytes, text, sizeof(text));
+    }
+    return text;
+}
+
+bool PeerAddress::parse(const std::string &l_text, PeerAddress &l_address, size_t *l_prefix)
+{
+    size_t slash = l_text.find('/');
+    std::string ip = l_text.substr(0, slash);
+    l_address = PeerAddress();
+    if(inet_pton(AF_INET, ip.c_str(), l_address.m_bytes) == 1){
+        l_address.m_length = 4;
+    } else if(inet_pton(AF_INET6, ip.c_str(), l_address.m_bytes) == 1){
+        l_address.m_length = 16;
+    } else{
+        return false;
+    }
+    size_t bits = l_address.m_length * 8;
+    size_t prefix = bits;
+    if(slash != std::string::npos){
+        std::string suffix = l_text.substr(slash + 1);
+        if(suffix.empty() || suffix.size() > 3 || suffix.find_first_not_of("0123456789") != std::string::npos){
+            return false;
+        }
+        prefix = std::stoul(suffix);
+        if(prefix > bits){
+            return false;
+        }
+    }
+    // ::ffff:a.b.c.d is the same peer as a.b.c.d
+    if(l_address.m_length == 16 && std::memcmp(l_address.m_bytes, MappedPrefix, sizeof(MappedPrefix)) == 0 && prefix >= 96){
+        std::memmove(l_address.m_bytes, l_address.m_bytes + 12, 4);
+        std::memset(l_address.m_bytes + 4, 0, 12);
+        l_address.m_length = 4;
+        prefix -= 96;
+    }
+    if(l_prefix){
+        *l_prefix = prefix;
+    } else if(prefix != l_address.m_length * 8){
+        return false;
+    }
+    return true;
+}
+
+Blocklist::Blocklist()
+{
+    clear();
+}
+
+bool Blocklist::insert(const std::string &l_range)
+{
+    PeerAddress address;
+    size_t prefix;
+    return PeerAddress::parse(l_range, address, &prefix) && insert(address, prefix);
+}
+
+bool Blocklist::insert(const PeerAddress &l_address, const size_t &l_prefix)
+{
+    if(!l_address.isValid() || l_prefix > l_address.m_length * 8){
+        return false;
+    }
+    sf::Int32 node = l_address.m_length == 4 ? 0 : 1;
+    for(size_t bit = 0; bit < l_prefix; ++bit){
+        bool side = bitAt(l_address, bit);
+        if(m_nodes[node].m_children[side] < 0){
+            m_nodes[node].m_children[side] = static_cast<sf::Int32>(m_nodes.size());
+            m_nodes.emplace_back();
+        }
+        node = m_nodes[node].m_children[side];
+    }
+    if(m_nodes[node].m_blocked){
+        return false;
+    }
+    m_nodes[node].m_blocked = true;
+    ++m_size;
+    return true;
+}
+
+bool Blocklist::erase(const std::string &l_range)
+{
+    PeerAddress address;
+    size_t prefix;
+    if(!PeerAddress::parse(l_range, address, &prefix)){
+        return false;
+    }
+    // the path stays, it is reused when the range is blocked again
+    sf::Int32 node = find(address, prefix);
+    if(node < 0 || !m_nodes[node].m_blocked){
+        return false;
+    }
+    m_nodes[node].m_blocked = false;
+    --m_size;
+    return true;
+}
+
+bool Blocklist::contains(const std::string &l_range) const
+{
+    PeerAddress address;
+    size_t prefix;
+    if(!PeerAddress::parse(l_range, address, &prefix)){
+        return false;
+    }
+    sf::Int32 node = find(address, prefix);
+    return node >= 0 && m_nodes[node].m_blocked;
+}
+
+bool Blocklist::matches(const PeerAddress &l_address) const
+{
+    if(!l_address.isValid()){
+        return false;
+    }
+    sf::Int32 node = l_address.m_length == 4 ? 0 : 1;
+    size_t bits = l_address.m_length * 8;
+    for(size_t bit = 0; node >= 0; ++bit){
+        if(m_nodes[node].m_blocked){
+            return true;
+        }
+        if(bit == bits){
+            break;
+        }
+        node = m_nodes[node].m_children[bitAt(l_address, bit)];
+    }
+    return false;
+}
+
+bool Blocklist::matches(const std::string &l_ip) const
+{
+    PeerAddress address;
+    return PeerAddress::parse(l_ip, address) && matches(address);
+}
+
+void Blocklist::clear()
+{
+    m_nodes.assign(2, Node());
+    m_size = 0;
+}
+
+std::vector<std::string> Blocklist::getRanges() const
+{
+    std::vector<std::string> ranges;
+    for(auto& range : collect()){
+        std::string text = range.first.toString();
+        if(range.second != range.first.m_length * 8){
+            text += '/' + std::to_string(range.second);
+        }
+        ranges.push_back(text);
+    }
+    return ranges;
+}
+
+bool Blocklist::save(const std::string &l_path) const
+{
+    std::vector<Range> ranges = collect();
+    std::vector<char> bytes(FileMagic, FileMagic + sizeof(FileMagic));
+    auto count = static_cast<sf::Uint32>(ranges.size());
+    for(int shift = 24; shift >= 0; shift -= 8){
+        bytes.push_back(static_cast<char>(count >> shift));
+    }
+    for(auto& range : ranges){
+        bytes.push_back(static_cast<char>(range.first.m_length));
+        bytes.push_back(static_cast<char>(range.second));
+        bytes.insert(bytes.end(), range.first.m_bytes, range.first.m_bytes + (range.second + 7) / 8);
+    }
+
+    std::string temporary = l_path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if(!file.write(bytes.data(), static_cast<std::streamsize>(bytes.size())) || !file.flush()){
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, l_path, error);
+    return !error;
+}
+
+bool Blocklist::load(const std::string &l_path)
+{
+    std::ifstream file(l_path, std::ios::binary);
+    if(!file){
+        return false;
+    }
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t header = sizeof(FileMagic) + sizeof(sf::Uint32);
+    if(bytes.size() < header || std::memcmp(bytes.data(), FileMagic, sizeof(FileMagic)) != 0){
+        return false;
+    }
+    sf::Uint32 count = 0;
+    for(size_t i = sizeof(FileMagic); i < header; ++i){
+        count = (count << 8) | static_cast<sf::Uint8>(bytes[i]);
+    }
+
+    // everything is checked before the trie is touched, which is then built in one go
+    std::vector<Range> ranges;
+    ranges.reserve(std::min<size_t>(count, bytes.size() / 2));
+    size_t nodes = 2;
+    size_t offset = header;
+    for(sf::Uint32 i = 0; i < count; ++i){
+        if(bytes.size() - offset < 2){
+            return false;
+        }
+        Range range;
+        range.first.m_length = static_cast<sf::Uint8>(bytes[offset]);
+        range.second = static_cast<sf::Uint8>(bytes[offset + 1]);
+        size_t length = (range.second + 7) / 8;
+        offset += 2;
+        if((range.first.m_length != 4 && range.first.m_length != 16) || range.second > range.first.m_length * 8 ||
+           bytes.size() - offset < length){
+            return false;
+        }
+        std::memcpy(range.first.m_bytes, bytes.data() + offset, length);
+        offset += length;
+        nodes += range.second;
+        ranges.push_back(range);
+    }
+    if(offset != bytes.size()){
+        return false;
+    }
+    Blocklist loaded;
+    loaded.m_nodes.reserve(nodes);
+    for(auto& range : ranges){
+        loaded.insert(range.first, range.second);
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+sf::Int32 Blocklist::find(const PeerAddress &l_address, const size_t &l_prefix) const
+{
+    sf::Int32 node = l_address.m_length == 4 ? 0 : 1;
+    for(size_t bit = 0; bit < l_prefix && node >= 0; ++bit){
+        node = m_nodes[node].m_children[bitAt(l_address, bit)];
+    }
+    return node;
+}
+
+std::vector<Blocklist::Range> Blocklist::collect() const
+{
+    std::vector<Range> ranges;
+    PeerAddress address;
+    address.m_length = 4;
+    collect(0, address, 0, ranges);
+    address = PeerAddress();
+    address.m_length = 16;
+    collect(1, address, 0, ranges);
+    return ranges;
+}
+
+void Blocklist::collect(const sf::Int32 &l_node, PeerAddress &l_address, const size_t &l_depth, std::vector<Range> &l_ranges) const
+{
+    const Node& node = m_nodes[l_node];
+    if(node.m_blocked){
+        l_ranges.emplace_back(l_address, l_depth);
+    }
+    for(int side = 0; side < 2; ++side){
+        if(node.m_children[side] < 0){
+            continue;
+        }
+        sf::Uint8 mask = static_cast<sf::Uint8>(0x80 >> (l_depth % 8));
+        if(side){
+            l_address.m_bytes[l_depth / 8] |= mask;
+        }
+        collect(node.m_children[side], l_address, l_depth + 1, l_ranges);
+        l_address.m_bytes[l_depth / 8] &= static_cast<sf::Uint8>(~mask);
+    }
+}
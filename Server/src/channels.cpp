@@ -0,0 +1,76 @@
+#include "channels.h"
+#include <algorithm>
+
+void ChannelDirectory::setShards(const size_t &l_shards)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_channels.clear();
+    m_shards = l_shards;
+}
+
+void ChannelDirectory::join(const std::string &l_channel, const size_t &l_shard)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto& channel = m_channels[l_channel];
+    if(channel.m_perShard.empty()){
+        channel.m_perShard.resize(m_shards);
+    }
+    ++channel.m_perShard[l_shard];
+    ++channel.m_members;
+}
+
+void ChannelDirectory::leave(const std::string &l_channel, const size_t &l_shard)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto itr = m_channels.find(l_channel);
+    if(itr == m_channels.end() || !itr->second.m_perShard[l_shard]){
+        return;
+    }
+    --itr->second.m_perShard[l_shard];
+    // a channel exists only while somebody is in it
+    if(!--itr->second.m_members){
+        m_channels.erase(itr);
+    }
+}
+
+void ChannelDirectory::clear()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_channels.clear();
+}
+
+std::vector<size_t> ChannelDirectory::getShards(const std::string &l_channel) const
+{
+    std::vector<size_t> shards;
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto itr = m_channels.find(l_channel);
+    if(itr == m_channels.end()){
+        return shards;
+    }
+    for(size_t i = 0; i < itr->second.m_perShard.size(); ++i){
+        if(itr->second.m_perShard[i]){
+            shards.push_back(i);
+        }
+    }
+    return shards;
+}
+
+size_t ChannelDirectory::getMembers(const std::string &l_channel) const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto itr = m_channels.find(l_channel);
+    return itr == m_channels.end() ? 0 : itr->second.m_members;
+}
+
+std::vector<std::pair<std::string, size_t>> ChannelDirectory::getCounts() const
+{
+    std::vector<std::pair<std::string, size_t>> counts;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        for(auto& itr : m_channels){
+            counts.emplace_back(itr.first, itr.second.m_members);
+        }
+    }
+    std::sort(counts.begin(), counts.end());
+    return counts;
+}
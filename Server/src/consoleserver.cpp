@@ -3,30 +3,42 @@
 ConsoleServer::ConsoleServer()
 {
     m_commands.emplace("clients", std::bind(&ConsoleServer::viewAllClients, this));
+    m_commands.emplace("channels", std::bind(&ConsoleServer::viewAllChannels, this));
     m_commands.emplace("message", std::bind(&ConsoleServer::sendMessage, this));
     m_commands.emplace("help", std::bind(&ConsoleServer::viewAllCommands, this));
     m_commands.emplace("clear", [this]() { system("cls"); });
     m_commands.emplace("info", std::bind(&ConsoleServer::printServerInfo, this));
+    m_commands.emplace("stats", std::bind(&ConsoleServer::printMetrics, this));
+    m_commands.emplace("trace", std::bind(&ConsoleServer::changeTracing, this));
+    m_commands.emplace("trace-dump", std::bind(&ConsoleServer::dumpTrace, this));
     m_commands.emplace("set-password", std::bind(&ConsoleServer::changePassword, this));
     m_commands.emplace("set-max", std::bind(&ConsoleServer::changeMaxClients, this));
     m_commands.emplace("exit", std::bind(&ConsoleServer::quit, this));
     m_commands.emplace("kick", std::bind(&ConsoleServer::kick, this));
     m_commands.emplace("block", std::bind(&ConsoleServer::block, this));
     m_commands.emplace("unblock", std::bind(&ConsoleServer::unblock, this));
+    m_commands.emplace("blocked", std::bind(&ConsoleServer::viewBlocked, this));
+    m_commands.emplace("reload-blocklist", std::bind(&ConsoleServer::reloadBlocklist, this));
     m_commands.emplace("promote", std::bind(&ConsoleServer::promote, this));
     m_commands.emplace("promote-help", std::bind(&ConsoleServer::helpPromote, this));
 
     m_commandsDescriptions.emplace("clients", "see actually connected clients");
+    m_commandsDescriptions.emplace("channels", "see channels and how many clients are in each");
     m_commandsDescriptions.emplace("message", "send message to all connected clients");
     m_commandsDescriptions.emplace("help", "view this message");
     m_commandsDescriptions.emplace("clear", "clear a screen");
     m_commandsDescriptions.emplace("info", "view server info");
+    m_commandsDescriptions.emplace("stats", "view traffic, errors, queues and loop times since start");
+    m_commandsDescriptions.emplace("trace", "sets how many packet events each thread keeps, 0 stops tracing");
+    m_commandsDescriptions.emplace("trace-dump", "writes traced packets to a file for chrome://tracing");
     m_commandsDescriptions.emplace("set-password", "changes the server password");
     m_commandsDescriptions.emplace("set-max", "changes the maximum number of clients");
     m_commandsDescriptions.emplace("exit", "close the server");
     m_commandsDescriptions.emplace("kick", "kicks and blocks(only with ip) the client via ip or nickname");
-    m_commandsDescriptions.emplace("block", "blocks the client via ip");
-    m_commandsDescriptions.emplace("unblock", "unblocks the client via ip");
+    m_commandsDescriptions.emplace("block", "blocks an ip or a range such as 10.0.0.0/24");
+    m_commandsDescriptions.emplace("unblock", "unblocks an ip or a range blocked before");
+    m_commandsDescriptions.emplace("blocked", "see blocked ips and ranges");
+    m_commandsDescriptions.emplace("reload-blocklist", "reads the blocklist file again");
     m_commandsDescriptions.emplace("promote", "promote the client via ip or nickname");
     m_commandsDescriptions.emplace("promote-help", "view help message");
 }
@@ -68,11 +80,41 @@ void ConsoleServer::printServerInfo()
 
     std::cout << "maximum clients: "; if(m_max != sf::Uint32(-1)) std::cout << m_max; std::cout << std::endl;
     std::cout << "version: " << m_version << std::endl;
+    std::cout << "backend: " << (getBackend() == Backend::Epoll ? "epoll" : "select") << std::endl;
+    std::cout << "reactor threads: " << getReactorThreads() << std::endl;
+    ServerStats stats = getStats();
+    std::cout << "connection: " << stats.m_recordBytes << " bytes, outbound ring: " << stats.m_ringBytes
+              << " bytes once allocated, pooled records: " << stats.m_pooledRecords << std::endl;
+    std::cout << "throttled messages: " << stats.m_throttledMessages << ", bytes: " << stats.m_throttledBytes
+              << ", passwords: " << stats.m_throttledPasswords << std::endl;
+    m_colorChanger.setConsoleTextColor(Color::Default);
+}
+
+void ConsoleServer::printMetrics()
+{
+    MetricsSnapshot metrics = getMetrics();
+    std::lock_guard<std::mutex> lk(m_printMutex);
+    m_colorChanger.setConsoleTextColor(Color::White);
+    std::cout << "connected: " << metrics.m_connected << ", handshaking: " << metrics.m_handshaking << std::endl
+        << "accepted: " << metrics.m_accepted << ", blocked: " << metrics.m_blocked << ", disconnected: " << metrics.m_disconnected << std::endl
+        << "handshake failures: " << metrics.m_handshakeFailures << ", send errors: " << metrics.m_sendErrors
+        << ", receive errors: " << metrics.m_receiveErrors << ", slow consumers: " << metrics.m_slowConsumers << std::endl
+        << "bytes in: " << metrics.m_bytesIn << ", out: " << metrics.m_bytesOut << std::endl
+        << "queued frames: " << metrics.m_queuedFrames << ", clients waiting to send: " << metrics.m_waitingClients << std::endl
+        << "loop: " << metrics.m_loop.m_count << " wakes, p50 " << metrics.m_loop.percentile(0.5) << "us, p99 "
+        << metrics.m_loop.percentile(0.99) << "us, max " << metrics.m_loop.m_max << "us" << std::endl;
+    m_colorChanger.setConsoleTextColor(Color::Blue);
+    for(size_t i = 0; i < PacketKinds; ++i){
+        if(metrics.m_packetsIn[i] || metrics.m_packetsOut[i]){
+            std::cout << packetKindName(i) << " - in: " << metrics.m_packetsIn[i] << ", out: " << metrics.m_packetsOut[i] << std::endl;
+        }
+    }
     m_colorChanger.setConsoleTextColor(Color::Default);
 }
 
 void ConsoleServer::printError(const std::string &l_string)
 {
+    std::lock_guard<std::mutex> lk(m_printMutex);
     Color tmp = m_colorChanger.m_color;
     m_colorChanger.setConsoleTextColor(Color::Red);
     std::cerr << l_string << std::endl;
@@ -81,15 +123,16 @@ void ConsoleServer::printError(const std::string &l_string)
 
 void ConsoleServer::printText(const std::string &l_string, const Color& l_color)
 {
+    std::lock_guard<std::mutex> lk(m_printMutex);
     Color tmp = m_colorChanger.m_color;
     m_colorChanger.setConsoleTextColor(l_color);
     std::cout << l_string << std::endl;
     m_colorChanger.setConsoleTextColor(tmp);
 }
 
-void ConsoleServer::onClientBlocked(std::unique_ptr<ClientServerData> &l_client)
+void ConsoleServer::onClientBlocked(const std::string &l_ip)
 {
-    printText(l_client->m_ip + " blocked", Color::Red);
+    printText(l_ip + " blocked", Color::Red);
 }
 
 void ConsoleServer::onClientRejected(std::unique_ptr<ClientServerData> &l_client)
@@ -127,19 +170,31 @@ void ConsoleServer::onErrorWithSendingData(std::unique_ptr<ClientServerData> &l_
     printError("Error when sending data to: " + l_client->m_ip);
 }
 
+void ConsoleServer::onClientTooSlow(std::unique_ptr<ClientServerData> &l_client)
+{
+    std::string name = l_client->m_client.m_name;
+    printError((name.empty() ? l_client->m_ip : name) + " disconnected, outbound queue is full");
+}
+
+void ConsoleServer::onHandshakeTimeout(std::unique_ptr<ClientServerData> &l_client)
+{
+    printError(l_client->m_ip + " disconnected, did not finish logging in");
+}
+
 void ConsoleServer::onArgumentsError(const char *l_what)
 {
     printError(l_what);
 }
 
-void ConsoleServer::onClientMessageReceived(std::unique_ptr<ClientServerData> &l_client, const std::string &l_text)
+void ConsoleServer::onClientMessageReceived(std::unique_ptr<ClientServerData> &l_client, std::string_view l_text)
 {
     std::string name = l_client->m_client.m_name;
     if(l_client->m_client.m_type == ClientType::Administrator){
         name += "[ADMIN]";
     }
     name += ": ";
-    printText(name + l_text, Color::Default);
+    name.append(l_text);
+    printText(name, Color::Default);
 }
 
 void ConsoleServer::error(const std::string &l_text)
@@ -149,30 +204,72 @@ void ConsoleServer::error(const std::string &l_text)
 
 void ConsoleServer::viewAllClients()
 {
-    std::lock_guard<std::mutex> lk(m_mutex);
-    size_t connected = 0, waiting = 0;
-    for(auto& itr : m_clients){
-        if(itr->m_connected) ++connected;
-        else ++waiting;
+    ServerStats stats = getStats();
+    std::vector<std::string> connected, waiting;
+    for(auto& shard : m_shards){
+        std::lock_guard<std::mutex> lk(shard->m_mutex);
+        for(auto& itr : shard->m_clients){
+            if(itr->m_removed) continue;
+            if(itr->m_connected){
+                connected.push_back(itr->m_client.m_name + '[' + std::to_string(static_cast<int>(itr->m_client.m_type)) + ']' + " - " + itr->m_ip);
+            } else{
+                waiting.push_back(itr->m_ip);
+            }
+        }
     }
 
+    std::lock_guard<std::mutex> lk(m_printMutex);
+    m_colorChanger.setConsoleTextColor(Color::White);
+    std::cout << "Connected clients: " << stats.m_connected << " / " << stats.m_max
+              << " (" << stats.m_administrators << " administrators, " << stats.m_normies << " users)" << std::endl;
+    m_colorChanger.setConsoleTextColor(Color::Blue);
+    for(auto& itr : connected){
+        std::cout << itr << std::endl;
+    }
     m_colorChanger.setConsoleTextColor(Color::White);
-    std::cout << "Connected clients: " << connected << " / " << m_max << std::endl;
+    std::cout << "Waiting clients: " << stats.m_handshaking << std::endl;
     m_colorChanger.setConsoleTextColor(Color::Blue);
-    for(auto& itr : m_clients){
-        if(!itr->m_connected) continue;
-        std::cout << itr->m_client.m_name << '[' << std::to_string(static_cast<int>(itr->m_client.m_type)) << ']' << " - " << itr->m_ip << std::endl;
+    for(auto& itr : waiting){
+        std::cout << itr << std::endl;
     }
+    m_colorChanger.setConsoleTextColor(Color::Default);
+}
+
+void ConsoleServer::viewAllChannels()
+{
+    auto channels = getChannels();
+    std::lock_guard<std::mutex> lk(m_printMutex);
     m_colorChanger.setConsoleTextColor(Color::White);
-    std::cout << "Waiting clients: " << waiting << std::endl;
+    std::cout << "Channels: " << channels.size() << std::endl;
     m_colorChanger.setConsoleTextColor(Color::Blue);
-    for(auto& itr : m_clients){
-        if(itr->m_connected) continue;
-        std::cout << itr->m_ip << std::endl;
+    for(auto& itr : channels){
+        std::cout << itr.first << " - " << itr.second << std::endl;
     }
     m_colorChanger.setConsoleTextColor(Color::Default);
 }
 
+void ConsoleServer::viewBlocked()
+{
+    auto ranges = getBlockedRanges();
+    std::lock_guard<std::mutex> lk(m_printMutex);
+    m_colorChanger.setConsoleTextColor(Color::White);
+    std::cout << "Blocked: " << ranges.size() << std::endl;
+    m_colorChanger.setConsoleTextColor(Color::Blue);
+    for(auto& itr : ranges){
+        std::cout << itr << std::endl;
+    }
+    m_colorChanger.setConsoleTextColor(Color::Default);
+}
+
+void ConsoleServer::reloadBlocklist()
+{
+    if(Server::reloadBlocklist()){
+        printText("Blocklist have been reloaded", Color::Green);
+    } else{
+        printError("Unable to load blocklist from: " + getBlocklist());
+    }
+}
+
 void ConsoleServer::viewAllCommands()
 {
     for(auto& itr : m_commands){
@@ -229,6 +326,26 @@ void ConsoleServer::changeMaxClients()
     }
 }
 
+void ConsoleServer::changeTracing()
+{
+    try{
+        setTraceEvents(std::stoul(getline()));
+    }
+    catch(const std::logic_error& ex){
+        printError(ex.what());
+    }
+}
+
+void ConsoleServer::dumpTrace()
+{
+    std::string path = getline();
+    if(Server::dumpTrace(path)){
+        printText("Trace written to " + path, Color::Green);
+    } else{
+        printError("Unable to write trace to: " + path);
+    }
+}
+
 void ConsoleServer::kick()
 {
     if(Server::kick(getline(), true)){
@@ -241,21 +358,19 @@ void ConsoleServer::kick()
 void ConsoleServer::block()
 {
     std::string s = getline();
-    if(m_blocked.emplace(s).second){
+    if(Server::block(s)){
         printText(s + " have been blocked", Color::Green);
     } else {
-        printError(s + " is already blocked");
+        printError(s + " is already blocked or is not an address");
     }
 }
 
 void ConsoleServer::unblock()
 {
     std::string s = getline();
-    auto itr = m_blocked.find(s);
-    if(itr == m_blocked.end()){
+    if(!Server::unblock(s)){
         printText(s + " is not blocked", Color::Red);
     } else{
-        m_blocked.erase(itr);
         printText(s + " have been unblocked", Color::Green);
     }
 }
@@ -0,0 +1,70 @@
+#include "history.h"
+
+void ChatHistory::setCapacity(const size_t &l_capacity)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_capacity = l_capacity;
+    evict(0);
+}
+
+std::uint64_t ChatHistory::record(const Frame &l_frame)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if(l_frame->size() > m_capacity){
+        return 0;
+    }
+    evict(l_frame->size());
+    m_frames.push_back(l_frame);
+    m_bytes += l_frame->size();
+    m_replay.reset();
+    return ++m_sequence;
+}
+
+Frame ChatHistory::replay(std::uint64_t &l_sequence)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    l_sequence = m_sequence;
+    if(m_frames.empty() || m_replay){
+        return m_replay;
+    }
+    auto bytes = std::make_shared<std::vector<char>>();
+    bytes->reserve(m_bytes);
+    for(auto& frame : m_frames){
+        bytes->insert(bytes->end(), frame->begin(), frame->end());
+    }
+    m_replay = std::move(bytes);
+    return m_replay;
+}
+
+void ChatHistory::clear()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_frames.clear();
+    m_replay.reset();
+    m_bytes = 0;
+}
+
+size_t ChatHistory::size() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_frames.size();
+}
+
+size_t ChatHistory::bytes() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_bytes;
+}
+
+void ChatHistory::evict(const size_t &l_needed)
+{
+    bool evicted = false;
+    while(!m_frames.empty() && m_bytes + l_needed > m_capacity){
+        m_bytes -= m_frames.front()->size();
+        m_frames.pop_front();
+        evicted = true;
+    }
+    if(evicted){
+        m_replay.reset();
+    }
+}
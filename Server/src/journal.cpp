@@ -0,0 +1,434 @@
+#include "journal.h"
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fstream>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // size(u32) kind(u8) sequence(u64), big-endian like the rest of the wire format
+    const size_t RecordHeader = 13;
+    const size_t IndexEntry = 8;
+
+    void putUint(std::vector<char>& l_bytes, std::uint64_t l_value, const size_t& l_width)
+    {
+        for(size_t i = l_width; i > 0; --i){
+            l_bytes.push_back(static_cast<char>(l_value >> ((i - 1) * 8)));
+        }
+    }
+
+    std::uint64_t getUint(const char* l_bytes, const size_t& l_width)
+    {
+        std::uint64_t value = 0;
+        for(size_t i = 0; i < l_width; ++i){
+            value = (value << 8) | static_cast<unsigned char>(l_bytes[i]);
+        }
+        return value;
+    }
+
+    std::string segmentName(const std::uint64_t& l_first)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%020llu", static_cast<unsigned long long>(l_first));
+        return name;
+    }
+
+    int openAppend(const std::string& l_path)
+    {
+#ifdef _WIN32
+        return ::_open(l_path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+#else
+        return ::open(l_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+    }
+
+    void closeFile(int& l_file)
+    {
+        if(l_file >= 0){
+#ifdef _WIN32
+            ::_close(l_file);
+#else
+            ::close(l_file);
+#endif
+        }
+        l_file = -1;
+    }
+
+    bool writeAll(const int& l_file, const char* l_data, size_t l_size)
+    {
+        while(l_size){
+#ifdef _WIN32
+            int written = ::_write(l_file, l_data, static_cast<unsigned int>(l_size));
+#else
+            ssize_t written = ::write(l_file, l_data, l_size);
+            if(written < 0 && errno == EINTR){
+                continue;
+            }
+#endif
+            if(written <= 0){
+                return false;
+            }
+            l_data += written;
+            l_size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool syncFile(const int& l_file)
+    {
+#ifdef _WIN32
+        return ::_commit(l_file) == 0;
+#elif defined(__APPLE__)
+        return ::fsync(l_file) == 0;
+#else
+        return ::fdatasync(l_file) == 0;
+#endif
+    }
+
+    /// read-only view of a whole file, mapped where mmap() exists
+    class MappedFile
+    {
+    public:
+        MappedFile(const std::string& l_path) : m_data(nullptr), m_size(0)
+        {
+#ifdef _WIN32
+            std::ifstream file(l_path, std::ios::binary);
+            m_copy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            m_data = m_copy.data();
+            m_size = m_copy.size();
+#else
+            int file = ::open(l_path.c_str(), O_RDONLY | O_CLOEXEC);
+            if(file < 0){
+                return;
+            }
+            struct stat info;
+            if(::fstat(file, &info) == 0 && info.st_size > 0){
+                void* data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+                if(data != MAP_FAILED){
+                    m_data = static_cast<const char*>(data);
+                    m_size = static_cast<size_t>(info.st_size);
+                }
+            }
+            ::close(file);
+#endif
+        }
+        ~MappedFile()
+        {
+#ifndef _WIN32
+            if(m_data){
+                ::munmap(const_cast<char*>(m_data), m_size);
+            }
+#endif
+        }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+    private:
+        const char* m_data;
+        size_t m_size;
+#ifdef _WIN32
+        std::vector<char> m_copy;
+#endif
+    };
+}
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::open(const std::string &l_directory)
+{
+    close();
+    std::error_code error;
+    fs::create_directories(l_directory, error);
+    if(error || !fs::is_directory(l_directory)){
+        return false;
+    }
+    m_directory = l_directory;
+    loadSegments();
+    std::uint64_t last = 0;
+    for(auto itr = m_segments.rbegin(); itr != m_segments.rend() && !last; ++itr){
+        last = lastSequence(*itr);
+    }
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_nextSequence = last + 1;
+    m_durableSequence = last;
+    m_stopping = false;
+    m_failed = false;
+    m_writer = std::thread(&Journal::runWriter, this);
+    return true;
+}
+
+void Journal::close()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if(!m_writer.joinable()){
+            return;
+        }
+        m_stopping = true;
+    }
+    m_pendingReady.notify_one();
+    m_writer.join();
+    closeSegment();
+    m_segments.clear();
+}
+
+bool Journal::isHealthy() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return !m_failed;
+}
+
+std::uint64_t Journal::append(const JournalKind &l_kind, std::string_view l_payload)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if(!m_writer.joinable() || m_stopping || m_failed){
+        return 0;
+    }
+    std::uint64_t sequence = m_nextSequence++;
+    m_pendingStarts.push_back(m_pending.size());
+    putUint(m_pending, l_payload.size(), 4);
+    putUint(m_pending, static_cast<sf::Uint8>(l_kind), 1);
+    putUint(m_pending, sequence, 8);
+    m_pending.insert(m_pending.end(), l_payload.begin(), l_payload.end());
+    m_pendingReady.notify_one();
+    return sequence;
+}
+
+void Journal::sync()
+{
+    std::unique_lock<std::mutex> lk(m_mutex);
+    std::uint64_t target = m_nextSequence - 1;
+    m_durable.wait(lk, [this, target](){ return m_durableSequence >= target || !m_writer.joinable(); });
+}
+
+void Journal::replayTail(const size_t &l_bytes, const std::function<void (const JournalRecord &)> &l_callback)
+{
+    // whole segments from the newest back, then the part of one more that still fits
+    size_t budget = l_bytes;
+    size_t first = m_segments.size();
+    size_t from = 0;
+    while(first > 0){
+        auto& segment = m_segments[first - 1];
+        if(segment.m_size <= budget){
+            budget -= segment.m_size;
+            --first;
+            continue;
+        }
+        size_t offset = tailOffset(segment, budget);
+        if(offset < segment.m_size){
+            from = offset;
+            --first;
+        }
+        break;
+    }
+    for(size_t i = first; i < m_segments.size(); ++i){
+        readSegment(m_segments[i], i == first ? from : 0, l_callback, nullptr);
+    }
+}
+
+std::uint64_t Journal::getLastSequence()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_nextSequence - 1;
+}
+
+size_t Journal::getSegmentCount()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_segments.size();
+}
+
+void Journal::runWriter()
+{
+    std::vector<char> batch;
+    std::vector<size_t> starts;
+    std::unique_lock<std::mutex> lk(m_mutex);
+    while(true)
+    {
+        m_pendingReady.wait(lk, [this](){ return !m_pending.empty() || m_stopping; });
+        if(m_pending.empty()){
+            break;
+        }
+        // everything appended while the previous batch was being synced goes out together
+        batch.swap(m_pending);
+        starts.swap(m_pendingStarts);
+        std::uint64_t last = m_nextSequence - 1;
+        bool failed = m_failed;
+        lk.unlock();
+        bool written = !failed && writeBatch(batch, starts);
+        batch.clear();
+        starts.clear();
+        lk.lock();
+        m_failed = !written;
+        // also advanced on failure, nobody waiting in sync() should hang
+        m_durableSequence = last;
+        m_durable.notify_all();
+    }
+}
+
+bool Journal::writeBatch(const std::vector<char> &l_batch, const std::vector<size_t> &l_starts)
+{
+    if(m_log < 0 || m_segments.back().m_size >= m_segmentBytes){
+        closeSegment();
+        if(!startSegment(getUint(l_batch.data() + 5, 8))){
+            return false;
+        }
+        applyRetention();
+    }
+    auto& segment = m_segments.back();
+    std::vector<char> index;
+    index.reserve(l_starts.size() * IndexEntry);
+    for(auto start : l_starts){
+        putUint(index, segment.m_size + start, IndexEntry);
+    }
+    if(!writeAll(m_log, l_batch.data(), l_batch.size()) || !writeAll(m_index, index.data(), index.size())){
+        return false;
+    }
+    if(!syncFile(m_log) || !syncFile(m_index)){
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(m_mutex);
+    segment.m_size += l_batch.size();
+    return true;
+}
+
+bool Journal::startSegment(const std::uint64_t &l_first)
+{
+    Segment segment;
+    segment.m_first = l_first;
+    segment.m_path = (fs::path(m_directory) / segmentName(l_first)).string();
+    segment.m_size = 0;
+    m_log = openAppend(segment.m_path + ".log");
+    m_index = openAppend(segment.m_path + ".idx");
+    if(m_log < 0 || m_index < 0){
+        closeSegment();
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_segments.push_back(segment);
+    return true;
+}
+
+void Journal::closeSegment()
+{
+    closeFile(m_log);
+    closeFile(m_index);
+}
+
+void Journal::applyRetention()
+{
+    size_t total = 0;
+    for(auto& segment : m_segments){
+        total += segment.m_size;
+    }
+    // the segment being written is never removed
+    std::lock_guard<std::mutex> lk(m_mutex);
+    while(m_segments.size() > 1 && total > m_retainedBytes){
+        std::error_code error;
+        fs::remove(m_segments.front().m_path + ".log", error);
+        fs::remove(m_segments.front().m_path + ".idx", error);
+        total -= m_segments.front().m_size;
+        m_segments.pop_front();
+    }
+}
+
+void Journal::loadSegments()
+{
+    m_segments.clear();
+    std::error_code error;
+    for(auto& entry : fs::directory_iterator(m_directory, error)){
+        auto path = entry.path();
+        if(path.extension() != ".log"){
+            continue;
+        }
+        Segment segment;
+        try{
+            segment.m_first = std::stoull(path.stem().string());
+        } catch(std::exception&){
+            continue;
+        }
+        segment.m_path = (path.parent_path() / path.stem()).string();
+        segment.m_size = static_cast<size_t>(fs::file_size(path, error));
+        if(!error && segment.m_size){
+            m_segments.push_back(segment);
+        }
+    }
+    std::sort(m_segments.begin(), m_segments.end(), [](const Segment& l_a, const Segment& l_b){ return l_a.m_first < l_b.m_first; });
+}
+
+void Journal::readSegment(const Segment &l_segment, const size_t &l_from,
+                          const std::function<void (const JournalRecord &)> &l_callback, std::uint64_t *l_last)
+{
+    MappedFile log(l_segment.m_path + ".log");
+    size_t offset = l_from;
+    while(offset + RecordHeader <= log.size()){
+        const char* header = log.data() + offset;
+        size_t size = static_cast<size_t>(getUint(header, 4));
+        // a record cut short by a crash ends the segment
+        if(size > log.size() - offset - RecordHeader){
+            break;
+        }
+        JournalRecord record;
+        record.m_kind = static_cast<JournalKind>(header[4]);
+        record.m_sequence = getUint(header + 5, 8);
+        record.m_payload = std::string_view(header + RecordHeader, size);
+        if(l_callback){
+            l_callback(record);
+        }
+        if(l_last){
+            *l_last = record.m_sequence;
+        }
+        offset += RecordHeader + size;
+    }
+}
+
+size_t Journal::tailOffset(const Segment &l_segment, const size_t &l_bytes)
+{
+    // offsets are ascending, the first one close enough to the end starts the tail.
+    // Entries past the end of the log belong to records lost in a crash
+    MappedFile index(l_segment.m_path + ".idx");
+    auto offsetAt = [&index](const size_t& l_entry){ return static_cast<size_t>(getUint(index.data() + l_entry * IndexEntry, IndexEntry)); };
+    size_t low = 0, high = index.size() / IndexEntry;
+    while(low < high){
+        size_t middle = (low + high) / 2;
+        size_t offset = offsetAt(middle);
+        if(offset >= l_segment.m_size || l_segment.m_size - offset <= l_bytes){
+            high = middle;
+        } else{
+            low = middle + 1;
+        }
+    }
+    return low < index.size() / IndexEntry ? std::min(offsetAt(low), l_segment.m_size) : l_segment.m_size;
+}
+
+std::uint64_t Journal::lastSequence(const Segment &l_segment)
+{
+    std::uint64_t last = 0;
+    MappedFile index(l_segment.m_path + ".idx");
+    for(size_t entry = index.size() / IndexEntry; entry > 0 && !last; --entry){
+        auto offset = static_cast<size_t>(getUint(index.data() + (entry - 1) * IndexEntry, IndexEntry));
+        if(offset < l_segment.m_size){
+            readSegment(l_segment, offset, nullptr, &last);
+        }
+    }
+    if(!last){
+        readSegment(l_segment, 0, nullptr, &last);
+    }
+    return last;
+}
@@ -0,0 +1,103 @@
+#include "listener.h"
+#include "socketoptions.h"
+
+void *PooledTcpConnection::operator new(std::size_t l_size)
+{
+    return l_size == sizeof(PooledTcpConnection) ? pool().allocate() : ::operator new(l_size);
+}
+
+void PooledTcpConnection::operator delete(void *l_pointer, std::size_t l_size)
+{
+    if(l_size == sizeof(PooledTcpConnection)){
+        pool().deallocate(l_pointer);
+    } else{
+        ::operator delete(l_pointer);
+    }
+}
+
+SlabPool<PooledTcpConnection> &PooledTcpConnection::pool()
+{
+    // never destroyed, like the pool of ClientServerData
+    static auto pool = new SlabPool<PooledTcpConnection>;
+    return *pool;
+}
+
+bool TcpListener::listen(const sf::Uint16 &l_port)
+{
+    if(m_listener.listen(l_port) != sf::Socket::Done){
+        return false;
+    }
+    m_listener.setBlocking(false);
+    return true;
+}
+
+bool TcpListener::accept(PeerAddress &l_address)
+{
+    return acceptPeer(m_listener, m_pending, l_address);
+}
+
+std::unique_ptr<Connection> TcpListener::adopt()
+{
+    std::unique_ptr<Connection> connection(new PooledTcpConnection);
+    adoptPeer(*connection->getSocket(), m_pending);
+    return connection;
+}
+
+void TcpListener::reject(const char *l_data, const size_t &l_size)
+{
+    rejectPeer(m_pending, l_data, l_size);
+}
+
+bool MemoryListener::listen(const sf::Uint16 &l_port)
+{
+    close();
+    m_backlog = m_network->listen(l_port);
+    m_port = l_port;
+    return m_backlog != nullptr;
+}
+
+void MemoryListener::close()
+{
+    if(!m_backlog){
+        return;
+    }
+    m_network->close(m_port);
+    m_backlog.reset();
+}
+
+bool MemoryListener::accept(PeerAddress &l_address)
+{
+    if(!m_backlog){
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lk(m_backlog->m_mutex);
+        if(m_backlog->m_pending.empty()){
+            return false;
+        }
+        m_pending = std::move(m_backlog->m_pending.front());
+        m_backlog->m_pending.pop_front();
+    }
+    l_address = PeerAddress();
+    sf::Uint8 localhost[] = {127, 0, 0, 1};
+    std::copy(localhost, localhost + 4, l_address.m_bytes);
+    l_address.m_length = 4;
+    return true;
+}
+
+void MemoryListener::reject(const char *l_data, const size_t &l_size)
+{
+    size_t sent = 0;
+    m_pending->setBlocking(false);
+    m_pending->send(l_data, l_size, sent);
+    m_pending.reset();
+}
+
+void MemoryListener::setNotifier(const Notifier &l_notifier)
+{
+    if(!m_backlog){
+        return;
+    }
+    std::lock_guard<std::mutex> lk(m_backlog->m_mutex);
+    m_backlog->m_notifier = l_notifier;
+}
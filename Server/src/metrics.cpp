@@ -0,0 +1,143 @@
+#include "metrics.h"
+#include <sstream>
+#include <algorithm>
+
+namespace
+{
+    const char* KindNames[PacketKinds] = {
+        "Message", "ServerMessage", "ServerIsFull", "ServerConnected", "ServerPasswordNeeded", "Kick", "Connection",
+        "Disconnection", "Password", "Promotion", "SomebodyPromotion", "ServerExit", "JoinChannel", "LeaveChannel",
+        "ChannelMessage", "DirectMessage", "UnknownRecipient",
+        "Welcome", "CompactMessage", "CompactServerMessage", "Notice", "Member",
+        "Unknown"
+    };
+    static_assert(TypeCount == 17 && OpcodeCount == 5, "name the new Type or Opcode in KindNames");
+
+    size_t bucketOf(std::uint64_t l_value)
+    {
+        size_t bucket = 0;
+        while(l_value && bucket < HistogramSnapshot::Buckets - 1){
+            l_value >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+}
+
+size_t packetKind(const char *l_payload, const size_t &l_size)
+{
+    if(!l_size){
+        return PacketKinds - 1;
+    }
+    auto first = static_cast<sf::Uint8>(l_payload[0]);
+    if(first >= static_cast<sf::Uint8>(Opcode::Welcome)){
+        return first <= static_cast<sf::Uint8>(Opcode::Member) ? packetKind(static_cast<Opcode>(first)) : PacketKinds - 1;
+    }
+    if(l_size < 2){
+        return PacketKinds - 1;
+    }
+    size_t type = (static_cast<size_t>(first) << 8) | static_cast<sf::Uint8>(l_payload[1]);
+    return type < TypeCount ? type : PacketKinds - 1;
+}
+
+const char *packetKindName(const size_t &l_kind)
+{
+    return l_kind < PacketKinds ? KindNames[l_kind] : KindNames[PacketKinds - 1];
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot &l_other)
+{
+    for(size_t i = 0; i < Buckets; ++i){
+        m_buckets[i] += l_other.m_buckets[i];
+    }
+    m_count += l_other.m_count;
+    m_sum += l_other.m_sum;
+    m_max = std::max(m_max, l_other.m_max);
+}
+
+std::uint64_t HistogramSnapshot::percentile(const double &l_quantile) const
+{
+    if(!m_count){
+        return 0;
+    }
+    auto rank = static_cast<std::uint64_t>(l_quantile * static_cast<double>(m_count - 1)) + 1;
+    std::uint64_t seen = 0;
+    for(size_t i = 0; i < Buckets; ++i){
+        seen += m_buckets[i];
+        if(seen >= rank){
+            return std::min(i ? std::uint64_t(1) << i : std::uint64_t(1), m_max);
+        }
+    }
+    return m_max;
+}
+
+void Histogram::record(const std::uint64_t &l_value)
+{
+    m_buckets[bucketOf(l_value)].add();
+    m_count.add();
+    m_sum.add(l_value);
+    if(l_value > m_max.load(std::memory_order_relaxed)){
+        m_max.store(l_value, std::memory_order_relaxed);
+    }
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+    HistogramSnapshot snapshot;
+    for(size_t i = 0; i < HistogramSnapshot::Buckets; ++i){
+        snapshot.m_buckets[i] = m_buckets[i].get();
+    }
+    snapshot.m_count = m_count.get();
+    snapshot.m_sum = m_sum.get();
+    snapshot.m_max = m_max.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void MetricsSnapshot::add(const ShardMetrics &l_shard)
+{
+    for(size_t i = 0; i < PacketKinds; ++i){
+        m_packetsIn[i] += l_shard.m_packetsIn[i].get();
+        m_packetsOut[i] += l_shard.m_packetsOut[i].get();
+    }
+    m_bytesIn += l_shard.m_bytesIn.get();
+    m_bytesOut += l_shard.m_bytesOut.get();
+    m_disconnected += l_shard.m_disconnected.get();
+    m_handshakeFailures += l_shard.m_handshakeFailures.get();
+    m_sendErrors += l_shard.m_sendErrors.get();
+    m_receiveErrors += l_shard.m_receiveErrors.get();
+    m_slowConsumers += l_shard.m_slowConsumers.get();
+    m_queuedFrames += l_shard.m_queuedFrames.get();
+    m_waitingClients += l_shard.m_waitingClients.get();
+    m_loop.merge(l_shard.m_loop.snapshot());
+}
+
+std::string MetricsSnapshot::toJson() const
+{
+    auto kinds = [](std::ostringstream& l_out, const std::uint64_t* l_counts){
+        l_out << '{';
+        bool first = true;
+        for(size_t i = 0; i < PacketKinds; ++i){
+            if(!l_counts[i]){
+                continue;
+            }
+            l_out << (first ? "" : ",") << '"' << packetKindName(i) << "\":" << l_counts[i];
+            first = false;
+        }
+        l_out << '}';
+    };
+    std::ostringstream out;
+    out << "{\"connected\":" << m_connected << ",\"handshaking\":" << m_handshaking
+        << ",\"accepted\":" << m_accepted << ",\"blocked\":" << m_blocked << ",\"disconnected\":" << m_disconnected
+        << ",\"handshake_failures\":" << m_handshakeFailures << ",\"send_errors\":" << m_sendErrors
+        << ",\"receive_errors\":" << m_receiveErrors << ",\"slow_consumers\":" << m_slowConsumers
+        << ",\"bytes_in\":" << m_bytesIn << ",\"bytes_out\":" << m_bytesOut
+        << ",\"queued_frames\":" << m_queuedFrames << ",\"waiting_clients\":" << m_waitingClients
+        << ",\"packets_in\":";
+    kinds(out, m_packetsIn);
+    out << ",\"packets_out\":";
+    kinds(out, m_packetsOut);
+    out << ",\"loop_us\":{\"count\":" << m_loop.m_count << ",\"sum\":" << m_loop.m_sum
+        << ",\"p50\":" << m_loop.percentile(0.5) << ",\"p99\":" << m_loop.percentile(0.99)
+        << ",\"max\":" << m_loop.m_max << "}}";
+    return out.str();
+}
@@ -0,0 +1,224 @@
+#include "outboundqueue.h"
+#include "socketoptions.h"
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cerrno>
+#include "../../Shared/shared.h"
+#endif
+
+namespace{
+#ifndef _WIN32
+// frames gathered per call, well below IOV_MAX everywhere
+const size_t MaxVectors = 64;
+#endif
+}
+
+OutboundQueue::OutboundQueue(const size_t &l_capacity) :
+    m_capacity(std::max<size_t>(l_capacity, 1)),
+    m_head(0),
+    m_count(0),
+    m_offset(0),
+    m_bytes(0),
+    m_dropped(0)
+{
+
+}
+
+void OutboundQueue::setCapacity(const size_t &l_capacity)
+{
+    m_capacity = std::max<size_t>(l_capacity, 1);
+    if(m_ring.empty()){
+        return;
+    }
+    std::vector<Frame> ring(m_capacity);
+    size_t count = std::min(m_count, ring.size());
+    m_bytes = 0;
+    for(size_t i = 0; i < count; ++i){
+        ring[i] = std::move(at(i));
+        m_bytes += ring[i]->size();
+    }
+    m_dropped += m_count - count;
+    m_ring.swap(ring);
+    m_head = 0;
+    m_count = count;
+}
+
+bool OutboundQueue::push(const Frame &l_frame, const SlowConsumerPolicy &l_policy)
+{
+    if(m_ring.empty()){
+        m_ring.resize(m_capacity);
+    }
+    if(m_count == m_ring.size()){
+        if(l_policy == SlowConsumerPolicy::Disconnect){
+            return false;
+        }
+        ++m_dropped;
+        if(l_policy == SlowConsumerPolicy::Conflate && conflate(l_frame)){
+            return true;
+        }
+        // the front frame may be half written, dropping it would corrupt the stream
+        size_t oldest = m_offset ? 1 : 0;
+        if(oldest >= m_count){
+            return true;
+        }
+        eraseAt(oldest);
+    }
+    at(m_count) = l_frame;
+    ++m_count;
+    m_bytes += l_frame->size();
+    return true;
+}
+
+template <class T>
+sf::Socket::Status OutboundQueue::writeTo(const Frame &l_frame, T &l_stream)
+{
+    std::size_t sent = 0;
+    auto status = l_stream.send(l_frame->data(), l_frame->size(), sent);
+    if(status == sf::Socket::Partial || status == sf::Socket::NotReady){
+        push(l_frame, SlowConsumerPolicy::Disconnect);
+        m_offset = status == sf::Socket::Partial ? sent : 0;
+    }
+    return status;
+}
+
+sf::Socket::Status OutboundQueue::write(const Frame &l_frame, sf::TcpSocket &l_socket)
+{
+    return writeTo(l_frame, l_socket);
+}
+
+sf::Socket::Status OutboundQueue::write(const Frame &l_frame, Connection &l_connection)
+{
+    return writeTo(l_frame, l_connection);
+}
+
+sf::Socket::Status OutboundQueue::flush(Connection &l_connection, const bool &l_cork)
+{
+    if(sf::TcpSocket* socket = l_connection.getSocket()){
+        return flush(*socket, l_cork);
+    }
+    return flushEach(l_connection);
+}
+
+template <class T>
+sf::Socket::Status OutboundQueue::flushEach(T &l_stream)
+{
+    while(m_count){
+        auto& frame = at(0);
+        std::size_t sent = 0;
+        auto status = l_stream.send(frame->data() + m_offset, frame->size() - m_offset, sent);
+        if(status == sf::Socket::Done){
+            popFront();
+            continue;
+        }
+        if(status == sf::Socket::Partial){
+            m_offset += sent;
+        }
+        return status;
+    }
+    return sf::Socket::Done;
+}
+
+sf::Socket::Status OutboundQueue::flush(sf::TcpSocket &l_socket, const bool &l_cork)
+{
+#ifndef _WIN32
+    bool corked = l_cork && m_count > MaxVectors && setCork(l_socket, true);
+    auto status = sf::Socket::Done;
+    while(m_count){
+        iovec vectors[MaxVectors];
+        size_t count = std::min(m_count, MaxVectors);
+        size_t offered = 0;
+        for(size_t i = 0; i < count; ++i){
+            auto& frame = at(i);
+            size_t offset = i == 0 ? m_offset : 0;
+            vectors[i].iov_base = const_cast<char*>(frame->data() + offset);
+            vectors[i].iov_len = frame->size() - offset;
+            offered += vectors[i].iov_len;
+        }
+        msghdr message = {};
+        message.msg_iov = vectors;
+        message.msg_iovlen = count;
+#ifdef MSG_NOSIGNAL
+        ssize_t written = sendmsg(SocketHandleAccess::get(l_socket), &message, MSG_NOSIGNAL);
+#else
+        ssize_t written = sendmsg(SocketHandleAccess::get(l_socket), &message, 0);
+#endif
+        if(written < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            status = (errno == EAGAIN || errno == EWOULDBLOCK) ? sf::Socket::NotReady
+                   : (errno == EPIPE || errno == ECONNRESET) ? sf::Socket::Disconnected : sf::Socket::Error;
+            break;
+        }
+        consume(static_cast<size_t>(written));
+        if(static_cast<size_t>(written) < offered){
+            status = sf::Socket::Partial;
+            break;
+        }
+    }
+    if(corked){
+        setCork(l_socket, false);
+    }
+    return status;
+#else
+    (void)l_cork;
+    return flushEach(l_socket);
+#endif
+}
+
+void OutboundQueue::consume(size_t l_bytes)
+{
+    while(l_bytes && m_count){
+        size_t left = at(0)->size() - m_offset;
+        if(l_bytes < left){
+            m_offset += l_bytes;
+            return;
+        }
+        l_bytes -= left;
+        popFront();
+    }
+}
+
+void OutboundQueue::clear()
+{
+    while(m_count){
+        popFront();
+    }
+}
+
+void OutboundQueue::popFront()
+{
+    m_bytes -= at(0)->size();
+    at(0).reset();
+    m_head = (m_head + 1) % m_ring.size();
+    --m_count;
+    m_offset = 0;
+}
+
+void OutboundQueue::eraseAt(const size_t &l_index)
+{
+    m_bytes -= at(l_index)->size();
+    for(size_t i = l_index; i > 0; --i){
+        at(i) = std::move(at(i - 1));
+    }
+    at(0).reset();
+    m_head = (m_head + 1) % m_ring.size();
+    --m_count;
+}
+
+bool OutboundQueue::conflate(const Frame &l_frame)
+{
+    auto kind = frameKind(l_frame);
+    size_t first = m_offset ? 1 : 0;
+    for(size_t i = m_count; i > first; --i){
+        auto& queued = at(i - 1);
+        if(frameKind(queued) == kind){
+            m_bytes += l_frame->size() - queued->size();
+            queued = l_frame;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,46 @@
+#include "ratelimit.h"
+
+std::shared_ptr<AddressBuckets> AddressLimiter::acquire(const std::string &l_ip)
+{
+    if(!m_limits.isEnabled()){
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lk(m_mutex);
+    // amortized, a sweep every so many connections keeps the map bounded by the active addresses
+    if(++m_acquired % 1024 == 0){
+        sweep();
+    }
+    auto& buckets = m_addresses[l_ip];
+    if(!buckets){
+        buckets = std::make_shared<AddressBuckets>();
+    }
+    return buckets;
+}
+
+void AddressLimiter::clear()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_addresses.clear();
+}
+
+size_t AddressLimiter::size()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_addresses.size();
+}
+
+void AddressLimiter::sweep()
+{
+    auto now = TokenBucket::Clock::now();
+    for(auto itr = m_addresses.begin(); itr != m_addresses.end();){
+        auto& address = itr->second;
+        bool idle = address.use_count() == 1;
+        if(idle){
+            std::lock_guard<std::mutex> lk(address->m_mutex);
+            for(auto kind : {RateKind::Messages, RateKind::Bytes, RateKind::Passwords}){
+                idle = idle && address->m_buckets.get(kind).isFull(m_limits.get(kind), now);
+            }
+        }
+        itr = idle ? m_addresses.erase(itr) : std::next(itr);
+    }
+}
@@ -0,0 +1,210 @@
+#include "reactor.h"
+#include "../../Shared/shared.h"
+#include <algorithm>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+Reactor::Reactor() :
+    m_wakerPort(0),
+    m_wakePending(false)
+{
+    m_waker.bind(sf::Socket::AnyPort, sf::IpAddress::LocalHost);
+    m_waker.setBlocking(false);
+    m_wakerPort = m_waker.getLocalPort();
+}
+
+std::unique_ptr<Reactor> Reactor::create(const Backend &l_backend)
+{
+    std::unique_ptr<Reactor> reactor;
+#ifdef __linux__
+    if(l_backend == Backend::Epoll){
+        reactor = std::make_unique<EpollReactor>();
+    }
+#endif
+    if(!reactor){
+        reactor = std::make_unique<SelectorReactor>();
+    }
+    reactor->add(reactor->m_waker, &reactor->m_waker);
+    return reactor;
+}
+
+bool Reactor::add(Pollable &l_source, void *l_data)
+{
+    if(sf::Socket* socket = l_source.getSocket()){
+        return add(*socket, l_data);
+    }
+    if(!m_signaling.emplace(&l_source, l_data).second){
+        return false;
+    }
+    l_source.setNotifier([this, l_data](bool l_readable, bool l_writable){ signal(l_data, l_readable, l_writable); });
+    // whatever became ready before the notifier was set would never be reported
+    signal(l_data, true, false);
+    return true;
+}
+
+void Reactor::remove(Pollable &l_source)
+{
+    if(sf::Socket* socket = l_source.getSocket()){
+        remove(*socket);
+        return;
+    }
+    auto itr = m_signaling.find(&l_source);
+    if(itr == m_signaling.end()){
+        return;
+    }
+    l_source.setNotifier(nullptr);
+    // readiness reported earlier must not outlive the data it points to
+    void* data = itr->second;
+    m_signaling.erase(itr);
+    std::lock_guard<std::mutex> lk(m_signalMutex);
+    m_signaled.erase(std::remove_if(m_signaled.begin(), m_signaled.end(), [data](const ReadyEvent& a) { return a.m_data == data; }), m_signaled.end());
+}
+
+void Reactor::clear()
+{
+    removeAll();
+    add(m_waker, &m_waker);
+    m_signaling.clear();
+    std::lock_guard<std::mutex> lk(m_signalMutex);
+    m_signaled.clear();
+}
+
+bool Reactor::wait(const sf::Time &l_timeout, ReadyList &l_ready)
+{
+    l_ready.clear();
+    if(poll(l_timeout, l_ready)){
+        auto itr = std::find_if(l_ready.begin(), l_ready.end(), [this](const ReadyEvent& a) { return a.m_data == &m_waker; });
+        if(itr != l_ready.end()){
+            l_ready.erase(itr);
+            char buffer[64];
+            std::size_t received;
+            sf::IpAddress sender;
+            unsigned short port;
+            while(m_waker.receive(buffer, sizeof(buffer), received, sender, port) == sf::Socket::Done);
+            // cleared after draining, a wake up suppressed in between is covered by the caller checking its queue
+            m_wakePending = false;
+        }
+    }
+    // taken after m_wakePending is cleared, whatever is signaled later wakes the next wait()
+    std::lock_guard<std::mutex> lk(m_signalMutex);
+    l_ready.insert(l_ready.end(), m_signaled.begin(), m_signaled.end());
+    m_signaled.clear();
+    return !l_ready.empty();
+}
+
+void Reactor::signal(void *l_data, const bool &l_readable, const bool &l_writable)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_signalMutex);
+        m_signaled.push_back({l_data, l_readable, l_writable});
+    }
+    wakeUp();
+}
+
+void Reactor::wakeUp()
+{
+    if(m_wakePending.exchange(true)){
+        return;
+    }
+    char byte = 0;
+    m_waker.send(&byte, 1, sf::IpAddress::LocalHost, m_wakerPort);
+}
+
+bool SelectorReactor::add(sf::Socket &l_socket, void *l_data)
+{
+    if(m_indexes.count(&l_socket)){
+        return false;
+    }
+    m_indexes.emplace(&l_socket, m_sockets.size());
+    m_sockets.emplace_back(&l_socket, l_data);
+    m_selector.add(l_socket);
+    return true;
+}
+
+void SelectorReactor::remove(sf::Socket &l_socket)
+{
+    auto itr = m_indexes.find(&l_socket);
+    if(itr == m_indexes.end()){
+        return;
+    }
+    size_t index = itr->second;
+    m_indexes.erase(itr);
+    if(index != m_sockets.size() - 1){
+        m_sockets[index] = m_sockets.back();
+        m_indexes[m_sockets[index].first] = index;
+    }
+    m_sockets.pop_back();
+    m_selector.remove(l_socket);
+}
+
+void SelectorReactor::removeAll()
+{
+    m_sockets.clear();
+    m_indexes.clear();
+    m_selector.clear();
+}
+
+bool SelectorReactor::poll(const sf::Time &l_timeout, ReadyList &l_ready)
+{
+    if(!m_selector.wait(l_timeout)){
+        return false;
+    }
+    for(auto& itr : m_sockets){
+        if(m_selector.isReady(*itr.first)){
+            l_ready.push_back({itr.second, true, false});
+        }
+    }
+    return !l_ready.empty();
+}
+
+#ifdef __linux__
+EpollReactor::EpollReactor() :
+    m_epoll(epoll_create1(EPOLL_CLOEXEC)),
+    m_events(1024)
+{
+
+}
+
+EpollReactor::~EpollReactor()
+{
+    if(m_epoll != -1){
+        close(m_epoll);
+    }
+}
+
+bool EpollReactor::add(sf::Socket &l_socket, void *l_data)
+{
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = l_data;
+    return epoll_ctl(m_epoll, EPOLL_CTL_ADD, SocketHandleAccess::get(l_socket), &event) == 0;
+}
+
+void EpollReactor::remove(sf::Socket &l_socket)
+{
+    epoll_event event = {};
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, SocketHandleAccess::get(l_socket), &event);
+}
+
+void EpollReactor::removeAll()
+{
+    if(m_epoll != -1){
+        close(m_epoll);
+    }
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+}
+
+bool EpollReactor::poll(const sf::Time &l_timeout, ReadyList &l_ready)
+{
+    int count = epoll_wait(m_epoll, m_events.data(), static_cast<int>(m_events.size()), l_timeout.asMilliseconds());
+    for(int i = 0; i < count; ++i){
+        auto events = m_events[i].events;
+        l_ready.push_back({m_events[i].data.ptr, (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0, (events & EPOLLOUT) != 0});
+    }
+    if(count == static_cast<int>(m_events.size())){
+        m_events.resize(m_events.size() * 2);
+    }
+    return count > 0;
+}
+#endif
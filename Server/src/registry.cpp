@@ -0,0 +1,214 @@
+#include "registry.h"
+#include <algorithm>
+#include <functional>
+
+ClientHandle ClientRegistry::add(ClientServerData *l_client, Shard *l_shard, const std::string &l_ip)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    sf::Uint32 slot;
+    if(m_free.empty()){
+        slot = static_cast<sf::Uint32>(m_slots.size());
+        m_slots.emplace_back();
+    } else{
+        slot = m_free.back();
+        m_free.pop_back();
+    }
+    m_slots[slot].m_client = l_client;
+    m_slots[slot].m_shard = l_shard;
+    m_slots[slot].m_ip = l_ip;
+    index(m_byIp, slot);
+    ++m_size;
+    return ClientHandle(slot, m_slots[slot].m_generation);
+}
+
+void ClientRegistry::setName(const ClientHandle &l_handle, const std::string &l_name, const ClientType &l_type)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if(!resolve(l_handle)){
+        return;
+    }
+    auto& slot = m_slots[l_handle.m_slot];
+    if(!slot.m_name.empty()){
+        unindex(m_byName, l_handle.m_slot);
+    }
+    slot.m_name = l_name;
+    slot.m_type = l_type;
+    index(m_byName, l_handle.m_slot);
+}
+
+void ClientRegistry::setType(const ClientHandle &l_handle, const ClientType &l_type)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if(resolve(l_handle)){
+        m_slots[l_handle.m_slot].m_type = l_type;
+    }
+}
+
+void ClientRegistry::remove(const ClientHandle &l_handle)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if(!resolve(l_handle)){
+        return;
+    }
+    auto& slot = m_slots[l_handle.m_slot];
+    if(!slot.m_name.empty()){
+        unindex(m_byName, l_handle.m_slot);
+    }
+    unindex(m_byIp, l_handle.m_slot);
+    slot.m_client = nullptr;
+    slot.m_shard = nullptr;
+    slot.m_name.clear();
+    slot.m_ip.clear();
+    // 0 is reserved for invalid handles
+    if(++slot.m_generation == 0){
+        slot.m_generation = 1;
+    }
+    m_free.push_back(l_handle.m_slot);
+    --m_size;
+}
+
+void ClientRegistry::clear()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_free.clear();
+    for(sf::Uint32 i = 0; i < m_slots.size(); ++i){
+        auto& slot = m_slots[i];
+        if(slot.m_client && ++slot.m_generation == 0){
+            slot.m_generation = 1;
+        }
+        slot.m_client = nullptr;
+        slot.m_shard = nullptr;
+        slot.m_name.clear();
+        slot.m_ip.clear();
+        m_free.push_back(i);
+    }
+    clearIndex(m_byName);
+    clearIndex(m_byIp);
+    m_size = 0;
+}
+
+ClientServerData *ClientRegistry::get(const ClientHandle &l_handle) const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto slot = resolve(l_handle);
+    return slot ? slot->m_client : nullptr;
+}
+
+Shard *ClientRegistry::getShard(const ClientHandle &l_handle) const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto slot = resolve(l_handle);
+    return slot ? slot->m_shard : nullptr;
+}
+
+ClientHandle ClientRegistry::findByName(const std::string &l_name) const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    sf::Uint32 slot = find(m_byName, l_name);
+    return slot == None ? ClientHandle() : ClientHandle(slot, m_slots[slot].m_generation);
+}
+
+ClientHandle ClientRegistry::findByIp(const std::string &l_ip) const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    sf::Uint32 slot = find(m_byIp, l_ip);
+    // a peer still logging in from the same address does not hide one that is logged in
+    for(sf::Uint32 next = slot; next != None; next = m_slots[next].m_nextByIp){
+        if(m_slots[next].m_ip == l_ip && !m_slots[next].m_name.empty()){
+            slot = next;
+            break;
+        }
+    }
+    return slot == None ? ClientHandle() : ClientHandle(slot, m_slots[slot].m_generation);
+}
+
+size_t ClientRegistry::size() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_size;
+}
+
+bool ClientRegistry::getMember(const sf::Uint32 &l_slot, RegistryMember &l_member) const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if(l_slot >= m_slots.size() || !m_slots[l_slot].m_client || m_slots[l_slot].m_name.empty()){
+        return false;
+    }
+    auto& slot = m_slots[l_slot];
+    l_member.m_handle = ClientHandle(l_slot, slot.m_generation);
+    l_member.m_name = slot.m_name;
+    l_member.m_type = slot.m_type;
+    return true;
+}
+
+const ClientRegistry::Slot *ClientRegistry::resolve(const ClientHandle &l_handle) const
+{
+    if(l_handle.m_slot >= m_slots.size()){
+        return nullptr;
+    }
+    auto& slot = m_slots[l_handle.m_slot];
+    if(!slot.m_client || slot.m_generation != l_handle.m_generation){
+        return nullptr;
+    }
+    return &slot;
+}
+
+void ClientRegistry::index(Index &l_index, const sf::Uint32 &l_slot)
+{
+    // kept at one slot per bucket at most, rehashing walks the chains and allocates only the new array
+    if(l_index.m_size >= l_index.m_buckets.size()){
+        std::vector<sf::Uint32> buckets(std::max<size_t>(l_index.m_buckets.size() * 2, 64), None);
+        for(auto head : l_index.m_buckets){
+            while(head != None){
+                sf::Uint32 next = m_slots[head].*l_index.m_next;
+                auto& bucket = buckets[std::hash<std::string>()(m_slots[head].*l_index.m_key) & (buckets.size() - 1)];
+                m_slots[head].*l_index.m_next = bucket;
+                bucket = head;
+                head = next;
+            }
+        }
+        l_index.m_buckets.swap(buckets);
+    }
+    auto& bucket = l_index.m_buckets[std::hash<std::string>()(m_slots[l_slot].*l_index.m_key) & (l_index.m_buckets.size() - 1)];
+    m_slots[l_slot].*l_index.m_next = bucket;
+    bucket = l_slot;
+    ++l_index.m_size;
+}
+
+void ClientRegistry::unindex(Index &l_index, const sf::Uint32 &l_slot)
+{
+    if(l_index.m_buckets.empty()){
+        return;
+    }
+    sf::Uint32* link = &l_index.m_buckets[std::hash<std::string>()(m_slots[l_slot].*l_index.m_key) & (l_index.m_buckets.size() - 1)];
+    while(*link != None){
+        if(*link == l_slot){
+            *link = m_slots[l_slot].*l_index.m_next;
+            m_slots[l_slot].*l_index.m_next = None;
+            --l_index.m_size;
+            return;
+        }
+        link = &(m_slots[*link].*l_index.m_next);
+    }
+}
+
+sf::Uint32 ClientRegistry::find(const Index &l_index, const std::string &l_key) const
+{
+    if(l_index.m_buckets.empty()){
+        return None;
+    }
+    sf::Uint32 slot = l_index.m_buckets[std::hash<std::string>()(l_key) & (l_index.m_buckets.size() - 1)];
+    while(slot != None && m_slots[slot].*l_index.m_key != l_key){
+        slot = m_slots[slot].*l_index.m_next;
+    }
+    return slot;
+}
+
+void ClientRegistry::clearIndex(Index &l_index)
+{
+    std::fill(l_index.m_buckets.begin(), l_index.m_buckets.end(), None);
+    for(auto& slot : m_slots){
+        slot.*l_index.m_next = None;
+    }
+    l_index.m_size = 0;
+}
@@ -4,186 +4,938 @@
 #include <utility>
 #include <thread>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    // the same for every login, encoded once so a login allocates no frames of its own
+    const Frame passwordNeeded = encode(toClient::ServerPasswordNeeded{});
+    const Frame serverConnected = encode(toClient::ServerConnected{});
+    const Frame serverIsFull = encode(toClient::ServerIsFull{});
+}
+
+void *ClientServerData::operator new(std::size_t l_size)
+{
+    return l_size == sizeof(ClientServerData) ? pool().allocate() : ::operator new(l_size);
+}
+
+void ClientServerData::operator delete(void *l_pointer, std::size_t l_size)
+{
+    if(l_size == sizeof(ClientServerData)){
+        pool().deallocate(l_pointer);
+    } else{
+        ::operator delete(l_pointer);
+    }
+}
+
+SlabPool<ClientServerData> &ClientServerData::pool()
+{
+    // never destroyed, records may still be released while static objects are torn down
+    static auto pool = new SlabPool<ClientServerData>;
+    return *pool;
+}
 
 Server::Server() :
+    m_listener(std::make_unique<TcpListener>()),
+    m_backend(Backend::Selector),
+    m_nextShard(0),
+    m_slowConsumerPolicy(SlowConsumerPolicy::Disconnect),
+    m_outboundLimit(256),
+    m_handshakeTimeout(10000),
+    m_maxProtocol(Protocol::V2),
+    m_compactClients(0),
+    m_coalesceWindow(0),
+    m_noDelay(true),
+    m_cork(false),
+    m_throttled{{0}, {0}, {0}},
+    m_accepted(0),
+    m_blockedPeers(0),
+    m_metricsInterval(10),
+    m_blocked(std::make_shared<Blocklist>()),
     m_port(0),
     m_max(-1),
     m_password(""),
     m_version("1.0"),
-    m_running(false)
+    m_running(false),
+    m_connectedClients(0),
+    m_handshakingClients(0),
+    m_clientsOfType{{0}, {0}}
 {
-
+    createShards(1);
 }
 
 Server::~Server()
 {
-    for(auto& itr : m_clients){
-        itr->m_client.m_socket.disconnect();
+    for(auto& shard : m_shards){
+        for(auto& itr : shard->m_clients){
+            itr->m_client.m_connection->disconnect();
+        }
+        shard->m_clients.clear();
+        shard->m_reactor->clear();
+    }
+    m_registry.clear();
+    m_listener->close();
+}
+
+void Server::setBackend(const Backend &l_backend)
+{
+    m_backend = l_backend;
+    createShards(m_shards.size());
+}
+
+void Server::setReactorThreads(const size_t &l_threads)
+{
+    createShards(std::max<size_t>(l_threads, 1));
+}
+
+void Server::createShards(const size_t &l_count)
+{
+    m_shards.clear();
+    m_registry.clear();
+    m_channelDirectory.setShards(l_count);
+    for(size_t i = 0; i < l_count; ++i){
+        m_shards.push_back(std::make_unique<Shard>(i, m_backend));
     }
-    m_clients.clear();
-    m_blocked.clear();
-    m_selector.clear();
-    m_listener.close();
 }
 
 int Server::run()
 {
     m_running = true;
-    if(m_listener.listen(m_port) != sf::Socket::Done){
-        error("Error when listening on port: " + m_port);
+    if(!m_blocklistPath.empty() && std::filesystem::exists(m_blocklistPath) && !reloadBlocklist()){
+        error("Unable to load blocklist from: " + m_blocklistPath);
         return -1;
     }
-    m_selector.add(m_listener);
+    if(!openJournal()){
+        error("Unable to open journal in: " + m_journalDirectory);
+        return -1;
+    }
+    if(!m_listener->listen(m_port)){
+        error("Error when listening on port: " + std::to_string(m_port));
+        m_journal.close();
+        return -1;
+    }
+    std::thread metrics;
+    if(!m_metricsPath.empty()){
+        metrics = std::thread(&Server::dumpMetrics, this);
+    }
+    if(m_shards.size() == 1){
+        m_shards.front()->m_reactor->add(*m_listener, m_listener.get());
+        runShard(*m_shards.front());
+        if(metrics.joinable()) metrics.join();
+        m_journal.close();
+        return 0;
+    }
+
+    for(auto& shard : m_shards){
+        shard->m_thread = std::thread(&Server::runShard, this, std::ref(*shard));
+    }
+    // dedicated acceptor, connections are handed over to the shards in round-robin
+    auto acceptor = Reactor::create(m_backend);
+    acceptor->add(*m_listener, m_listener.get());
+    ReadyList ready;
+    while(m_running)
+    {
+        if(acceptor->wait(sf::milliseconds(50), ready)){
+            acceptNewClients();
+        }
+    }
+    acceptor->remove(*m_listener);
+    for(auto& shard : m_shards){
+        shard->m_reactor->wakeUp();
+        shard->m_thread.join();
+    }
+    if(metrics.joinable()) metrics.join();
+    m_journal.close();
+    return 0;
+}
+
+void Server::dumpMetrics()
+{
+    auto next = std::chrono::steady_clock::now() + m_metricsInterval;
+    while(m_running){
+        // short naps, so quitting is not held up by a long interval
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if(std::chrono::steady_clock::now() < next){
+            continue;
+        }
+        next += m_metricsInterval;
+        std::ofstream file(m_metricsPath, std::ios::app);
+        if(!(file << getMetrics().toJson() << '\n')){
+            error("Unable to write metrics to: " + m_metricsPath);
+            return;
+        }
+    }
+}
+
+bool Server::openJournal()
+{
+    if(m_journalDirectory.empty()){
+        return true;
+    }
+    if(!m_journal.open(m_journalDirectory)){
+        return false;
+    }
+    // the newest messages of the previous run become the history again
+    m_history.clear();
+    m_journal.replayTail(m_history.getCapacity(), [this](const JournalRecord& l_record){
+        if(l_record.m_kind == JournalKind::Message){
+            m_history.record(std::make_shared<std::vector<char>>(l_record.m_payload.begin(), l_record.m_payload.end()));
+        }
+    });
+    return true;
+}
+
+void Server::journalEvent(const JournalKind &l_kind, std::unique_ptr<ClientServerData> &l_client, const sf::Uint8 &l_detail)
+{
+    if(!m_journal.isOpen()){
+        return;
+    }
+    sf::Packet packet;
+    packet << l_client->m_client.m_name << l_client->m_ip << l_detail;
+    m_journal.append(l_kind, std::string_view(static_cast<const char*>(packet.getData()), packet.getDataSize()));
+}
+
+void Server::runShard(Shard &l_shard)
+{
+    l_shard.m_owner = std::this_thread::get_id();
     while(m_running)
     {
-        if(m_selector.wait(sf::milliseconds(50))){
-            if(m_selector.isReady(m_listener)){
-                auto client = std::make_unique<ClientServerData>();
-                if(m_listener.accept(client->m_client.m_socket) == sf::Socket::Done){
-                    client->m_ip = client->m_client.m_socket.getRemoteAddress().toString();
-                    if(!isBlocked(client->m_ip)){
-                        processNewClient(std::move(client));
-                    } else{
-                        sf::Packet packet;
-                        packet << Type::Kick;
-                        if(!sendMessageTo(client, packet)){
-                            onErrorWithSendingData(client);
-                        }
-                        onClientBlocked(client);
-                    }
+        // other threads add to the pending and batched clients under the lock, it is only released to wait
+        std::unique_lock<std::mutex> lk(l_shard.m_mutex);
+        // without writability notifications pending output is retried on a short timeout
+        sf::Time timeout = l_shard.m_pendingFlush.empty() ? sf::milliseconds(50) : sf::milliseconds(5);
+        if(!l_shard.m_batch.empty()){
+            // rounded up, the backends wait in whole milliseconds
+            auto left = std::chrono::duration_cast<std::chrono::microseconds>(l_shard.m_batchDeadline - std::chrono::steady_clock::now());
+            timeout = std::min(timeout, sf::milliseconds(static_cast<sf::Int32>(std::max<sf::Int64>(left.count() + 999, 0) / 1000)));
+        }
+        lk.unlock();
+        bool ready = l_shard.m_reactor->wait(timeout, l_shard.m_ready);
+        auto woken = std::chrono::steady_clock::now();
+        lk.lock();
+        if(ready){
+            for(auto& event : l_shard.m_ready){
+                if(event.m_data == m_listener.get()){
+                    acceptNewClients();
+                    continue;
+                }
+                auto client = static_cast<ClientServerData*>(event.m_data);
+                if(!client->m_removed && event.m_writable){
+                    flushClient(l_shard.m_clients[client->m_index]);
+                }
+                if(!client->m_removed && event.m_readable){
+                    receiveFrom(l_shard.m_clients[client->m_index]);
                 }
             }
-            std::lock_guard<std::mutex> lk(m_mutex);
-            auto itr = std::begin(m_clients);
-            while(itr != std::end(m_clients)){
-                auto& socket = (*itr)->m_client.m_socket;
-                if(m_selector.isReady(socket)){
-                    sf::Packet packet;
-                    auto status = socket.receive(packet);
-                    if(status == sf::Socket::Done){
-                        onClientPacketReceived(*itr, packet);
-                    } else if(status == sf::Socket::Disconnected){
-                        if((*itr)->m_connected){
-                            onClientDisconnected(*itr);
-                            sendConnectionNotification((*itr)->m_client.m_name, Type::Disconnection, &*itr);
-                        }
-                        m_selector.remove(socket);
-                        itr = m_clients.erase(itr);
-                        continue;
-                    }else if (status == sf::Socket::Error){
-                        onErrorWithReceivingData(*itr);
-                    }
+        }
+        // after the events, so a handshake finishing in this wake sees broadcasts queued during it
+        processTasks(l_shard);
+        flushBatch(l_shard);
+        flushPending(l_shard);
+        sweepHandshakes(l_shard);
+        processRemovals(l_shard);
+        l_shard.m_metrics.m_waitingClients.set(static_cast<std::int64_t>(l_shard.m_pendingFlush.size() + l_shard.m_batch.size()));
+        l_shard.m_metrics.m_loop.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - woken).count()));
+    }
+    // deliver what was queued right before quitting, e.g. Type::ServerExit
+    std::lock_guard<std::mutex> lk(l_shard.m_mutex);
+    processTasks(l_shard);
+    l_shard.m_batchDeadline = std::chrono::steady_clock::now();
+    flushBatch(l_shard);
+}
+
+void Server::processTasks(Shard &l_shard)
+{
+    ShardTask task;
+    while(l_shard.m_tasks.pop(task)){
+        if(task.m_traced){
+            Tracer::setCurrent(task.m_traced);
+        }
+        if(task.m_client){
+            processNewClient(l_shard, std::move(task.m_client));
+        } else if(!task.m_channel.empty()){
+            sendToChannelShard(l_shard, task.m_channel, task.m_frame, nullptr);
+        } else if(task.m_target.isValid()){
+            sendToTarget(l_shard, task);
+        } else{
+            sendToShard(l_shard, task, nullptr);
+        }
+        if(task.m_traced){
+            Tracer::setCurrent(0);
+        }
+    }
+}
+
+void Server::acceptNewClients()
+{
+    // blocked peers are turned away before anything is allocated for them
+    static const Frame kick = encode(toClient::Kick{});
+    while(true){
+        PeerAddress address;
+        if(!m_listener->accept(address)){
+            return;
+        }
+        ++m_accepted;
+        if(isBlocked(address)){
+            ++m_blockedPeers;
+            m_listener->reject(kick->data(), kick->size());
+            onClientBlocked(address.toString());
+            continue;
+        }
+        auto client = std::make_unique<ClientServerData>();
+        client->m_client.m_connection = m_listener->adopt();
+        client->m_ip = address.toString();
+        if(m_shards.size() == 1){
+            processNewClient(*m_shards.front(), std::move(client));
+        } else{
+            auto& shard = m_shards[m_nextShard++ % m_shards.size()];
+            ShardTask task;
+            task.m_client = std::move(client);
+            shard->m_tasks.push(std::move(task));
+            shard->m_reactor->wakeUp();
+        }
+    }
+}
+
+void Server::receiveFrom(std::unique_ptr<ClientServerData> &l_client)
+{
+    auto& connection = *l_client->m_client.m_connection;
+    // edge-triggered backends report a socket once, so it is read until NotReady. So are
+    // connections without a socket, they signal new data and not that some is left
+    bool drain = l_client->m_shard->m_reactor->isEdgeTriggered() || !connection.getSocket();
+    do{
+        sf::Packet packet;
+        auto status = connection.receive(packet);
+        if(status == sf::Socket::Done){
+            auto& metrics = l_client->m_shard->m_metrics;
+            metrics.m_packetsIn[packetKind(static_cast<const char*>(packet.getData()), packet.getDataSize())].add();
+            metrics.m_bytesIn.add(sizeof(sf::Uint32) + packet.getDataSize());
+            // metered before anything is decoded, a throttled packet costs no fan-out
+            if(!admitPacket(l_client, packet)){
+                if(l_client->m_state == HandshakeState::AwaitingPassword){
+                    sendFrameTo(l_client, passwordNeeded);
                 }
-                ++itr;
+                continue;
+            }
+            // traced once admitted, a throttled packet is never made current
+            std::uint64_t traced = m_tracer.begin();
+            if(l_client->m_state == HandshakeState::Connected){
+                onClientPacketReceived(l_client, packet);
+            } else{
+                onHandshakePacketReceived(l_client, packet);
+            }
+            if(traced){
+                Tracer::setCurrent(0);
             }
+        } else if(status == sf::Socket::Disconnected){
+            if(l_client->m_connected){
+                onClientDisconnected(l_client);
+            }
+            dropClient(l_client);
+            return;
+        } else if(status == sf::Socket::Error){
+            // a broken socket is never reported again by an edge-triggered backend and on every wake by select()
+            l_client->m_shard->m_metrics.m_receiveErrors.add();
+            onErrorWithReceivingData(l_client);
+            dropClient(l_client);
+            return;
+        } else{
+            return;
         }
+    } while(drain && !l_client->m_removed);
+}
+
+bool Server::admitPacket(std::unique_ptr<ClientServerData> &l_client, const sf::Packet &l_packet)
+{
+    // the login moves the connection on, so there is one per connection and dropping it would stall the handshake
+    if((!m_connectionLimits.isEnabled() && !l_client->m_address) || l_client->m_state == HandshakeState::AwaitingClientData){
+        return true;
     }
-    return 0;
+    auto now = TokenBucket::Clock::now();
+    if(l_client->m_state == HandshakeState::AwaitingPassword){
+        return takeTokens(l_client, {{RateKind::Passwords, 1}}, now);
+    }
+    return takeTokens(l_client, {{RateKind::Messages, 1}, {RateKind::Bytes, static_cast<double>(l_packet.getDataSize())}}, now);
 }
 
-void Server::processNewClient(std::unique_ptr<ClientServerData> && client)
+bool Server::takeTokens(std::unique_ptr<ClientServerData> &l_client, std::initializer_list<RateCost> l_costs, const TokenBucket::Clock::time_point &l_now)
 {
-    m_clients.push_back(std::move(client));
-    m_selector.add(m_clients.back()->m_client.m_socket);
+    // every bucket is checked before any is taken from, a rejected packet costs nothing
+    std::unique_lock<std::mutex> lk;
+    if(l_client->m_address){
+        lk = std::unique_lock<std::mutex>(l_client->m_address->m_mutex);
+    }
+    auto& addressLimits = m_addressLimiter.getLimits();
+    for(auto& cost : l_costs){
+        if(!l_client->m_buckets.get(cost.m_kind).covers(m_connectionLimits.get(cost.m_kind), cost.m_tokens, l_now)
+                || (l_client->m_address && !l_client->m_address->m_buckets.get(cost.m_kind).covers(addressLimits.get(cost.m_kind), cost.m_tokens, l_now))){
+            ++m_throttled[static_cast<size_t>(cost.m_kind)];
+            return false;
+        }
+    }
+    for(auto& cost : l_costs){
+        l_client->m_buckets.get(cost.m_kind).take(m_connectionLimits.get(cost.m_kind), cost.m_tokens, l_now);
+        if(l_client->m_address){
+            l_client->m_address->m_buckets.get(cost.m_kind).take(addressLimits.get(cost.m_kind), cost.m_tokens, l_now);
+        }
+    }
+    return true;
+}
+
+void Server::scheduleRemoval(std::unique_ptr<ClientServerData> &l_client)
+{
+    if(l_client->m_removed){
+        return;
+    }
+    l_client->m_removed = true;
+    m_registry.remove(l_client->m_handle);
+    for(auto& channel : l_client->m_channels){
+        m_channelDirectory.leave(channel, l_client->m_shard->m_id);
+    }
+    if(l_client->m_state != HandshakeState::Connected){
+        leaveHandshake(l_client.get());
+    } else{
+        countClientOfType(l_client->m_client.m_type, -1);
+        if(l_client->m_protocol == Protocol::V2){
+            --m_compactClients;
+        }
+    }
+    // kick and promote drop clients from other threads, the reactor is left to the shard's own thread
+    Shard* shard = l_client->m_shard;
+    shard->m_removals.push_back(l_client.get());
+    shard->m_metrics.m_disconnected.add();
+    if(shard->m_owner != std::this_thread::get_id()){
+        shard->m_reactor->wakeUp();
+    }
+}
+
+void Server::processRemovals(Shard &l_shard)
+{
+    // clients are released only here, so pointers from the current ready list stay valid.
+    // Only the shard's thread waits on its reactor, so only it changes what the reactor watches
+    auto& clients = l_shard.m_clients;
+    for(auto client : l_shard.m_removals){
+        l_shard.m_reactor->remove(*client->m_client.m_connection);
+        if(client->m_batched){
+            auto& batch = l_shard.m_batch;
+            batch.erase(std::find(batch.begin(), batch.end(), client));
+        }
+        for(auto& channel : client->m_channels){
+            unindexChannel(l_shard, channel, client);
+        }
+        l_shard.m_metrics.m_queuedFrames.add(-static_cast<std::int64_t>(client->m_outbound.size()));
+        size_t index = client->m_index;
+        if(index != clients.size() - 1){
+            std::swap(clients[index], clients.back());
+            clients[index]->m_index = index;
+        }
+        clients.pop_back();
+    }
+    l_shard.m_removals.clear();
+}
+
+void Server::processNewClient(Shard &l_shard, std::unique_ptr<ClientServerData> && client)
+{
+    auto& connection = *client->m_client.m_connection;
+    connection.setBlocking(false);
+    if(!m_noDelay && connection.getSocket()){
+        ::setNoDelay(*connection.getSocket(), false);
+    }
+    client->m_shard = &l_shard;
+    client->m_index = l_shard.m_clients.size();
+    client->m_handshakeIndex = l_shard.m_handshaking.size();
+    client->m_deadline = std::chrono::steady_clock::now() + m_handshakeTimeout;
+    client->m_outbound.setCapacity(m_outboundLimit);
+    client->m_address = m_addressLimiter.acquire(client->m_ip);
+    l_shard.m_clients.push_back(std::move(client));
+    auto& added = l_shard.m_clients.back();
+    added->m_handle = m_registry.add(added.get(), &l_shard, added->m_ip);
+    l_shard.m_handshaking.push_back(added.get());
+    ++m_handshakingClients;
+    l_shard.m_reactor->add(*added->m_client.m_connection, added.get());
 
     if(!m_password.empty()){
-        sf::Packet packet;
-        packet << Type::ServerPasswordNeeded;
-        sendMessageTo(m_clients.back(), packet);
+        sendFrameTo(added, passwordNeeded);
         return;
     }
+    admitNewClient(added);
+}
 
-    std::thread(&Server::prepareNewClient, this, std::ref(m_clients.back())).detach();
+bool Server::block(const std::string &l_ip)
+{
+    return updateBlocklist([&l_ip](Blocklist& l_blocklist){ return l_blocklist.insert(l_ip); });
+}
+
+bool Server::unblock(const std::string &l_ip)
+{
+    return updateBlocklist([&l_ip](Blocklist& l_blocklist){ return l_blocklist.erase(l_ip); });
 }
 
 bool Server::isBlocked(const std::string &l_ip)
 {
-    return m_blocked.count(l_ip) ? true : false;
+    return std::atomic_load(&m_blocked)->matches(l_ip);
 }
 
-void Server::prepareNewClient(std::unique_ptr<ClientServerData> &client)
+bool Server::isBlocked(const PeerAddress &l_address)
 {
-    sf::Packet packet;
-    std::lock_guard<std::mutex> lk(m_mutex);
-    if(static_cast<sf::Uint32>(std::count_if(m_clients.begin(), m_clients.end(), [](const std::unique_ptr<ClientServerData>& a) { return a->m_connected; })) < m_max){
-        packet << Type::ServerConnected;
-        sendMessageTo(client, packet);
-        packet.clear();
-        auto status = client->m_client.m_socket.receive(packet);
-        if(status != sf::Socket::Done){
-            onErrorWithReceivingData(client);
-        } else{
-            packet >> client->m_client.m_name >> client->m_client.m_type;
-            finishNewClient(client);
+    return std::atomic_load(&m_blocked)->matches(l_address);
+}
+
+bool Server::reloadBlocklist()
+{
+    if(m_blocklistPath.empty()){
+        return false;
+    }
+    // read and built aside, the listener keeps checking peers against the old one meanwhile
+    auto loaded = std::make_shared<Blocklist>();
+    if(!loaded->load(m_blocklistPath)){
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(m_blockedMutex);
+    std::atomic_store(&m_blocked, std::shared_ptr<const Blocklist>(std::move(loaded)));
+    return true;
+}
+
+std::vector<std::string> Server::getBlockedRanges()
+{
+    return std::atomic_load(&m_blocked)->getRanges();
+}
+
+bool Server::updateBlocklist(const std::function<bool (Blocklist &)> &l_change)
+{
+    std::lock_guard<std::mutex> lk(m_blockedMutex);
+    auto changed = std::make_shared<Blocklist>(*m_blocked);
+    if(!l_change(*changed)){
+        return false;
+    }
+    if(!m_blocklistPath.empty() && !changed->save(m_blocklistPath)){
+        error("Unable to save blocklist to: " + m_blocklistPath);
+    }
+    std::atomic_store(&m_blocked, std::shared_ptr<const Blocklist>(std::move(changed)));
+    return true;
+}
+
+bool Server::reserveSlot()
+{
+    sf::Uint32 count = m_connectedClients;
+    while(count < m_max){
+        if(m_connectedClients.compare_exchange_weak(count, count + 1)){
+            return true;
         }
+    }
+    return false;
+}
+
+void Server::admitNewClient(std::unique_ptr<ClientServerData> &l_client)
+{
+    // the slot is taken before ServerConnected goes out, so handshakes in flight cannot overfill the server
+    if(reserveSlot()){
+        l_client->m_state = HandshakeState::AwaitingClientData;
+        sendFrameTo(l_client, serverConnected);
     } else{
-        packet << Type::ServerIsFull;
-        sendMessageTo(client, packet);
-        onClientRejected(client);
-        m_selector.remove(client->m_client.m_socket);
-        m_clients.erase(std::find(std::begin(m_clients), std::end(m_clients), client));
+        sendFrameTo(l_client, serverIsFull);
+        l_client->m_shard->m_metrics.m_handshakeFailures.add();
+        onClientRejected(l_client);
+        scheduleRemoval(l_client);
     }
 }
 
-void Server::finishNewClient(std::unique_ptr<ClientServerData>& l_client)
+void Server::onHandshakePacketReceived(std::unique_ptr<ClientServerData> &l_client, sf::Packet &l_packet)
 {
-    l_client->m_client.m_socket.setBlocking(false);
+    if(l_client->m_state == HandshakeState::AwaitingClientData){
+        finishNewClient(l_client, l_packet);
+        return;
+    }
+    PacketReader reader(l_packet);
+    Type type;
+    toServer::Password password;
+    if(!(reader >> type) || type != Type::Password || !decode(reader, password)){
+        return;
+    }
+    if(password.password == m_password){
+        admitNewClient(l_client);
+    } else{
+        l_client->m_shard->m_metrics.m_handshakeFailures.add();
+        sendFrameTo(l_client, passwordNeeded);
+    }
+}
+
+void Server::finishNewClient(std::unique_ptr<ClientServerData>& l_client, sf::Packet& l_packet)
+{
+    // the role is decided by the server, the claimed one is read and ignored
+    PacketReader reader(l_packet);
+    std::string_view name;
+    ClientType claimed;
+    reader >> name >> claimed;
+    l_client->m_client.m_name.assign(name);
+    // clients that predate protocol v2 send nothing more
+    Protocol protocol = Protocol::V1;
+    if(!reader.endOfPacket() && reader >> protocol){
+        l_client->m_protocol = std::min(protocol, m_maxProtocol);
+    }
+    leaveHandshake(l_client.get());
+    l_client->m_state = HandshakeState::Connected;
+    countClientOfType(l_client->m_client.m_type, 1);
+    m_registry.setName(l_client->m_handle, l_client->m_client.m_name, l_client->m_client.m_type);
+    if(l_client->m_protocol == Protocol::V2){
+        ++m_compactClients;
+    }
+    // announced before anything is sent to it, a send failing below reports the disconnection then
     l_client->m_connected = true;
     onClientConnected(l_client);
-    sendConnectionNotification(l_client->m_client.m_name, Type::Connection, &l_client);
+    sendConnectionNotification(l_client, Type::Connection);
+    if(l_client->m_protocol == Protocol::V2){
+        sendWelcome(l_client);
+    }
+    sendHistory(l_client);
 }
 
-bool Server::sendMessageToAllClientsFrom(std::unique_ptr<ClientServerData>& l_data, const std::string &l_text)
+void Server::sendWelcome(std::unique_ptr<ClientServerData> &l_client)
 {
-    sf::Packet packet;
-    packet << Type::Message;
-    packet << l_data->m_client.m_type << l_data->m_client.m_name << l_text;
-    return sendMessageToAllClients(packet, &l_data);
+    // sender ids are registry slots, the client asks for the ones it has not seen in a Notice
+    FrameWriter frame;
+    frame << Opcode::Welcome << Protocol::V2;
+    frame.varint(l_client->m_handle.m_slot);
+    sendFrameTo(l_client, frame.finish());
+}
+
+void Server::sendMember(std::unique_ptr<ClientServerData> &l_client, const sf::Uint32 &l_slot)
+{
+    RegistryMember member{ClientHandle(), std::string(), ClientType::Normie};
+    m_registry.getMember(l_slot, member);
+    FrameWriter frame;
+    frame << Opcode::Member;
+    frame.varint(l_slot) << static_cast<sf::Uint8>(member.m_type);
+    frame.text(member.m_name);
+    sendFrameTo(l_client, frame.finish());
+}
+
+void Server::sendHistory(std::unique_ptr<ClientServerData> &l_client)
+{
+    // v1 frames carry the sender's name, so they stay readable after the sender has left
+    Frame history = m_history.replay(l_client->m_historySequence);
+    if(history){
+        sendFrameTo(l_client, history);
+    }
+}
+
+void Server::leaveHandshake(ClientServerData *l_client)
+{
+    auto& handshaking = l_client->m_shard->m_handshaking;
+    size_t index = l_client->m_handshakeIndex;
+    if(index != handshaking.size() - 1){
+        handshaking[index] = handshaking.back();
+        handshaking[index]->m_handshakeIndex = index;
+    }
+    handshaking.pop_back();
+    --m_handshakingClients;
+}
+
+void Server::countClientOfType(const ClientType &l_type, const int &l_delta)
+{
+    m_clientsOfType[static_cast<size_t>(l_type)] += l_delta;
+}
+
+ServerStats Server::getStats() const
+{
+    ServerStats stats;
+    stats.m_connected = m_connectedClients;
+    stats.m_handshaking = m_handshakingClients;
+    stats.m_normies = m_clientsOfType[static_cast<size_t>(ClientType::Normie)];
+    stats.m_administrators = m_clientsOfType[static_cast<size_t>(ClientType::Administrator)];
+    stats.m_max = m_max;
+    stats.m_pooledRecords = ClientServerData::pool().capacity();
+    stats.m_recordBytes = ClientServerData::pool().bytesPerSlot() + PooledTcpConnection::pool().bytesPerSlot() + ClientRegistry::bytesPerClient();
+    stats.m_ringBytes = m_outboundLimit * sizeof(Frame);
+    stats.m_throttledMessages = m_throttled[static_cast<size_t>(RateKind::Messages)];
+    stats.m_throttledBytes = m_throttled[static_cast<size_t>(RateKind::Bytes)];
+    stats.m_throttledPasswords = m_throttled[static_cast<size_t>(RateKind::Passwords)];
+    return stats;
+}
+
+MetricsSnapshot Server::getMetrics() const
+{
+    MetricsSnapshot metrics;
+    metrics.m_accepted = m_accepted;
+    metrics.m_blocked = m_blockedPeers;
+    metrics.m_connected = m_connectedClients;
+    metrics.m_handshaking = m_handshakingClients;
+    for(auto& shard : m_shards){
+        metrics.add(shard->m_metrics);
+    }
+    return metrics;
+}
+
+void Server::sweepHandshakes(Shard &l_shard)
+{
+    auto now = std::chrono::steady_clock::now();
+    if(now - l_shard.m_lastSweep < std::chrono::milliseconds(100)){
+        return;
+    }
+    l_shard.m_lastSweep = now;
+    size_t i = 0;
+    while(i < l_shard.m_handshaking.size()){
+        auto client = l_shard.m_handshaking[i];
+        if(client->m_deadline > now){
+            ++i;
+            continue;
+        }
+        // dropping swaps the last handshake into index i
+        auto& slot = l_shard.m_clients[client->m_index];
+        l_shard.m_metrics.m_handshakeFailures.add();
+        onHandshakeTimeout(slot);
+        dropClient(slot);
+    }
+}
+
+bool Server::sendMessageToAllClientsFrom(std::unique_ptr<ClientServerData>& l_data, std::string_view l_text)
+{
+    Frame encoded = encode(toClient::Message{l_data->m_client.m_type, l_data->m_client.m_name, l_text});
+    auto sequence = m_history.record(encoded);
+    m_journal.append(JournalKind::Message, std::string_view(encoded->data(), encoded->size()));
+    Frame compact;
+    if(hasCompactClients()){
+        FrameWriter writer;
+        writer.reserve(8 + l_text.size());
+        writer << Opcode::Message;
+        writer.varint(l_data->m_handle.m_slot).text(l_text);
+        compact = writer.finish();
+    }
+    return sendFrameToAllClients(encoded, &l_data, compact, sequence);
 }
 
 bool Server::sendMessageToAllClients(const std::string &l_text)
 {
-    sf::Packet packet;
-    packet << Type::ServerMessage << l_text;
-    return sendMessageToAllClients(packet);
+    Frame encoded = encode(toClient::ServerMessage{l_text});
+    auto sequence = m_history.record(encoded);
+    m_journal.append(JournalKind::Message, std::string_view(encoded->data(), encoded->size()));
+    Frame compact;
+    if(hasCompactClients()){
+        FrameWriter writer;
+        writer << Opcode::ServerMessage;
+        writer.text(l_text);
+        compact = writer.finish();
+    }
+    return sendFrameToAllClients(encoded, nullptr, compact, sequence);
 }
 
 bool Server::sendMessageToAllClients(sf::Packet &l_packet, std::unique_ptr<ClientServerData>* l_except)
 {
-    for(auto& itr : m_clients){
-        if(&itr == l_except || !itr->m_connected){
+    // encoded once, every recipient and every shard shares the same frame
+    return sendFrameToAllClients(makeFrame(l_packet), l_except);
+}
+
+bool Server::sendFrameToAllClients(const Frame &l_frame, std::unique_ptr<ClientServerData> *l_except, const Frame &l_compact,
+                                   const std::uint64_t &l_sequence)
+{
+    // the caller holds the lock of l_except's shard, every other shard gets the frame through its queue
+    Shard* local = l_except ? (*l_except)->m_shard : nullptr;
+    for(auto& shard : m_shards){
+        ShardTask task;
+        task.m_frame = l_frame;
+        task.m_compact = l_compact;
+        task.m_traced = m_tracer.currentPacket();
+        task.m_sequence = l_sequence;
+        if(shard.get() == local){
+            sendToShard(*shard, task, l_except);
             continue;
         }
-        if(!sendMessageTo(itr, l_packet)){
-            onErrorWithSendingData(itr);
-        }
+        shard->m_tasks.push(std::move(task));
+        shard->m_reactor->wakeUp();
     }
     return true;
 }
 
-bool Server::sendConnectionNotification(const std::string &l_name, const Type& l_type, std::unique_ptr<ClientServerData>* l_except)
+void Server::sendToShard(Shard &l_shard, const ShardTask &l_task, std::unique_ptr<ClientServerData>* l_except)
 {
-    sf::Packet packet;
-    packet << Type::Connection << l_name << l_type;
-    return sendMessageToAllClients(packet, l_except);
+    for(auto& itr : l_shard.m_clients){
+        if(&itr == l_except || !itr->m_connected || itr->m_removed){
+            continue;
+        }
+        if(l_task.m_sequence && l_task.m_sequence <= itr->m_historySequence){
+            continue;
+        }
+        bool compact = l_task.m_compact && itr->m_protocol == Protocol::V2;
+        // a failed send reports and drops the client by itself
+        sendFrameTo(itr, compact ? l_task.m_compact : l_task.m_frame);
+    }
+}
+
+bool Server::sendConnectionNotification(std::unique_ptr<ClientServerData>& l_client, const Type& l_type)
+{
+    Frame frame = encode(toClient::Connection{l_client->m_client.m_name, l_type});
+    Frame compact;
+    if(hasCompactClients()){
+        FrameWriter writer;
+        writer << Opcode::Notice;
+        writer.varint(l_client->m_handle.m_slot) << static_cast<sf::Uint8>(l_type) << static_cast<sf::Uint8>(l_client->m_client.m_type);
+        writer.text(l_client->m_client.m_name);
+        compact = writer.finish();
+    }
+    return sendFrameToAllClients(frame, &l_client, compact);
 }
 
 bool Server::sendMessageTo(std::unique_ptr<ClientServerData>& l_data, const std::string &l_text)
 {
-    sf::Packet packet;
-    packet << Type::ServerMessage << l_text;
-    return sendMessageTo(l_data, packet);
+    return sendFrameTo(l_data, encode(toClient::ServerMessage{l_text}));
 }
 
 bool Server::sendMessageTo(std::unique_ptr<ClientServerData>& l_data, sf::Packet& l_packet)
 {
-    if(l_data->m_client.m_socket.send(l_packet) == sf::Socket::Error){
-        onErrorWithSendingData(l_data);
+    return sendFrameTo(l_data, makeFrame(l_packet));
+}
+
+bool Server::sendFrameTo(std::unique_ptr<ClientServerData>& l_data, const Frame& l_frame)
+{
+    if(l_data->m_removed){
         return false;
     }
+    auto& metrics = l_data->m_shard->m_metrics;
+    metrics.m_packetsOut[packetKind(l_frame->data() + sizeof(sf::Uint32), l_frame->size() - sizeof(sf::Uint32))].add();
+    metrics.m_bytesOut.add(l_frame->size());
+    auto& queue = l_data->m_outbound;
+    std::uint64_t traced = m_tracer.currentPacket();
+    m_tracer.record(TracePoint::Enqueue, traced);
+    bool coalesce = m_coalesceWindow.count() > 0;
+    if(!coalesce && queue.empty()){
+        auto status = queue.write(l_frame, *l_data->m_client.m_connection);
+        metrics.m_queuedFrames.add(static_cast<std::int64_t>(queue.size()));
+        if(queue.empty()){
+            m_tracer.record(TracePoint::Flush, traced);
+        } else if(traced){
+            l_data->m_traced = traced;
+        }
+        return handleSendStatus(l_data, status);
+    }
+    // a non-empty queue is already waiting for writability
+    size_t queued = queue.size();
+    if(!queue.push(l_frame, m_slowConsumerPolicy)){
+        metrics.m_slowConsumers.add();
+        metrics.m_queuedFrames.add(-static_cast<std::int64_t>(queued));
+        onClientTooSlow(l_data);
+        queue.clear();
+        dropClient(l_data);
+        return false;
+    }
+    metrics.m_queuedFrames.add(static_cast<std::int64_t>(queue.size()) - static_cast<std::int64_t>(queued));
+    if(traced){
+        l_data->m_traced = traced;
+    }
+    if(coalesce){
+        addToBatch(l_data);
+    }
     return true;
 }
 
+bool Server::flushClient(std::unique_ptr<ClientServerData> &l_client)
+{
+    auto& queue = l_client->m_outbound;
+    size_t queued = queue.size();
+    auto status = queue.flush(*l_client->m_client.m_connection, m_cork);
+    l_client->m_shard->m_metrics.m_queuedFrames.add(static_cast<std::int64_t>(queue.size()) - static_cast<std::int64_t>(queued));
+    // the frame of the newest traced packet left with this flush
+    if(l_client->m_traced && queue.empty()){
+        m_tracer.record(TracePoint::Flush, l_client->m_traced);
+        l_client->m_traced = 0;
+    }
+    return handleSendStatus(l_client, status);
+}
+
+void Server::addToBatch(std::unique_ptr<ClientServerData> &l_client)
+{
+    if(l_client->m_batched){
+        return;
+    }
+    Shard* shard = l_client->m_shard;
+    if(shard->m_batch.empty()){
+        shard->m_batchDeadline = std::chrono::steady_clock::now() + m_coalesceWindow;
+        // the owner picks the deadline up on its next wait, anyone else has to wake it
+        if(shard->m_owner != std::this_thread::get_id()){
+            shard->m_reactor->wakeUp();
+        }
+    }
+    l_client->m_batched = true;
+    shard->m_batch.push_back(l_client.get());
+}
+
+void Server::flushBatch(Shard &l_shard)
+{
+    if(l_shard.m_batch.empty() || std::chrono::steady_clock::now() < l_shard.m_batchDeadline){
+        return;
+    }
+    // flushing may drop clients, which only schedules their removal, so the batch stays intact here
+    for(auto client : l_shard.m_batch){
+        client->m_batched = false;
+        if(!client->m_removed){
+            flushClient(l_shard.m_clients[client->m_index]);
+        }
+    }
+    l_shard.m_batch.clear();
+}
+
+bool Server::handleSendStatus(std::unique_ptr<ClientServerData> &l_client, const sf::Socket::Status &l_status)
+{
+    if(l_status == sf::Socket::Done){
+        return true;
+    }
+    if(l_status == sf::Socket::Partial || l_status == sf::Socket::NotReady){
+        Shard* shard = l_client->m_shard;
+        if(shard && !shard->m_reactor->notifiesWritable() && !l_client->m_flushPending){
+            l_client->m_flushPending = true;
+            shard->m_pendingFlush.push_back(l_client.get());
+        }
+        return true;
+    }
+    // the connection is of no use anymore, its record and slot are released like on a receive
+    if(l_status == sf::Socket::Disconnected){
+        if(l_client->m_connected){
+            onClientDisconnected(l_client);
+        }
+    } else{
+        l_client->m_shard->m_metrics.m_sendErrors.add();
+        onErrorWithSendingData(l_client);
+    }
+    dropClient(l_client);
+    return false;
+}
+
+void Server::flushPending(Shard &l_shard)
+{
+    auto& pending = l_shard.m_pendingFlush;
+    auto itr = std::begin(pending);
+    while(itr != std::end(pending)){
+        auto client = *itr;
+        if(!client->m_removed){
+            flushClient(l_shard.m_clients[client->m_index]);
+        }
+        if(client->m_removed || client->m_outbound.empty()){
+            client->m_flushPending = false;
+            *itr = pending.back();
+            pending.pop_back();
+            continue;
+        }
+        ++itr;
+    }
+}
+
+void Server::dropClient(std::unique_ptr<ClientServerData> &l_client, const Type& l_notification)
+{
+    if(l_client->m_removed){
+        return;
+    }
+    // the socket is closed when the client is released at the end of the iteration
+    bool holdsSlot = l_client->m_state != HandshakeState::AwaitingPassword;
+    scheduleRemoval(l_client);
+    if(holdsSlot){
+        --m_connectedClients;
+    }
+    if(l_client->m_connected){
+        sendConnectionNotification(l_client, l_notification);
+    }
+}
+
 bool Server::processArguments(int& argc, char **&argv)
 {
     if(argc == 1){
@@ -196,6 +948,29 @@ bool Server::processArguments(int& argc, char **&argv)
         ("password", "Set server password", cxxopts::value<std::string>())
         ("port", "Set port number", cxxopts::value<sf::Uint16>())
         ("max", "Set maximum clients (default is unlimited)", cxxopts::value<sf::Uint32>())
+        ("backend", "Set event loop backend: select or epoll (default is select)", cxxopts::value<std::string>())
+        ("threads", "Set number of reactor threads (default is 1)", cxxopts::value<size_t>())
+        ("outbound-limit", "Set maximum number of frames queued for one client (default is 256)", cxxopts::value<size_t>())
+        ("slow-consumer", "Set what happens to a client with a full queue: disconnect, drop-oldest or conflate", cxxopts::value<std::string>())
+        ("handshake-timeout", "Set seconds a new client has to finish logging in (default is 10)", cxxopts::value<sf::Uint32>())
+        ("protocol", "Set newest protocol version offered to clients: 1 or 2 (default is 2)", cxxopts::value<int>())
+        ("coalesce-us", "Set microseconds outgoing frames are batched before sending (default is 0, off)", cxxopts::value<sf::Uint32>())
+        ("nodelay", "Set TCP_NODELAY on client sockets: on or off (default is on)", cxxopts::value<std::string>())
+        ("cork", "Cork client sockets while flushing a large backlog")
+        ("history-bytes", "Set bytes of recent messages replayed to joining clients (default is 65536, 0 is off)", cxxopts::value<size_t>())
+        ("journal", "Keep a journal of messages, promotions and kicks in this directory", cxxopts::value<std::string>())
+        ("journal-segment-bytes", "Set size at which the journal starts a new segment file (default is 4194304)", cxxopts::value<size_t>())
+        ("journal-retain-bytes", "Set size of journal segments kept on disk (default is 67108864)", cxxopts::value<size_t>())
+        ("blocklist", "Load blocked addresses from this file and save every change to it", cxxopts::value<std::string>())
+        ("trace-events", "Trace packets through the server, keeping this many events per thread (default is 0, off)", cxxopts::value<size_t>())
+        ("metrics-file", "Append a JSON line of metrics to this file periodically", cxxopts::value<std::string>())
+        ("metrics-interval", "Set seconds between metrics lines (default is 10)", cxxopts::value<sf::Uint32>())
+        ("limit-messages", "Set packets per second one connection may send (default is unlimited)", cxxopts::value<double>())
+        ("limit-bytes", "Set bytes per second one connection may send, also the largest packet let through", cxxopts::value<double>())
+        ("limit-passwords", "Set password attempts per minute one connection may make", cxxopts::value<double>())
+        ("ip-limit-messages", "Set packets per second all connections from one ip may send together", cxxopts::value<double>())
+        ("ip-limit-bytes", "Set bytes per second all connections from one ip may send together", cxxopts::value<double>())
+        ("ip-limit-passwords", "Set password attempts per minute all connections from one ip may make together", cxxopts::value<double>())
     ;
     try
     {
@@ -213,6 +988,98 @@ bool Server::processArguments(int& argc, char **&argv)
         if(result.count("password")){
             m_password = result["password"].as<std::string>();
         }
+        if(result.count("backend")){
+            std::string backend = result["backend"].as<std::string>();
+            if(backend == "epoll"){
+                setBackend(Backend::Epoll);
+            } else if(backend == "select"){
+                setBackend(Backend::Selector);
+            } else{
+                onArgumentsError(("Unknown backend: " + backend).c_str());
+                return false;
+            }
+        }
+        if(result.count("threads")){
+            setReactorThreads(result["threads"].as<size_t>());
+        }
+        if(result.count("outbound-limit")){
+            setOutboundLimit(result["outbound-limit"].as<size_t>());
+        }
+        if(result.count("slow-consumer")){
+            std::string policy = result["slow-consumer"].as<std::string>();
+            if(policy == "disconnect"){
+                setSlowConsumerPolicy(SlowConsumerPolicy::Disconnect);
+            } else if(policy == "drop-oldest"){
+                setSlowConsumerPolicy(SlowConsumerPolicy::DropOldest);
+            } else if(policy == "conflate"){
+                setSlowConsumerPolicy(SlowConsumerPolicy::Conflate);
+            } else{
+                onArgumentsError(("Unknown slow consumer policy: " + policy).c_str());
+                return false;
+            }
+        }
+        if(result.count("handshake-timeout")){
+            setHandshakeTimeout(std::chrono::seconds(result["handshake-timeout"].as<sf::Uint32>()));
+        }
+        if(result.count("protocol")){
+            int protocol = result["protocol"].as<int>();
+            if(protocol != 1 && protocol != 2){
+                onArgumentsError(("Unknown protocol version: " + std::to_string(protocol)).c_str());
+                return false;
+            }
+            setMaxProtocol(static_cast<Protocol>(protocol));
+        }
+        if(result.count("coalesce-us")){
+            setCoalesceWindow(std::chrono::microseconds(result["coalesce-us"].as<sf::Uint32>()));
+        }
+        if(result.count("nodelay")){
+            std::string noDelay = result["nodelay"].as<std::string>();
+            if(noDelay != "on" && noDelay != "off"){
+                onArgumentsError(("Unknown nodelay value: " + noDelay).c_str());
+                return false;
+            }
+            setNoDelay(noDelay == "on");
+        }
+        if(result.count("cork")){
+            setCork(true);
+        }
+        if(result.count("history-bytes")){
+            setHistoryBytes(result["history-bytes"].as<size_t>());
+        }
+        if(result.count("journal")){
+            setJournal(result["journal"].as<std::string>());
+        }
+        if(result.count("journal-segment-bytes")){
+            setJournalSegmentBytes(result["journal-segment-bytes"].as<size_t>());
+        }
+        if(result.count("metrics-file")){
+            sf::Uint32 interval = result.count("metrics-interval") ? result["metrics-interval"].as<sf::Uint32>() : 10;
+            setMetricsDump(result["metrics-file"].as<std::string>(), std::chrono::seconds(std::max<sf::Uint32>(interval, 1)));
+        }
+        if(result.count("trace-events")){
+            setTraceEvents(result["trace-events"].as<size_t>());
+        }
+        if(result.count("blocklist")){
+            setBlocklist(result["blocklist"].as<std::string>());
+        }
+        if(result.count("journal-retain-bytes")){
+            setJournalRetainedBytes(result["journal-retain-bytes"].as<size_t>());
+        }
+        auto limitsOf = [&result](const std::string& l_prefix, RateLimits l_limits){
+            if(result.count(l_prefix + "messages")){
+                l_limits.m_messages = RateLimit(result[l_prefix + "messages"].as<double>());
+            }
+            if(result.count(l_prefix + "bytes")){
+                l_limits.m_bytes = RateLimit(result[l_prefix + "bytes"].as<double>());
+            }
+            if(result.count(l_prefix + "passwords")){
+                double perMinute = result[l_prefix + "passwords"].as<double>();
+                l_limits.m_passwords = RateLimit(perMinute / 60, perMinute);
+            }
+            return l_limits;
+        };
+        setConnectionLimits(limitsOf("limit-", m_connectionLimits));
+        setAddressLimits(limitsOf("ip-limit-", m_addressLimiter.getLimits()));
     }
     catch(std::exception& ex){
        onArgumentsError(ex.what());
@@ -223,34 +1090,31 @@ bool Server::processArguments(int& argc, char **&argv)
 
 bool Server::promote(const std::string& l_ip, const ClientType& l_type)
 {
-    std::lock_guard<std::mutex> lk(m_mutex);
-    for(auto& itr : m_clients){
-        if(sf::IpAddress(itr->m_ip) != l_ip && itr->m_client.m_name != l_ip){
-            continue;
-        }
-
-        if(!promoteClient(itr, l_type)){
-            onErrorWithSendingData(itr);
-        }
-        return true;
+    std::unique_lock<std::mutex> lk;
+    auto client = lockClient(findClient(l_ip), lk);
+    if(!client){
+        return false;
     }
-    return false;
+    promoteClient(*client, l_type);
+    return true;
 }
 
 bool Server::promoteClient(std::unique_ptr<ClientServerData> &l_data, const ClientType &l_type)
 {
-    sf::Packet packet;
-    packet << Type::Promotion << l_type;
-    if(sendMessageTo(l_data, packet)){
+    if(sendFrameTo(l_data, encode(toClient::Promotion{l_type}))){
         bool promoted = false;
         if(l_data->m_client.m_type < l_type){
             promoted = true;
         }
+        if(l_data->m_state == HandshakeState::Connected && !l_data->m_removed){
+            countClientOfType(l_data->m_client.m_type, -1);
+            countClientOfType(l_type, 1);
+        }
         l_data->m_client.m_type = l_type;
+        m_registry.setType(l_data->m_handle, l_type);
+        journalEvent(JournalKind::Promotion, l_data, static_cast<sf::Uint8>(l_type));
         onClientPromoted(l_data, promoted);
-        packet.clear();
-        packet << Type::SomebodyPromotion << l_type << l_data->m_client.m_name << promoted;
-        sendMessageToAllClients(packet, &l_data);
+        sendFrameToAllClients(encode(toClient::SomebodyPromotion{l_type, l_data->m_client.m_name, promoted}), &l_data);
         return true;
     }
     return false;
@@ -258,66 +1122,280 @@ bool Server::promoteClient(std::unique_ptr<ClientServerData> &l_data, const Clie
 
 bool Server::kick(const std::string &l_ip, const bool& l_block)
 {
-    std::lock_guard<std::mutex> lk(m_mutex);
+    bool byIp = false;
+    ClientHandle handle = findClient(l_ip, &byIp);
+    std::unique_lock<std::mutex> lk;
+    auto client = lockClient(handle, lk);
+    if(!client){
+        return false;
+    }
+    bool blocking = byIp && l_block;
+    std::string ip = (*client)->m_ip;
+    journalEvent(JournalKind::Kick, *client, blocking);
+    sendFrameTo(*client, encode(toClient::Kick{}));
+    dropClient(*client, Type::Kick);
+    // saving the blocklist touches the disk, the shard is not kept waiting for it
+    lk.unlock();
+    if(blocking){
+        block(ip);
+    }
+    return true;
+}
 
-    auto itr = std::begin(m_clients);
-    while(itr != std::end(m_clients)){
-        if(!(*itr)->m_connected){
-            ++itr;
-            continue;
+ClientHandle Server::findClient(const std::string &l_nameOrIp, bool *l_byIp)
+{
+    ClientHandle handle = m_registry.findByIp(l_nameOrIp);
+    if(!handle.isValid()){
+        handle = m_registry.findByName(l_nameOrIp);
+        if(handle.isValid()){
+            if(l_byIp) *l_byIp = false;
+            return handle;
         }
-        if((*itr)->m_ip == l_ip){
-            if(l_block) m_blocked.emplace(l_ip);
-        } else if((*itr)->m_client.m_name != l_ip){
-            ++itr;
-            continue;
+        // host names such as "localhost" are resolved once per lookup
+        sf::IpAddress address(l_nameOrIp);
+        if(address == sf::IpAddress::None){
+            return handle;
         }
+        handle = m_registry.findByIp(address.toString());
+    }
+    if(l_byIp) *l_byIp = handle.isValid();
+    return handle;
+}
 
-        sf::Packet packet;
-        packet << Type::Kick;
-        std::string name = (*itr)->m_client.m_name;
-        sendMessageTo(*itr, packet);
-        sendConnectionNotification(name, Type::Kick, &*itr);
-        m_selector.remove((*itr)->m_client.m_socket);
-        m_clients.erase(itr);
-        ++itr;
-        return true;
+std::unique_ptr<ClientServerData> *Server::lockClient(const ClientHandle &l_handle, std::unique_lock<std::mutex> &l_lock)
+{
+    Shard* shard = m_registry.getShard(l_handle);
+    if(!shard){
+        return nullptr;
     }
-    return false;
+    l_lock = std::unique_lock<std::mutex>(shard->m_mutex);
+    // removal happens under the shard lock, so the handle is checked again once it is held.
+    // Peers still logging in are not there yet for the console, a Promotion would break their login
+    ClientServerData* client = m_registry.get(l_handle);
+    if(!client || client->m_removed || !client->m_connected){
+        return nullptr;
+    }
+    return &shard->m_clients[client->m_index];
 }
 
 void Server::onClientPacketReceived(std::unique_ptr<ClientServerData> &l_client, sf::Packet &l_packet)
 {
+    // views into l_packet, valid until this function returns
+    PacketReader reader(l_packet);
+    if(isCompactPayload(l_packet)){
+        Opcode opcode;
+        reader >> opcode;
+        switch(opcode)
+        {
+        case Opcode::Message:{
+            std::string_view text;
+            if(reader.text(text)){
+                relayMessage(l_client, text);
+            }
+            break;
+            }
+        case Opcode::Member:{
+            sf::Uint32 slot = 0;
+            if(reader.varint(slot)){
+                sendMember(l_client, slot);
+            }
+            break;
+            }
+        default:
+            break;
+        }
+        return;
+    }
     Type type;
-    l_packet >> type;
+    reader >> type;
     switch(type)
     {
     case Type::Message:{
-        std::string text;
-        l_packet >> text;
-        onClientMessageReceived(l_client, text);
-        sendMessageToAllClientsFrom(l_client, text);
+        toServer::Message message;
+        if(decode(reader, message)){
+            relayMessage(l_client, message.text);
+        }
         break;
         }
-    case Type::Password:{
-        std::string text;
-        l_packet >> text;
-        if(text == m_password){
-            std::thread(&Server::prepareNewClient, this, std::ref(l_client)).detach();
-        } else{
-            sf::Packet packet;
-            packet << Type::ServerPasswordNeeded;
-            sendMessageTo(l_client, packet);
+    case Type::JoinChannel:{
+        toServer::JoinChannel message;
+        if(decode(reader, message)){
+            joinChannel(l_client, message.channel);
+        }
+        break;
+        }
+    case Type::LeaveChannel:{
+        toServer::LeaveChannel message;
+        if(decode(reader, message)){
+            leaveChannel(l_client, message.channel);
         }
         break;
         }
+    case Type::ChannelMessage:{
+        toServer::ChannelMessage message;
+        if(decode(reader, message)){
+            relayChannelMessage(l_client, message.channel, message.text);
+        }
+        break;
+        }
+    case Type::DirectMessage:{
+        toServer::DirectMessage message;
+        if(decode(reader, message)){
+            relayDirectMessage(l_client, message.recipient, message.text);
+        }
+        break;
+        }
+    default:
+        break;
     }
 }
 
+void Server::relayMessage(std::unique_ptr<ClientServerData> &l_client, std::string_view l_text)
+{
+    std::uint64_t traced = m_tracer.currentPacket();
+    m_tracer.record(TracePoint::Decode, traced);
+    m_tracer.record(TracePoint::HandlerEnter, traced);
+    onClientMessageReceived(l_client, l_text);
+    m_tracer.record(TracePoint::HandlerExit, traced);
+    sendMessageToAllClientsFrom(l_client, l_text);
+}
+
+void Server::joinChannel(std::unique_ptr<ClientServerData> &l_client, std::string_view l_channel)
+{
+    auto& joined = l_client->m_channels;
+    if(l_channel.empty() || l_channel.size() > 32){
+        sendMessageTo(l_client, "Channel names have 1 to 32 characters");
+        return;
+    }
+    std::string channel(l_channel);
+    if(std::find(joined.begin(), joined.end(), channel) == joined.end()){
+        if(joined.size() >= 16){
+            sendMessageTo(l_client, "You cannot be in more than 16 channels");
+            return;
+        }
+        joined.push_back(channel);
+        l_client->m_shard->m_channels[channel].push_back(l_client.get());
+        m_channelDirectory.join(channel, l_client->m_shard->m_id);
+    }
+    sendFrameTo(l_client, encode(toClient::JoinChannel{channel, static_cast<sf::Uint32>(m_channelDirectory.getMembers(channel))}));
+}
+
+void Server::leaveChannel(std::unique_ptr<ClientServerData> &l_client, std::string_view l_channel)
+{
+    auto& joined = l_client->m_channels;
+    auto itr = std::find(joined.begin(), joined.end(), l_channel);
+    if(itr == joined.end()){
+        return;
+    }
+    std::string channel = std::move(*itr);
+    joined.erase(itr);
+    unindexChannel(*l_client->m_shard, channel, l_client.get());
+    m_channelDirectory.leave(channel, l_client->m_shard->m_id);
+    sendFrameTo(l_client, encode(toClient::LeaveChannel{channel}));
+}
+
+void Server::unindexChannel(Shard &l_shard, const std::string &l_channel, ClientServerData *l_client)
+{
+    auto itr = l_shard.m_channels.find(l_channel);
+    if(itr == l_shard.m_channels.end()){
+        return;
+    }
+    auto& members = itr->second;
+    auto member = std::find(members.begin(), members.end(), l_client);
+    if(member != members.end()){
+        *member = members.back();
+        members.pop_back();
+    }
+    if(members.empty()){
+        l_shard.m_channels.erase(itr);
+    }
+}
+
+void Server::relayChannelMessage(std::unique_ptr<ClientServerData> &l_client, std::string_view l_channel, std::string_view l_text)
+{
+    m_tracer.record(TracePoint::Decode, m_tracer.currentPacket());
+    auto& joined = l_client->m_channels;
+    auto itr = std::find(joined.begin(), joined.end(), l_channel);
+    if(itr == joined.end()){
+        sendMessageTo(l_client, "You are not in channel " + std::string(l_channel));
+        return;
+    }
+    // channels have no compact encoding, v2 clients read the v1 frame as well
+    sendFrameToChannel(*itr, encode(toClient::ChannelMessage{l_channel, l_client->m_client.m_type, l_client->m_client.m_name, l_text}), &l_client);
+}
+
+bool Server::sendFrameToChannel(const std::string &l_channel, const Frame &l_frame, std::unique_ptr<ClientServerData> *l_except)
+{
+    // like sendFrameToAllClients, but only shards with members of the channel are involved
+    Shard* local = l_except ? (*l_except)->m_shard : nullptr;
+    for(auto id : m_channelDirectory.getShards(l_channel)){
+        auto& shard = m_shards[id];
+        if(shard.get() == local){
+            sendToChannelShard(*shard, l_channel, l_frame, l_except);
+            continue;
+        }
+        ShardTask task;
+        task.m_frame = l_frame;
+        task.m_channel = l_channel;
+        task.m_traced = m_tracer.currentPacket();
+        shard->m_tasks.push(std::move(task));
+        shard->m_reactor->wakeUp();
+    }
+    return true;
+}
+
+void Server::sendToChannelShard(Shard &l_shard, const std::string &l_channel, const Frame &l_frame, std::unique_ptr<ClientServerData> *l_except)
+{
+    auto itr = l_shard.m_channels.find(l_channel);
+    if(itr == l_shard.m_channels.end()){
+        return;
+    }
+    // a failed send only schedules the removal, members are unindexed in processRemovals()
+    for(auto client : itr->second){
+        if(client->m_removed || (l_except && client == l_except->get())){
+            continue;
+        }
+        sendFrameTo(l_shard.m_clients[client->m_index], l_frame);
+    }
+}
+
+void Server::relayDirectMessage(std::unique_ptr<ClientServerData> &l_client, std::string_view l_recipient, std::string_view l_text)
+{
+    m_tracer.record(TracePoint::Decode, m_tracer.currentPacket());
+    ClientHandle target = m_registry.findByName(std::string(l_recipient));
+    Shard* shard = m_registry.getShard(target);
+    if(!shard){
+        sendFrameTo(l_client, encode(toClient::UnknownRecipient{l_recipient}));
+        return;
+    }
+    ShardTask task;
+    task.m_frame = encode(toClient::DirectMessage{l_client->m_client.m_type, l_client->m_client.m_name, l_text});
+    task.m_target = target;
+    task.m_traced = m_tracer.currentPacket();
+    // only the lock of the sender's shard is held, any other shard is reached through its queue
+    if(shard == l_client->m_shard){
+        sendToTarget(*shard, task);
+        return;
+    }
+    shard->m_tasks.push(std::move(task));
+    shard->m_reactor->wakeUp();
+}
+
+void Server::sendToTarget(Shard &l_shard, const ShardTask &l_task)
+{
+    // the handle went stale when the recipient left in the meantime
+    ClientServerData* client = m_registry.get(l_task.m_target);
+    if(!client || client->m_removed || !client->m_connected){
+        return;
+    }
+    sendFrameTo(l_shard.m_clients[client->m_index], l_task.m_frame);
+}
+
 void Server::quit()
 {
-    sf::Packet packet;
-    packet << Type::ServerExit;
-    sendMessageToAllClients(packet);
+    sendFrameToAllClients(encode(toClient::ServerExit{}));
     m_running = false;
+    for(auto& shard : m_shards){
+        shard->m_reactor->wakeUp();
+    }
 }
@@ -0,0 +1,85 @@
+#include "socketoptions.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+#include "../../Shared/shared.h"
+
+bool setNoDelay(sf::TcpSocket &l_socket, const bool &l_noDelay)
+{
+#ifdef _WIN32
+    BOOL value = l_noDelay ? TRUE : FALSE;
+    return setsockopt(SocketHandleAccess::get(l_socket), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+#else
+    int value = l_noDelay ? 1 : 0;
+    return setsockopt(SocketHandleAccess::get(l_socket), IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) == 0;
+#endif
+}
+
+bool setCork(sf::TcpSocket &l_socket, const bool &l_cork)
+{
+#ifdef TCP_CORK
+    int value = l_cork ? 1 : 0;
+    return setsockopt(SocketHandleAccess::get(l_socket), IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) == 0;
+#else
+    (void)l_socket;
+    (void)l_cork;
+    return false;
+#endif
+}
+
+bool acceptPeer(sf::TcpListener &l_listener, sf::SocketHandle &l_handle, PeerAddress &l_address)
+{
+    sockaddr_storage peer;
+    socklen_t length = sizeof(peer);
+    l_handle = ::accept(SocketHandleAccess::get(l_listener), reinterpret_cast<sockaddr*>(&peer), &length);
+#ifdef _WIN32
+    if(l_handle == INVALID_SOCKET){
+        return false;
+    }
+#else
+    if(l_handle < 0){
+        return false;
+    }
+#endif
+    l_address = PeerAddress();
+    if(peer.ss_family == AF_INET){
+        auto in = reinterpret_cast<const sockaddr_in*>(&peer);
+        std::memcpy(l_address.m_bytes, &in->sin_addr, 4);
+        l_address.m_length = 4;
+    } else if(peer.ss_family == AF_INET6){
+        auto in6 = reinterpret_cast<const sockaddr_in6*>(&peer);
+        std::memcpy(l_address.m_bytes, &in6->sin6_addr, 16);
+        l_address.m_length = 16;
+        if(IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr)){
+            std::memmove(l_address.m_bytes, l_address.m_bytes + 12, 4);
+            std::memset(l_address.m_bytes + 4, 0, 12);
+            l_address.m_length = 4;
+        }
+    }
+    return true;
+}
+
+void adoptPeer(sf::TcpSocket &l_socket, const sf::SocketHandle &l_handle)
+{
+    SocketHandleAccess::adopt(l_socket, l_handle);
+}
+
+void rejectPeer(const sf::SocketHandle &l_handle, const char *l_data, const size_t &l_size)
+{
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(l_handle, FIONBIO, &nonBlocking);
+    ::send(l_handle, l_data, static_cast<int>(l_size), 0);
+    closesocket(l_handle);
+#else
+    ::send(l_handle, l_data, l_size, MSG_DONTWAIT | MSG_NOSIGNAL);
+    ::close(l_handle);
+#endif
+}
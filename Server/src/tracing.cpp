@@ -0,0 +1,172 @@
+#include "tracing.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+    std::atomic<std::uint64_t> nextTracer(1);
+
+    // the ring of the tracer this thread recorded into last, tracers are told apart by id not address
+    struct ThreadTrace{
+        std::uint64_t m_tracer = 0;
+        void* m_ring = nullptr;
+        std::uint64_t m_current = 0;
+    };
+    thread_local ThreadTrace threadTrace;
+
+    const char* pointName(const TracePoint& l_point)
+    {
+        switch(l_point)
+        {
+        case TracePoint::Receive:      return "receive";
+        case TracePoint::Decode:       return "decode";
+        case TracePoint::HandlerEnter:
+        case TracePoint::HandlerExit:  return "handler";
+        case TracePoint::Enqueue:      return "enqueue";
+        case TracePoint::Flush:        return "flush";
+        }
+        return "";
+    }
+
+    void writeTime(std::ostringstream& l_out, const std::uint64_t& l_nanoseconds)
+    {
+        l_out << l_nanoseconds / 1000 << '.' << static_cast<char>('0' + l_nanoseconds / 100 % 10)
+              << static_cast<char>('0' + l_nanoseconds / 10 % 10) << static_cast<char>('0' + l_nanoseconds % 10);
+    }
+}
+
+Tracer::Tracer() :
+    m_enabled(false),
+    m_capacity(0),
+    m_id(nextTracer++),
+    m_nextPacket(1),
+    m_epoch(std::chrono::steady_clock::now())
+{
+
+}
+
+void Tracer::setCapacity(const size_t &l_events)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_enabled = false;
+    m_capacity = l_events;
+    for(auto& ring : m_rings){
+        std::lock_guard<std::mutex> ringLock(ring->m_mutex);
+        ring->m_events.assign(l_events, TraceEvent());
+        ring->m_next = 0;
+        ring->m_wrapped = false;
+    }
+    m_enabled = l_events > 0;
+}
+
+std::uint64_t Tracer::current()
+{
+    return threadTrace.m_current;
+}
+
+void Tracer::setCurrent(const std::uint64_t &l_packet)
+{
+    threadTrace.m_current = l_packet;
+}
+
+std::uint64_t Tracer::beginPacket()
+{
+    std::uint64_t packet = m_nextPacket.fetch_add(1, std::memory_order_relaxed);
+    append(TracePoint::Receive, packet);
+    threadTrace.m_current = packet;
+    return packet;
+}
+
+void Tracer::append(const TracePoint &l_point, const std::uint64_t &l_packet)
+{
+    auto time = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count());
+    Ring& target = ring();
+    std::lock_guard<std::mutex> lk(target.m_mutex);
+    if(target.m_events.empty()){
+        return;
+    }
+    target.m_events[target.m_next] = TraceEvent{time, l_packet, l_point};
+    if(++target.m_next == target.m_events.size()){
+        target.m_next = 0;
+        target.m_wrapped = true;
+    }
+}
+
+Tracer::Ring &Tracer::ring()
+{
+    if(threadTrace.m_tracer == m_id){
+        return *static_cast<Ring*>(threadTrace.m_ring);
+    }
+    std::lock_guard<std::mutex> lk(m_mutex);
+    Ring*& found = m_byThread[std::this_thread::get_id()];
+    if(!found){
+        m_rings.push_back(std::make_unique<Ring>());
+        found = m_rings.back().get();
+        found->m_events.assign(m_capacity, TraceEvent());
+        found->m_thread = m_rings.size();
+    }
+    threadTrace.m_tracer = m_id;
+    threadTrace.m_ring = found;
+    return *found;
+}
+
+std::string Tracer::toJson()
+{
+    struct Span{ std::uint64_t m_first; std::uint64_t m_last; };
+    std::unordered_map<std::uint64_t, Span> packets;
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&out, &first](){
+        out << (first ? "" : ",\n");
+        first = false;
+    };
+
+    std::lock_guard<std::mutex> lk(m_mutex);
+    for(auto& ring : m_rings){
+        std::vector<TraceEvent> events;
+        {
+            std::lock_guard<std::mutex> ringLock(ring->m_mutex);
+            if(ring->m_wrapped){
+                events.assign(ring->m_events.begin() + ring->m_next, ring->m_events.end());
+            }
+            events.insert(events.end(), ring->m_events.begin(), ring->m_events.begin() + ring->m_next);
+        }
+        separate();
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << ring->m_thread
+            << ",\"args\":{\"name\":\"thread " << ring->m_thread << "\"}}";
+        for(auto& event : events){
+            auto span = packets.emplace(event.m_packet, Span{event.m_time, event.m_time});
+            span.first->second.m_first = std::min(span.first->second.m_first, event.m_time);
+            span.first->second.m_last = std::max(span.first->second.m_last, event.m_time);
+
+            separate();
+            const char* phase = event.m_point == TracePoint::HandlerEnter ? "B" : event.m_point == TracePoint::HandlerExit ? "E" : "i";
+            out << "{\"ph\":\"" << phase << "\",\"name\":\"" << pointName(event.m_point) << "\",\"pid\":1,\"tid\":" << ring->m_thread << ",\"ts\":";
+            writeTime(out, event.m_time);
+            if(*phase == 'i'){
+                out << ",\"s\":\"t\"";
+            }
+            out << ",\"args\":{\"packet\":" << event.m_packet << "}}";
+        }
+    }
+    // one async slice per packet from its first to its last event, whichever threads saw it
+    for(auto& packet : packets){
+        separate();
+        out << "{\"ph\":\"b\",\"cat\":\"packet\",\"name\":\"packet\",\"id\":" << packet.first << ",\"pid\":1,\"tid\":0,\"ts\":";
+        writeTime(out, packet.second.m_first);
+        out << "},\n{\"ph\":\"e\",\"cat\":\"packet\",\"name\":\"packet\",\"id\":" << packet.first << ",\"pid\":1,\"tid\":0,\"ts\":";
+        writeTime(out, packet.second.m_last);
+        out << '}';
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+bool Tracer::dump(const std::string &l_path)
+{
+    std::ofstream file(l_path, std::ios::trunc);
+    return static_cast<bool>(file << toJson());
+}
@@ -561,7 +561,7 @@ namespace cxxopts
           throw argument_incorrect_type(text);
         }
 
-        if (static_cast<int>(umax - digit) < static_cast<int>(result * base))
+        if (result > (umax - digit) / base)
         {
           throw argument_incorrect_type(text);
         }
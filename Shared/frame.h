@@ -0,0 +1,122 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <SFML/Network.hpp>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "protocol.h"
+
+/// Wire image of a packet: 32-bit big-endian size followed by the payload, the same bytes
+/// sf::TcpSocket::send(sf::Packet&) writes. Built once and shared read-only between recipients.
+using Frame = std::shared_ptr<const std::vector<char>>;
+
+inline Frame makeFrame(const sf::Packet& l_packet)
+{
+    auto size = static_cast<sf::Uint32>(l_packet.getDataSize());
+    auto bytes = std::make_shared<std::vector<char>>(sizeof(size) + size);
+    (*bytes)[0] = static_cast<char>(size >> 24);
+    (*bytes)[1] = static_cast<char>(size >> 16);
+    (*bytes)[2] = static_cast<char>(size >> 8);
+    (*bytes)[3] = static_cast<char>(size);
+    if(size){
+        std::memcpy(bytes->data() + sizeof(size), l_packet.getData(), size);
+    }
+    return bytes;
+}
+
+/// Encodes fields like sf::Packet does, but straight into the wire image, so a field taken
+/// from a PacketReader is copied exactly once on its way to the recipients
+class FrameWriter
+{
+public:
+    FrameWriter() : m_bytes(std::make_shared<std::vector<char>>(sizeof(sf::Uint32))) {}
+
+    FrameWriter& operator<<(const bool& l_value) { return *this << static_cast<sf::Uint8>(l_value ? 1 : 0); }
+    FrameWriter& operator<<(const sf::Uint8& l_value)
+    {
+        m_bytes->push_back(static_cast<char>(l_value));
+        return *this;
+    }
+    FrameWriter& operator<<(const sf::Uint16& l_value)
+    {
+        m_bytes->push_back(static_cast<char>(l_value >> 8));
+        m_bytes->push_back(static_cast<char>(l_value));
+        return *this;
+    }
+    FrameWriter& operator<<(const sf::Uint32& l_value)
+    {
+        m_bytes->push_back(static_cast<char>(l_value >> 24));
+        m_bytes->push_back(static_cast<char>(l_value >> 16));
+        m_bytes->push_back(static_cast<char>(l_value >> 8));
+        m_bytes->push_back(static_cast<char>(l_value));
+        return *this;
+    }
+    FrameWriter& operator<<(const std::string_view& l_value)
+    {
+        *this << static_cast<sf::Uint32>(l_value.size());
+        m_bytes->insert(m_bytes->end(), l_value.begin(), l_value.end());
+        return *this;
+    }
+    FrameWriter& operator<<(const std::string& l_value) { return *this << std::string_view(l_value); }
+    template <class T, class = typename std::enable_if<std::is_enum<T>::value>::type>
+    FrameWriter& operator<<(const T& l_value) { return *this << static_cast<sf::Uint16>(l_value); }
+
+    /// LEB128, the length and id encoding of protocol v2
+    FrameWriter& varint(sf::Uint32 l_value)
+    {
+        while(l_value >= 0x80){
+            m_bytes->push_back(static_cast<char>((l_value & 0x7f) | 0x80));
+            l_value >>= 7;
+        }
+        m_bytes->push_back(static_cast<char>(l_value));
+        return *this;
+    }
+    FrameWriter& text(std::string_view l_value)
+    {
+        varint(static_cast<sf::Uint32>(l_value.size()));
+        m_bytes->insert(m_bytes->end(), l_value.begin(), l_value.end());
+        return *this;
+    }
+    /// v2 opcodes and versions take a single byte, unlike the 16-bit v1 enums
+    FrameWriter& operator<<(const Opcode& l_value) { return *this << static_cast<sf::Uint8>(l_value); }
+    FrameWriter& operator<<(const Protocol& l_value) { return *this << static_cast<sf::Uint8>(l_value); }
+
+    /// reserves room for the fields that follow, avoids regrowing for long texts
+    void reserve(const std::size_t& l_payload) { m_bytes->reserve(sizeof(sf::Uint32) + l_payload); }
+
+    Frame finish()
+    {
+        auto size = static_cast<sf::Uint32>(m_bytes->size() - sizeof(sf::Uint32));
+        (*m_bytes)[0] = static_cast<char>(size >> 24);
+        (*m_bytes)[1] = static_cast<char>(size >> 16);
+        (*m_bytes)[2] = static_cast<char>(size >> 8);
+        (*m_bytes)[3] = static_cast<char>(size);
+        return std::move(m_bytes);
+    }
+private:
+    std::shared_ptr<std::vector<char>> m_bytes;
+};
+
+/// leading 16-bit Type of a v1 payload or the opcode byte of a v2 one, whose next byte already
+/// belongs to its fields. Frames of the same kind may replace each other
+inline sf::Uint16 frameKind(const Frame& l_frame)
+{
+    if(l_frame->size() < 5){
+        return sf::Uint16(-1);
+    }
+    auto first = static_cast<sf::Uint8>((*l_frame)[4]);
+    if(first >= static_cast<sf::Uint8>(Opcode::Welcome)){
+        // v1 Types keep their high byte at 0, so the opcodes cannot collide with them
+        return static_cast<sf::Uint16>(first << 8);
+    }
+    if(l_frame->size() < 6){
+        return sf::Uint16(-1);
+    }
+    return static_cast<sf::Uint16>((first << 8) | static_cast<sf::Uint8>((*l_frame)[5]));
+}
+
+#endif // FRAME_H
@@ -0,0 +1,266 @@
+#ifndef MEMORYTRANSPORT_H
+#define MEMORYTRANSPORT_H
+
+#include "transport.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// One direction of an in-memory connection, written at one end and read at the other.
+/// Holds at most m_capacity bytes, a single packet larger than that still fits into an empty pipe.
+struct MemoryPipe{
+    MemoryPipe(const std::size_t& l_capacity) : m_capacity(l_capacity), m_read(0), m_closed(false), m_writerWaiting(false) {}
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<char> m_bytes;
+    std::size_t m_capacity;
+    // bytes before m_read are consumed, the buffer is compacted once they make up most of it
+    std::size_t m_read;
+    bool m_closed;
+    // a write found the pipe full, the writer hears about the room made by the next read
+    bool m_writerWaiting;
+    Pollable::Notifier m_reader;
+    Pollable::Notifier m_writer;
+
+    std::size_t buffered() const { return m_bytes.size() - m_read; }
+    std::size_t room() const { return m_capacity > buffered() ? m_capacity - buffered() : 0; }
+};
+
+/// End of an in-process pipe pair, reads from one pipe and writes to the other
+class MemoryConnection : public Connection
+{
+public:
+    MemoryConnection(const std::shared_ptr<MemoryPipe>& l_in, const std::shared_ptr<MemoryPipe>& l_out) :
+        m_in(l_in), m_out(l_out), m_blocking(true) {}
+    ~MemoryConnection()
+    {
+        setNotifier(nullptr);
+        disconnect();
+    }
+
+    sf::Socket::Status send(const void* l_data, std::size_t l_size, std::size_t& l_sent)
+    {
+        l_sent = 0;
+        auto data = static_cast<const char*>(l_data);
+        std::unique_lock<std::mutex> lk(m_out->m_mutex);
+        while(l_sent < l_size){
+            if(m_out->m_closed){
+                return sf::Socket::Disconnected;
+            }
+            std::size_t room = std::min(m_out->room(), l_size - l_sent);
+            if(!room){
+                if(!m_blocking){
+                    m_out->m_writerWaiting = true;
+                    return l_sent ? sf::Socket::Partial : sf::Socket::NotReady;
+                }
+                m_out->m_changed.wait(lk);
+                continue;
+            }
+            write(data + l_sent, room);
+            l_sent += room;
+        }
+        return sf::Socket::Done;
+    }
+
+    sf::Socket::Status send(sf::Packet& l_packet)
+    {
+        auto size = static_cast<sf::Uint32>(l_packet.getDataSize());
+        char header[] = {static_cast<char>(size >> 24), static_cast<char>(size >> 16), static_cast<char>(size >> 8), static_cast<char>(size)};
+        std::unique_lock<std::mutex> lk(m_out->m_mutex);
+        while(!m_out->m_closed && m_out->buffered() && m_out->room() < sizeof(header) + size){
+            if(!m_blocking){
+                m_out->m_writerWaiting = true;
+                return sf::Socket::NotReady;
+            }
+            m_out->m_changed.wait(lk);
+        }
+        if(m_out->m_closed){
+            return sf::Socket::Disconnected;
+        }
+        m_out->m_bytes.insert(m_out->m_bytes.end(), header, header + sizeof(header));
+        write(static_cast<const char*>(l_packet.getData()), size);
+        return sf::Socket::Done;
+    }
+
+    sf::Socket::Status receive(sf::Packet& l_packet)
+    {
+        std::unique_lock<std::mutex> lk(m_in->m_mutex);
+        while(true){
+            const char* data = m_in->m_bytes.data() + m_in->m_read;
+            std::size_t buffered = m_in->buffered();
+            if(buffered >= sizeof(sf::Uint32)){
+                std::size_t size = (static_cast<std::size_t>(static_cast<sf::Uint8>(data[0])) << 24) | (static_cast<std::size_t>(static_cast<sf::Uint8>(data[1])) << 16)
+                                 | (static_cast<std::size_t>(static_cast<sf::Uint8>(data[2])) << 8) | static_cast<std::size_t>(static_cast<sf::Uint8>(data[3]));
+                if(buffered >= sizeof(sf::Uint32) + size){
+                    l_packet.clear();
+                    l_packet.append(data + sizeof(sf::Uint32), size);
+                    consume(sizeof(sf::Uint32) + size);
+                    return sf::Socket::Done;
+                }
+            }
+            if(m_in->m_closed){
+                return sf::Socket::Disconnected;
+            }
+            if(!m_blocking){
+                return sf::Socket::NotReady;
+            }
+            m_in->m_changed.wait(lk);
+        }
+    }
+
+    void disconnect()
+    {
+        for(auto& pipe : {m_in, m_out}){
+            std::lock_guard<std::mutex> lk(pipe->m_mutex);
+            if(pipe->m_closed){
+                continue;
+            }
+            pipe->m_closed = true;
+            pipe->m_changed.notify_all();
+            // the other end learns about it from its next read or write
+            if(pipe == m_out && pipe->m_reader){
+                pipe->m_reader(true, false);
+            }
+            if(pipe == m_in && pipe->m_writer){
+                pipe->m_writer(false, true);
+            }
+        }
+    }
+
+    void setBlocking(const bool& l_blocking) { m_blocking = l_blocking; }
+
+    void setNotifier(const Notifier& l_notifier)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_in->m_mutex);
+            m_in->m_reader = l_notifier;
+        }
+        std::lock_guard<std::mutex> lk(m_out->m_mutex);
+        m_out->m_writer = l_notifier;
+    }
+private:
+    std::shared_ptr<MemoryPipe> m_in;
+    std::shared_ptr<MemoryPipe> m_out;
+    std::atomic<bool> m_blocking;
+
+    // both with the lock of their pipe held
+    void write(const char* l_data, const std::size_t& l_size)
+    {
+        m_out->m_bytes.insert(m_out->m_bytes.end(), l_data, l_data + l_size);
+        m_out->m_changed.notify_all();
+        if(m_out->m_reader){
+            m_out->m_reader(true, false);
+        }
+    }
+    void consume(const std::size_t& l_size)
+    {
+        m_in->m_read += l_size;
+        if(m_in->m_read == m_in->m_bytes.size()){
+            m_in->m_bytes.clear();
+            m_in->m_read = 0;
+        } else if(m_in->m_read > m_in->m_bytes.size() / 2){
+            m_in->m_bytes.erase(m_in->m_bytes.begin(), m_in->m_bytes.begin() + static_cast<std::ptrdiff_t>(m_in->m_read));
+            m_in->m_read = 0;
+        }
+        m_in->m_changed.notify_all();
+        if(m_in->m_writerWaiting){
+            m_in->m_writerWaiting = false;
+            if(m_in->m_writer){
+                m_in->m_writer(false, true);
+            }
+        }
+    }
+};
+
+/// Connections waiting to be accepted on one port of a MemoryNetwork
+struct MemoryBacklog{
+    MemoryBacklog() : m_open(true) {}
+
+    std::mutex m_mutex;
+    std::deque<std::unique_ptr<Connection>> m_pending;
+    Pollable::Notifier m_notifier;
+    bool m_open;
+};
+
+/// In-process replacement for the network: a server listens on a port of it, clients connect to
+/// that port and get one end of a pipe pair while the other end waits in the backlog. Nothing
+/// touches the operating system, so thousands of sessions cost only memory.
+/// Every peer appears to come from 127.0.0.1, the ip given to connect() is ignored. A connect to a
+/// port nobody listens on waits up to its timeout for a listener, like a tcp connect retrying its syn.
+class MemoryNetwork : public Transport
+{
+public:
+    MemoryNetwork(const std::size_t& l_pipeCapacity = 64 * 1024) : m_pipeCapacity(l_pipeCapacity) {}
+
+    std::unique_ptr<Connection> connect(const sf::IpAddress&, const sf::Uint16& l_port, const sf::Time& l_timeout)
+    {
+        std::shared_ptr<MemoryBacklog> backlog;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            auto bound = [this, &l_port](){ return m_ports.count(l_port) != 0; };
+            if(!m_listening.wait_for(lk, std::chrono::microseconds(l_timeout.asMicroseconds()), bound)){
+                return nullptr;
+            }
+            backlog = m_ports[l_port];
+        }
+        auto up = std::make_shared<MemoryPipe>(m_pipeCapacity);
+        auto down = std::make_shared<MemoryPipe>(m_pipeCapacity);
+        std::lock_guard<std::mutex> lk(backlog->m_mutex);
+        if(!backlog->m_open){
+            return nullptr;
+        }
+        backlog->m_pending.push_back(std::make_unique<MemoryConnection>(up, down));
+        if(backlog->m_notifier){
+            backlog->m_notifier(true, false);
+        }
+        return std::make_unique<MemoryConnection>(down, up);
+    }
+
+    /// nullptr when somebody already listens on l_port
+    std::shared_ptr<MemoryBacklog> listen(const sf::Uint16& l_port)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        auto& backlog = m_ports[l_port];
+        if(backlog){
+            return nullptr;
+        }
+        backlog = std::make_shared<MemoryBacklog>();
+        m_listening.notify_all();
+        return backlog;
+    }
+
+    /// connections nobody accepted yet are dropped
+    void close(const sf::Uint16& l_port)
+    {
+        std::shared_ptr<MemoryBacklog> backlog;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            auto itr = m_ports.find(l_port);
+            if(itr == m_ports.end()){
+                return;
+            }
+            backlog = itr->second;
+            m_ports.erase(itr);
+        }
+        std::deque<std::unique_ptr<Connection>> pending;
+        {
+            std::lock_guard<std::mutex> lk(backlog->m_mutex);
+            backlog->m_open = false;
+            backlog->m_notifier = nullptr;
+            pending.swap(backlog->m_pending);
+        }
+    }
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_listening;
+    std::unordered_map<sf::Uint16, std::shared_ptr<MemoryBacklog>> m_ports;
+    std::size_t m_pipeCapacity;
+};
+
+#endif // MEMORYTRANSPORT_H
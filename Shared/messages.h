@@ -0,0 +1,129 @@
+#ifndef MESSAGES_H
+#define MESSAGES_H
+
+#include <SFML/Network.hpp>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include "shared.h"
+#include "frame.h"
+#include "packetreader.h"
+
+/// Typed v1 messages generated from schema.h: a struct per layout in toClient and toServer,
+/// encode() building the frame in a single allocation, decode() reading it back through a
+/// PacketReader and MinPayload<T>, the payload size when every text is empty.
+/// Texts decode as views into the packet, valid as long as the packet is.
+
+// entries are only ever appended, the values are on the wire
+static_assert(static_cast<int>(Type::Disconnection) == 7 && static_cast<int>(Type::UnknownRecipient) == 16, "Type values changed");
+
+constexpr std::size_t wireSize(const bool&) { return 1; }
+constexpr std::size_t wireSize(const sf::Uint32&) { return 4; }
+constexpr std::size_t wireSize(const std::string_view& l_value) { return 4 + l_value.size(); }
+template <class T, class = typename std::enable_if<std::is_enum<T>::value>::type>
+constexpr std::size_t wireSize(const T&) { return 2; }
+
+template <class T>
+constexpr std::size_t MinPayload = 0;
+
+#define CHAT_FIELD_MEMBER(T, name) T name;
+#define CHAT_FIELD_MIN_SIZE(T, name) + wireSize(T{})
+#define CHAT_FIELD_SIZE(T, name) + wireSize(l_message.name)
+#define CHAT_FIELD_WRITE(T, name) << l_message.name
+#define CHAT_FIELD_READ(T, name) >> l_message.name
+
+#define CHAT_STRUCT(Name, FIELDS) struct Name{ FIELDS };
+#define CHAT_MIN_PAYLOAD(Direction, Name, FIELDS) \
+    template <> constexpr std::size_t MinPayload<Direction::Name> = wireSize(Type::Name) FIELDS;
+#define CHAT_PAYLOAD_SIZE(Direction, Name, FIELDS) \
+    inline std::size_t payloadSize(const Direction::Name& l_message) { (void)l_message; return wireSize(Type::Name) FIELDS; }
+#define CHAT_ENCODE(Direction, Name, FIELDS) \
+    inline Frame encode(const Direction::Name& l_message) \
+    { \
+        FrameWriter frame; \
+        frame.reserve(payloadSize(l_message)); \
+        frame << Type::Name FIELDS; \
+        return frame.finish(); \
+    }
+#define CHAT_DECODE(Direction, Name, FIELDS) \
+    inline bool decode(PacketReader& l_reader, Direction::Name& l_message) { (void)l_message; return static_cast<bool>(l_reader FIELDS); }
+
+namespace toClient
+{
+    CHAT_TO_CLIENT(CHAT_STRUCT, CHAT_FIELD_MEMBER)
+}
+
+namespace toServer
+{
+    CHAT_TO_SERVER(CHAT_STRUCT, CHAT_FIELD_MEMBER)
+}
+
+#define CHAT_TO_CLIENT_MIN_PAYLOAD(Name, FIELDS) CHAT_MIN_PAYLOAD(toClient, Name, FIELDS)
+#define CHAT_TO_SERVER_MIN_PAYLOAD(Name, FIELDS) CHAT_MIN_PAYLOAD(toServer, Name, FIELDS)
+CHAT_TO_CLIENT(CHAT_TO_CLIENT_MIN_PAYLOAD, CHAT_FIELD_MIN_SIZE)
+CHAT_TO_SERVER(CHAT_TO_SERVER_MIN_PAYLOAD, CHAT_FIELD_MIN_SIZE)
+
+#define CHAT_TO_CLIENT_PAYLOAD_SIZE(Name, FIELDS) CHAT_PAYLOAD_SIZE(toClient, Name, FIELDS)
+#define CHAT_TO_SERVER_PAYLOAD_SIZE(Name, FIELDS) CHAT_PAYLOAD_SIZE(toServer, Name, FIELDS)
+CHAT_TO_CLIENT(CHAT_TO_CLIENT_PAYLOAD_SIZE, CHAT_FIELD_SIZE)
+CHAT_TO_SERVER(CHAT_TO_SERVER_PAYLOAD_SIZE, CHAT_FIELD_SIZE)
+
+#define CHAT_TO_CLIENT_ENCODE(Name, FIELDS) CHAT_ENCODE(toClient, Name, FIELDS)
+#define CHAT_TO_SERVER_ENCODE(Name, FIELDS) CHAT_ENCODE(toServer, Name, FIELDS)
+CHAT_TO_CLIENT(CHAT_TO_CLIENT_ENCODE, CHAT_FIELD_WRITE)
+CHAT_TO_SERVER(CHAT_TO_SERVER_ENCODE, CHAT_FIELD_WRITE)
+
+#define CHAT_TO_CLIENT_DECODE(Name, FIELDS) CHAT_DECODE(toClient, Name, FIELDS)
+#define CHAT_TO_SERVER_DECODE(Name, FIELDS) CHAT_DECODE(toServer, Name, FIELDS)
+CHAT_TO_CLIENT(CHAT_TO_CLIENT_DECODE, CHAT_FIELD_READ)
+CHAT_TO_SERVER(CHAT_TO_SERVER_DECODE, CHAT_FIELD_READ)
+
+#define CHAT_NO_FIELD(T, name)
+#define CHAT_DISPATCH_CASE(Name, FIELDS) \
+    case Type::Name:{ \
+        toClient::Name message; \
+        if(!decode(l_reader, message)) return false; \
+        l_handler.on(message); \
+        return true; \
+    }
+
+/// Reads the Type of a v1 packet sent to a client and hands the decoded message to
+/// l_handler.on(), a jump table instead of a lookup per packet. False for a type the schema
+/// does not send to clients or a packet too short for its fields, l_handler is not called then
+template <class Handler>
+bool dispatchToClient(PacketReader& l_reader, Handler& l_handler)
+{
+    Type type;
+    if(!(l_reader >> type)){
+        return false;
+    }
+    switch(type)
+    {
+    CHAT_TO_CLIENT(CHAT_DISPATCH_CASE, CHAT_NO_FIELD)
+    default:
+        return false;
+    }
+}
+
+#undef CHAT_DISPATCH_CASE
+#undef CHAT_NO_FIELD
+#undef CHAT_TO_CLIENT_DECODE
+#undef CHAT_TO_SERVER_DECODE
+#undef CHAT_TO_CLIENT_ENCODE
+#undef CHAT_TO_SERVER_ENCODE
+#undef CHAT_TO_CLIENT_PAYLOAD_SIZE
+#undef CHAT_TO_SERVER_PAYLOAD_SIZE
+#undef CHAT_TO_CLIENT_MIN_PAYLOAD
+#undef CHAT_TO_SERVER_MIN_PAYLOAD
+#undef CHAT_DECODE
+#undef CHAT_ENCODE
+#undef CHAT_PAYLOAD_SIZE
+#undef CHAT_MIN_PAYLOAD
+#undef CHAT_STRUCT
+#undef CHAT_FIELD_READ
+#undef CHAT_FIELD_WRITE
+#undef CHAT_FIELD_SIZE
+#undef CHAT_FIELD_MIN_SIZE
+#undef CHAT_FIELD_MEMBER
+
+#endif // MESSAGES_H
@@ -0,0 +1,136 @@
+#ifndef PACKETREADER_H
+#define PACKETREADER_H
+
+#include <SFML/Network.hpp>
+#include <string_view>
+#include <type_traits>
+#include "protocol.h"
+
+/// Decodes the fields sf::Packet writes without copying them, strings come out as views into
+/// the packet's buffer and stay valid as long as the packet is neither modified nor destroyed
+class PacketReader
+{
+public:
+    PacketReader(const sf::Packet& l_packet) :
+        m_data(static_cast<const char*>(l_packet.getData())),
+        m_size(l_packet.getDataSize()),
+        m_position(0),
+        m_valid(true) {}
+
+    PacketReader& operator>>(bool& l_value)
+    {
+        sf::Uint8 value = 0;
+        *this >> value;
+        l_value = value != 0;
+        return *this;
+    }
+
+    PacketReader& operator>>(sf::Uint8& l_value)
+    {
+        if(check(1)){
+            l_value = static_cast<sf::Uint8>(m_data[m_position]);
+            m_position += 1;
+        }
+        return *this;
+    }
+
+    PacketReader& operator>>(sf::Uint16& l_value)
+    {
+        if(check(2)){
+            l_value = static_cast<sf::Uint16>((byte(0) << 8) | byte(1));
+            m_position += 2;
+        }
+        return *this;
+    }
+
+    PacketReader& operator>>(sf::Uint32& l_value)
+    {
+        if(check(4)){
+            l_value = (static_cast<sf::Uint32>(byte(0)) << 24) | (static_cast<sf::Uint32>(byte(1)) << 16)
+                    | (static_cast<sf::Uint32>(byte(2)) << 8) | static_cast<sf::Uint32>(byte(3));
+            m_position += 4;
+        }
+        return *this;
+    }
+
+    /// same layout as sf::Packet << std::string: 32-bit length followed by the characters
+    PacketReader& operator>>(std::string_view& l_value)
+    {
+        sf::Uint32 length = 0;
+        *this >> length;
+        if(check(length)){
+            l_value = std::string_view(m_data + m_position, length);
+            m_position += length;
+        }
+        return *this;
+    }
+
+    /// v2 opcodes and versions take a single byte, unlike the 16-bit v1 enums
+    PacketReader& operator>>(Opcode& l_value) { return readByte(l_value); }
+    PacketReader& operator>>(Protocol& l_value) { return readByte(l_value); }
+
+    /// LEB128, the length and id encoding of protocol v2
+    PacketReader& varint(sf::Uint32& l_value)
+    {
+        l_value = 0;
+        for(unsigned shift = 0; shift < 35; shift += 7){
+            sf::Uint8 byte = 0;
+            if(!(*this >> byte)){
+                return *this;
+            }
+            l_value |= static_cast<sf::Uint32>(byte & 0x7f) << shift;
+            if(!(byte & 0x80)){
+                return *this;
+            }
+        }
+        m_valid = false;
+        return *this;
+    }
+
+    /// varint length followed by the characters
+    PacketReader& text(std::string_view& l_value)
+    {
+        sf::Uint32 length = 0;
+        varint(length);
+        if(check(length)){
+            l_value = std::string_view(m_data + m_position, length);
+            m_position += length;
+        }
+        return *this;
+    }
+
+    /// enums travel as 16-bit values, like the operators in shared.h
+    template <class T, class = typename std::enable_if<std::is_enum<T>::value>::type>
+    PacketReader& operator>>(T& l_value)
+    {
+        sf::Uint16 value = 0;
+        *this >> value;
+        l_value = static_cast<T>(value);
+        return *this;
+    }
+
+    explicit operator bool() const { return m_valid; }
+    bool endOfPacket() const { return m_position >= m_size; }
+private:
+    const char* m_data;
+    std::size_t m_size;
+    std::size_t m_position;
+    bool m_valid;
+
+    bool check(const std::size_t& l_size)
+    {
+        m_valid = m_valid && m_position + l_size <= m_size;
+        return m_valid;
+    }
+    template <class T>
+    PacketReader& readByte(T& l_value)
+    {
+        sf::Uint8 value = 0;
+        *this >> value;
+        l_value = static_cast<T>(value);
+        return *this;
+    }
+    sf::Uint32 byte(const std::size_t& l_offset) const { return static_cast<sf::Uint8>(m_data[m_position + l_offset]); }
+};
+
+#endif // PACKETREADER_H
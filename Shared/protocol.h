@@ -0,0 +1,31 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <SFML/Network.hpp>
+
+/// Payload encodings. Every packet still travels in an sf::Packet frame; a v2 payload starts
+/// with a one byte opcode >= 0x80 while a v1 payload starts with the high byte of its 16-bit
+/// Type, so both can be told apart packet by packet and share one connection.
+///
+/// The client asks for v2 with a trailing byte after its name and type. A server that accepts
+/// answers with Opcode::Welcome, an older one ignores the byte and the session stays on v1.
+enum class Protocol : sf::Uint8 { V1 = 1, V2 = 2 };
+
+/// v2 layouts, "id" is the sender id assigned by the server, "text" a varint length + bytes
+/// Welcome:       version(u8) id(varint)
+/// Message:       server -> client: id(varint) text(text), client -> server: text(text)
+/// ServerMessage: text(text)
+/// Notice:        id(varint) kind(u8, Type::Connection/Disconnection/Kick) type(u8) name(text)
+/// Member:        client -> server: id(varint), server -> client: id(varint) type(u8) name(text),
+///                the name is empty when nobody has the id anymore
+///
+/// Ids are bound to names lazily: a client learns everyone logging in after it from Notice and
+/// asks with Member about a sender it does not know, so a login costs the same however many are on.
+enum class Opcode : sf::Uint8 { Welcome = 0x80, Message, ServerMessage, Notice, Member };
+
+inline bool isCompactPayload(const sf::Packet& l_packet)
+{
+    return l_packet.getDataSize() && static_cast<sf::Uint8>(static_cast<const char*>(l_packet.getData())[0]) >= 0x80;
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,43 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+/// The v1 message schema, everything in messages.h and the Type enum are generated from it.
+///
+/// CHAT_TYPES lists every Type in wire order, the values travel as 16-bit numbers so entries are
+/// only ever appended. The two layout lists give the fields following the Type of a packet, in
+/// wire order, as F(c++ type, member): std::string_view is a 32-bit length and the characters,
+/// enums take 16 bits, sf::Uint32 32 bits and bool a byte, all big-endian like sf::Packet.
+#define CHAT_TYPES(X) \
+    X(Message) X(ServerMessage) X(ServerIsFull) X(ServerConnected) X(ServerPasswordNeeded) X(Kick) \
+    X(Connection) X(Disconnection) X(Password) X(Promotion) X(SomebodyPromotion) X(ServerExit) \
+    X(JoinChannel) X(LeaveChannel) X(ChannelMessage) X(DirectMessage) X(UnknownRecipient)
+
+/// server -> client. Connection carries Type::Connection or Type::Disconnection as its kind,
+/// UnknownRecipient the recipient of a DirectMessage that is not connected
+#define CHAT_TO_CLIENT(X, F) \
+    X(Message,              F(ClientType, type) F(std::string_view, name) F(std::string_view, text)) \
+    X(ServerMessage,        F(std::string_view, text)) \
+    X(ServerIsFull,         ) \
+    X(ServerConnected,      ) \
+    X(ServerPasswordNeeded, ) \
+    X(Kick,                 ) \
+    X(Connection,           F(std::string_view, name) F(Type, kind)) \
+    X(Promotion,            F(ClientType, type)) \
+    X(SomebodyPromotion,    F(ClientType, type) F(std::string_view, name) F(bool, promoted)) \
+    X(ServerExit,           ) \
+    X(JoinChannel,          F(std::string_view, channel) F(sf::Uint32, members)) \
+    X(LeaveChannel,         F(std::string_view, channel)) \
+    X(ChannelMessage,       F(std::string_view, channel) F(ClientType, type) F(std::string_view, name) F(std::string_view, text)) \
+    X(DirectMessage,        F(ClientType, type) F(std::string_view, name) F(std::string_view, text)) \
+    X(UnknownRecipient,     F(std::string_view, recipient))
+
+/// client -> server once logged in, plus the password answering ServerPasswordNeeded
+#define CHAT_TO_SERVER(X, F) \
+    X(Message,              F(std::string_view, text)) \
+    X(Password,             F(std::string_view, password)) \
+    X(JoinChannel,          F(std::string_view, channel)) \
+    X(LeaveChannel,         F(std::string_view, channel)) \
+    X(ChannelMessage,       F(std::string_view, channel) F(std::string_view, text)) \
+    X(DirectMessage,        F(std::string_view, recipient) F(std::string_view, text))
+
+#endif // SCHEMA_H
@@ -2,14 +2,19 @@
 #define SHARED_H
 
 #include <SFML/Network.hpp>
+#include <type_traits>
 #include <unordered_map>
+#include "transport.h"
+#include "schema.h"
 
 #ifdef WIN32
 #include <Windows.h>
 #endif
 
-enum class Type { Message, ServerMessage, ServerIsFull, ServerConnected, ServerPasswordNeeded, Kick, Connection, Disconnection, Password, Promotion,
-                  SomebodyPromotion, ServerExit};
+/// field layouts of every Type are in schema.h
+#define CHAT_TYPE_ENUMERATOR(Name) Name,
+enum class Type { CHAT_TYPES(CHAT_TYPE_ENUMERATOR) };
+#undef CHAT_TYPE_ENUMERATOR
 
 enum class ClientType { Normie = 0, Administrator };
 
@@ -17,18 +22,32 @@ enum class Color {Red, Green, Blue, Yellow, White, Default};
 
 struct ClientData{
     ClientData() : m_type(ClientType::Normie) {}
-    sf::TcpSocket m_socket;
+    std::unique_ptr<Connection> m_connection;
     std::string m_name;
     ClientType m_type;
 };
 
-template <class T>
+/// sf::Socket keeps its native handle protected, this exposes it for epoll/poll/setsockopt
+struct SocketHandleAccess : public sf::Socket{
+    static sf::SocketHandle get(const sf::Socket& l_socket)
+    {
+        return (l_socket.*(&SocketHandleAccess::getHandle))();
+    }
+    /// l_socket takes over a connection accepted outside of SFML
+    static void adopt(sf::Socket& l_socket, const sf::SocketHandle& l_handle)
+    {
+        (l_socket.*static_cast<void (sf::Socket::*)(sf::SocketHandle)>(&SocketHandleAccess::create))(l_handle);
+    }
+};
+
+/// enums travel as 16-bit values, anything else has to go through sf::Packet's own operators
+template <class T, class = typename std::enable_if<std::is_enum<T>::value>::type>
 sf::Packet& operator <<(sf::Packet& packet, const T& m)
 {
     return packet << static_cast<sf::Uint16>(m);
 }
 
-template <class T>
+template <class T, class = typename std::enable_if<std::is_enum<T>::value>::type>
 sf::Packet& operator >>(sf::Packet& packet, T& m)
 {
     sf::Uint16 t;
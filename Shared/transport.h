@@ -0,0 +1,75 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <SFML/Network.hpp>
+#include <functional>
+#include <memory>
+
+/// Anything a reactor waits on. A tcp socket is handed to select()/epoll, an in-memory endpoint
+/// has no descriptor and calls its notifier instead whenever it may have become ready
+class Pollable
+{
+public:
+    using Notifier = std::function<void(bool l_readable, bool l_writable)>;
+
+    virtual ~Pollable() {}
+
+    /// nullptr when readiness comes through setNotifier()
+    virtual sf::Socket* getSocket() { return nullptr; }
+    /// l_notifier may be called from any thread, an empty one stops the calls before this returns
+    virtual void setNotifier(const Notifier& l_notifier) {}
+};
+
+/// One end of a stream of sf::Packet frames. Blocking until setBlocking(false), statuses are the
+/// ones sf::TcpSocket reports
+class Connection : public Pollable
+{
+public:
+    virtual sf::Socket::Status send(const void* l_data, std::size_t l_size, std::size_t& l_sent) = 0;
+    /// the whole packet or, when not blocking and there is no room, nothing
+    virtual sf::Socket::Status send(sf::Packet& l_packet) = 0;
+    virtual sf::Socket::Status receive(sf::Packet& l_packet) = 0;
+    virtual void disconnect() = 0;
+    virtual void setBlocking(const bool& l_blocking) = 0;
+
+    /// the tcp socket underneath, for socket options and gathered writes
+    sf::TcpSocket* getSocket() { return nullptr; }
+};
+
+class TcpConnection : public Connection
+{
+public:
+    sf::Socket::Status send(const void* l_data, std::size_t l_size, std::size_t& l_sent) { return m_socket.send(l_data, l_size, l_sent); }
+    sf::Socket::Status send(sf::Packet& l_packet) { return m_socket.send(l_packet); }
+    sf::Socket::Status receive(sf::Packet& l_packet) { return m_socket.receive(l_packet); }
+    void disconnect() { m_socket.disconnect(); }
+    void setBlocking(const bool& l_blocking) { m_socket.setBlocking(l_blocking); }
+    sf::TcpSocket* getSocket() { return &m_socket; }
+private:
+    sf::TcpSocket m_socket;
+};
+
+/// Opens the connection of a client to a server
+class Transport
+{
+public:
+    virtual ~Transport() {}
+
+    /// nullptr when nothing answers at l_ip:l_port within l_timeout
+    virtual std::unique_ptr<Connection> connect(const sf::IpAddress& l_ip, const sf::Uint16& l_port, const sf::Time& l_timeout) = 0;
+};
+
+class TcpTransport : public Transport
+{
+public:
+    std::unique_ptr<Connection> connect(const sf::IpAddress& l_ip, const sf::Uint16& l_port, const sf::Time& l_timeout)
+    {
+        auto connection = std::make_unique<TcpConnection>();
+        if(connection->getSocket()->connect(l_ip, l_port, l_timeout) != sf::Socket::Done){
+            return nullptr;
+        }
+        return connection;
+    }
+};
+
+#endif // TRANSPORT_H
@@ -0,0 +1,44 @@
+#include "benchmark.h"
+#include "blocklist.h"
+#include <random>
+
+namespace
+{
+    PeerAddress randomAddress(std::mt19937& l_random, const size_t& l_length)
+    {
+        PeerAddress address;
+        address.m_length = l_length;
+        for(size_t i = 0; i < l_length; ++i){
+            address.m_bytes[i] = static_cast<sf::Uint8>(l_random());
+        }
+        return address;
+    }
+}
+
+/// Blocklist::matches of the address of an accepted peer against lists of different sizes.
+/// Ranges are random /16 to /32 prefixes, the looked up addresses are random too, so nearly all
+/// of them miss and the walk goes as deep as the trie does.
+void benchBlocklist(Bench& l_bench)
+{
+    for(size_t length : {4, 16}){
+        for(size_t ranges : {16, 1024, 65536}){
+            std::mt19937 random(42);
+            Blocklist blocklist;
+            while(blocklist.size() < ranges){
+                blocklist.insert(randomAddress(random, length), length * 8 - random() % 17);
+            }
+            std::vector<PeerAddress> peers;
+            for(size_t i = 0; i < 4096; ++i){
+                peers.push_back(randomAddress(random, length));
+            }
+            std::string name = std::string("blocklist/") + (length == 4 ? "ipv4/" : "ipv6/") + std::to_string(ranges);
+            l_bench.run(name, 1, [&blocklist, &peers](const std::uint64_t& l_iterations){
+                std::uint64_t matched = 0;
+                for(std::uint64_t i = 0; i < l_iterations; ++i){
+                    matched += blocklist.matches(peers[i % peers.size()]);
+                }
+                return matched;
+            });
+        }
+    }
+}
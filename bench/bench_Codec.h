@@ -0,0 +1,31 @@
+#include "benchmark.h"
+#include "samples.h"
+#include "metrics.h"
+
+/// sf::Packet encoding of every Type and decoding of the result, one packet per operation
+void benchCodec(Bench& l_bench)
+{
+    for(const SamplePacket& sample : samplePackets()){
+        std::string name = packetKindName(static_cast<size_t>(sample.m_type));
+        l_bench.run("codec/encode/" + name, 1, [&sample](const std::uint64_t& l_iterations){
+            std::uint64_t bytes = 0;
+            for(std::uint64_t i = 0; i < l_iterations; ++i){
+                sf::Packet packet;
+                sample.m_encode(packet);
+                bytes += packet.getDataSize();
+            }
+            return bytes;
+        });
+
+        sf::Packet packet;
+        sample.m_encode(packet);
+        l_bench.run("codec/decode/" + name, 1, [&sample, &packet](const std::uint64_t& l_iterations){
+            std::uint64_t sum = 0;
+            for(std::uint64_t i = 0; i < l_iterations; ++i){
+                PacketReader reader(packet);
+                sum += sample.m_decode(reader);
+            }
+            return sum;
+        });
+    }
+}
@@ -0,0 +1,93 @@
+#include "benchmark.h"
+#include "samples.h"
+#include "metrics.h"
+#include "client.h"
+#include "../Shared/frame.h"
+
+/// Client that only counts what reaches its callbacks
+class DispatchClient : public Client
+{
+public:
+    DispatchClient() : m_calls(0) {}
+
+    void dispatch(sf::Packet& l_packet) { unpack(l_packet); }
+    std::uint64_t getCalls() const { return m_calls; }
+
+    void onInitialization() {}
+protected:
+    std::uint64_t m_calls;
+
+    std::string onServerPasswordNeeded() { return ""; }
+    void onSuccessfullyConnected() {}
+    void onErrorWithSendingData() {}
+    void onErrorWithReceivingData() {}
+    void onDisconnected() {}
+    void onServerWrongPassword() {}
+    void onArgumentsError(const char*) {}
+    void onUnableToConnect() {}
+    void onServerIsFull() {}
+    void onBlockedFromServer() {}
+    void onError(const std::string&) { ++m_calls; }
+
+    void onMessageReceived(std::string_view l_message, std::string_view, const ClientType&) { m_calls += l_message.size(); }
+    void onServerMessageReceived(std::string_view l_message) { m_calls += l_message.size(); }
+    void onKick() { ++m_calls; }
+    void onPromotion(const std::string&, const bool&) { ++m_calls; }
+    void onConnectionNotificationReceived(std::string_view l_name, const Type&) { m_calls += l_name.size(); }
+    void onServerExit() { ++m_calls; }
+    void onChannelJoined(std::string_view, const sf::Uint32& l_members) { m_calls += l_members; }
+    void onChannelLeft(std::string_view l_channel) { m_calls += l_channel.size(); }
+    void onChannelMessageReceived(std::string_view, std::string_view l_message, std::string_view, const ClientType&) { m_calls += l_message.size(); }
+    void onDirectMessageReceived(std::string_view l_message, std::string_view, const ClientType&) { m_calls += l_message.size(); }
+    void onUnknownRecipient(std::string_view l_name) { m_calls += l_name.size(); }
+};
+
+/// Client::unpack of every Type the client handles, from the generated switch to the callback,
+/// and of the protocol v2 opcodes the server sends
+void benchDispatch(Bench& l_bench)
+{
+    const Type handled[] = {Type::Message, Type::ServerMessage, Type::Kick, Type::Connection, Type::Promotion, Type::SomebodyPromotion,
+                            Type::ServerExit, Type::JoinChannel, Type::LeaveChannel, Type::ChannelMessage, Type::DirectMessage,
+                            Type::UnknownRecipient};
+    for(const SamplePacket& sample : samplePackets()){
+        if(std::find(std::begin(handled), std::end(handled), sample.m_type) == std::end(handled)){
+            continue;
+        }
+        sf::Packet packet;
+        sample.m_encode(packet);
+        l_bench.run(std::string("dispatch/") + packetKindName(static_cast<size_t>(sample.m_type)), 1, [&packet](const std::uint64_t& l_iterations){
+            DispatchClient client;
+            for(std::uint64_t i = 0; i < l_iterations; ++i){
+                client.dispatch(packet);
+            }
+            return client.getCalls();
+        });
+    }
+
+    std::vector<std::pair<Opcode, Frame>> compact;
+    FrameWriter message;
+    message << Opcode::Message;
+    message.varint(7).text(samples::Text);
+    compact.emplace_back(Opcode::Message, message.finish());
+    FrameWriter serverMessage;
+    serverMessage << Opcode::ServerMessage;
+    serverMessage.text(samples::Text);
+    compact.emplace_back(Opcode::ServerMessage, serverMessage.finish());
+    FrameWriter notice;
+    notice << Opcode::Notice;
+    notice.varint(7) << static_cast<sf::Uint8>(Type::Connection) << static_cast<sf::Uint8>(ClientType::Normie);
+    notice.text(samples::Name);
+    compact.emplace_back(Opcode::Notice, notice.finish());
+    for(auto& itr : compact){
+        // the frame without its length prefix is the payload sf::Packet hands over
+        sf::Packet packet;
+        packet.append(itr.second->data() + sizeof(sf::Uint32), itr.second->size() - sizeof(sf::Uint32));
+        l_bench.run(std::string("dispatch/") + packetKindName(packetKind(itr.first)), 1, [&packet](const std::uint64_t& l_iterations){
+            DispatchClient client;
+            for(std::uint64_t i = 0; i < l_iterations; ++i){
+                client.dispatch(packet);
+            }
+            return client.getCalls();
+        });
+    }
+}
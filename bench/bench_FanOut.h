@@ -0,0 +1,80 @@
+#include "benchmark.h"
+#include "samples.h"
+#include "server.h"
+
+/// Server whose only shard is filled with logged in clients that have no connection. A coalescing
+/// window nobody waits out keeps every frame in the outbound queues, so a broadcast costs what the
+/// server spends per recipient without the send() calls, which belong to the kernel.
+class FanOutServer : public Server
+{
+public:
+    FanOutServer(const size_t& l_recipients)
+    {
+        setCoalesceWindow(std::chrono::hours(1));
+        Shard& shard = *m_shards.front();
+        // the first client is the sender, the broadcast skips it
+        for(size_t i = 0; i <= l_recipients; ++i){
+            auto client = std::make_unique<ClientServerData>();
+            client->m_client.m_connection = std::make_unique<TcpConnection>();
+            client->m_client.m_name = "client" + std::to_string(i);
+            client->m_state = HandshakeState::Connected;
+            client->m_connected = true;
+            client->m_index = i;
+            client->m_shard = &shard;
+            shard.m_clients.push_back(std::move(client));
+        }
+    }
+
+    void broadcast(sf::Packet& l_packet)
+    {
+        sendMessageToAllClients(l_packet, &m_shards.front()->m_clients.front());
+    }
+
+    /// drops the queued frames, returns how many there were
+    std::uint64_t drain()
+    {
+        std::uint64_t frames = 0;
+        Shard& shard = *m_shards.front();
+        for(auto& client : shard.m_clients){
+            frames += client->m_outbound.size();
+            client->m_outbound.clear();
+            client->m_batched = false;
+        }
+        shard.m_batch.clear();
+        return frames;
+    }
+protected:
+    void onClientBlocked(const std::string&) {}
+    void onClientRejected(std::unique_ptr<ClientServerData>&) {}
+    void onClientConnected(std::unique_ptr<ClientServerData>&) {}
+    void onClientDisconnected(std::unique_ptr<ClientServerData>&) {}
+    void onClientMessageReceived(std::unique_ptr<ClientServerData>&, std::string_view) {}
+    void onClientPromoted(std::unique_ptr<ClientServerData>&, const bool&) {}
+    void onErrorWithReceivingData(std::unique_ptr<ClientServerData>&) {}
+    void onErrorWithSendingData(std::unique_ptr<ClientServerData>&) {}
+    void onClientTooSlow(std::unique_ptr<ClientServerData>&) {}
+    void onHandshakeTimeout(std::unique_ptr<ClientServerData>&) {}
+    void onArgumentsError(const char*) {}
+    void error(const std::string&) {}
+};
+
+/// Server::sendMessageToAllClients of one chat message, the frame is encoded once and queued for
+/// every recipient. Queues are emptied every 128 broadcasts, well below their capacity.
+void benchFanOut(Bench& l_bench)
+{
+    for(size_t recipients : {10, 1000, 10000}){
+        FanOutServer server(recipients);
+        sf::Packet packet;
+        packet << Type::Message << ClientType::Normie << samples::Name << samples::Text;
+        l_bench.run("fanout/" + std::to_string(recipients), recipients, [&server, &packet](const std::uint64_t& l_iterations){
+            std::uint64_t frames = 0;
+            for(std::uint64_t i = 0; i < l_iterations; ++i){
+                server.broadcast(packet);
+                if(i % 128 == 127){
+                    frames += server.drain();
+                }
+            }
+            return frames + server.drain();
+        });
+    }
+}
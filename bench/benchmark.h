@@ -0,0 +1,88 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BenchResult{
+    std::string m_name;
+    /// units of work in one operation, e.g. the recipients of one broadcast
+    size_t m_items;
+    std::uint64_t m_iterations;
+    /// per operation, median and fastest of the samples
+    double m_nanoseconds;
+    double m_fastest;
+};
+
+/// Runs a case with doubling iteration counts until one batch takes at least the minimum time,
+/// then times that many iterations a few more times and keeps the median. A case returns a
+/// checksum of what it computed, so the work cannot be optimized away.
+class Bench
+{
+public:
+    using Body = std::function<std::uint64_t(const std::uint64_t& l_iterations)>;
+
+    Bench() : m_minTime(std::chrono::milliseconds(200)), m_samples(5), m_sink(0) {}
+
+    void setMinTime(const std::chrono::milliseconds& l_time) { m_minTime = l_time; }
+    void setSamples(const size_t& l_samples) { m_samples = std::max<size_t>(l_samples, 1); }
+    /// only cases whose name contains l_filter run
+    void setFilter(const std::string& l_filter) { m_filter = l_filter; }
+
+    void run(const std::string& l_name, const size_t& l_items, const Body& l_body)
+    {
+        if(l_name.find(m_filter) == std::string::npos){
+            return;
+        }
+        std::uint64_t iterations = 1;
+        while(time(l_body, iterations) < m_minTime && iterations < (1ull << 40)){
+            iterations *= 2;
+        }
+        std::vector<double> samples;
+        for(size_t i = 0; i < m_samples; ++i){
+            samples.push_back(std::chrono::duration<double, std::nano>(time(l_body, iterations)).count() / iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+        m_results.push_back(BenchResult{l_name, l_items, iterations, samples[samples.size() / 2], samples.front()});
+        std::cerr << l_name << ": " << samples[samples.size() / 2] << " ns/op" << std::endl;
+    }
+
+    const std::vector<BenchResult>& getResults() const { return m_results; }
+
+    std::string toJson() const
+    {
+        std::ostringstream out;
+        out << "{\"unit\":\"ns\",\"samples\":" << m_samples << ",\"benchmarks\":[";
+        for(size_t i = 0; i < m_results.size(); ++i){
+            const BenchResult& result = m_results[i];
+            out << (i ? "," : "") << "{\"name\":\"" << result.m_name << "\",\"items\":" << result.m_items
+                << ",\"iterations\":" << result.m_iterations << ",\"ns_per_op\":" << result.m_nanoseconds
+                << ",\"ns_per_item\":" << result.m_nanoseconds / std::max<size_t>(result.m_items, 1)
+                << ",\"fastest_ns_per_op\":" << result.m_fastest << ",\"ops_per_second\":" << 1e9 / result.m_nanoseconds << "}";
+        }
+        out << "]}";
+        return out.str();
+    }
+private:
+    std::chrono::nanoseconds m_minTime;
+    size_t m_samples;
+    std::string m_filter;
+    std::vector<BenchResult> m_results;
+    volatile std::uint64_t m_sink;
+
+    std::chrono::nanoseconds time(const Body& l_body, const std::uint64_t& l_iterations)
+    {
+        auto start = std::chrono::steady_clock::now();
+        m_sink = m_sink + l_body(l_iterations);
+        return std::chrono::steady_clock::now() - start;
+    }
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,54 @@
+#include "bench_Codec.h"
+#include "bench_Dispatch.h"
+#include "bench_FanOut.h"
+#include "bench_Blocklist.h"
+#include "../Shared/cxxopts.h"
+
+int main(int argc, char *argv[])
+{
+    Bench bench;
+    std::string output;
+    cxxopts::Options options("bench", "Microbenchmarks, results are written as JSON");
+    options.add_options()
+        ("h,help", "View this message")
+        ("output", "Write the results to this file instead of the standard output", cxxopts::value<std::string>())
+        ("filter", "Run only the benchmarks whose name contains this text", cxxopts::value<std::string>())
+        ("min-time", "Set milliseconds one timed batch takes at least (default is 200)", cxxopts::value<sf::Uint32>())
+        ("samples", "Set number of timed batches, the median is reported (default is 5)", cxxopts::value<size_t>());
+    try{
+        auto result = options.parse(argc, argv);
+        if(result.count("help")){
+            std::cout << options.help();
+            return 0;
+        }
+        if(result.count("output")){
+            output = result["output"].as<std::string>();
+        }
+        if(result.count("filter")){
+            bench.setFilter(result["filter"].as<std::string>());
+        }
+        if(result.count("min-time")){
+            bench.setMinTime(std::chrono::milliseconds(result["min-time"].as<sf::Uint32>()));
+        }
+        if(result.count("samples")){
+            bench.setSamples(result["samples"].as<size_t>());
+        }
+    }
+    catch(std::exception& ex){
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    benchCodec(bench);
+    benchDispatch(bench);
+    benchFanOut(bench);
+    benchBlocklist(bench);
+
+    if(output.empty()){
+        std::cout << bench.toJson() << std::endl;
+        return 0;
+    }
+    std::ofstream file(output);
+    file << bench.toJson() << std::endl;
+    return file ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#ifndef SAMPLES_H
+#define SAMPLES_H
+
+#include <SFML/Network.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../Shared/shared.h"
+#include "../Shared/packetreader.h"
+
+/// Every Type with the fields it carries on the wire, as the server and the client write them
+struct SamplePacket{
+    Type m_type;
+    void (*m_encode)(sf::Packet& l_packet);
+    /// reads the fields back through PacketReader like the receiving side, returns their total size
+    std::uint64_t (*m_decode)(PacketReader& l_reader);
+};
+
+namespace samples
+{
+    const std::string Name = "somebody";
+    const std::string Channel = "general";
+    const std::string Text = "a chat message of a typical length, about sixty characters";
+
+    inline std::uint64_t readType(PacketReader& l_reader)
+    {
+        Type type;
+        l_reader >> type;
+        return static_cast<std::uint64_t>(type);
+    }
+
+    inline std::uint64_t readTexts(PacketReader& l_reader, const size_t& l_count)
+    {
+        std::uint64_t size = 0;
+        for(size_t i = 0; i < l_count; ++i){
+            std::string_view text;
+            l_reader >> text;
+            size += text.size();
+        }
+        return size;
+    }
+}
+
+inline const std::vector<SamplePacket>& samplePackets()
+{
+    using namespace samples;
+    static const std::vector<SamplePacket> packets = {
+        {Type::Message,
+         [](sf::Packet& p){ p << Type::Message << ClientType::Normie << Name << Text; },
+         [](PacketReader& r){ ClientType type; auto t = readType(r); r >> type; return t + readTexts(r, 2); }},
+        {Type::ServerMessage,
+         [](sf::Packet& p){ p << Type::ServerMessage << Text; },
+         [](PacketReader& r){ return readType(r) + readTexts(r, 1); }},
+        {Type::ServerIsFull,
+         [](sf::Packet& p){ p << Type::ServerIsFull; },
+         [](PacketReader& r){ return readType(r); }},
+        {Type::ServerConnected,
+         [](sf::Packet& p){ p << Type::ServerConnected; },
+         [](PacketReader& r){ return readType(r); }},
+        {Type::ServerPasswordNeeded,
+         [](sf::Packet& p){ p << Type::ServerPasswordNeeded; },
+         [](PacketReader& r){ return readType(r); }},
+        {Type::Kick,
+         [](sf::Packet& p){ p << Type::Kick; },
+         [](PacketReader& r){ return readType(r); }},
+        {Type::Connection,
+         [](sf::Packet& p){ p << Type::Connection << Name << Type::Connection; },
+         [](PacketReader& r){ Type kind; auto t = readType(r) + readTexts(r, 1); r >> kind; return t + static_cast<std::uint64_t>(kind); }},
+        {Type::Disconnection,
+         [](sf::Packet& p){ p << Type::Disconnection << Name << Type::Disconnection; },
+         [](PacketReader& r){ Type kind; auto t = readType(r) + readTexts(r, 1); r >> kind; return t + static_cast<std::uint64_t>(kind); }},
+        {Type::Password,
+         [](sf::Packet& p){ p << Type::Password << std::string("password"); },
+         [](PacketReader& r){ return readType(r) + readTexts(r, 1); }},
+        {Type::Promotion,
+         [](sf::Packet& p){ p << Type::Promotion << ClientType::Administrator; },
+         [](PacketReader& r){ ClientType type; auto t = readType(r); r >> type; return t + static_cast<std::uint64_t>(type); }},
+        {Type::SomebodyPromotion,
+         [](sf::Packet& p){ p << Type::SomebodyPromotion << ClientType::Administrator << Name << true; },
+         [](PacketReader& r){ ClientType type; bool promoted = false; auto t = readType(r); r >> type; t += readTexts(r, 1); r >> promoted; return t + promoted; }},
+        {Type::ServerExit,
+         [](sf::Packet& p){ p << Type::ServerExit; },
+         [](PacketReader& r){ return readType(r); }},
+        {Type::JoinChannel,
+         [](sf::Packet& p){ p << Type::JoinChannel << Channel << sf::Uint32(12); },
+         [](PacketReader& r){ sf::Uint32 members = 0; auto t = readType(r) + readTexts(r, 1); r >> members; return t + members; }},
+        {Type::LeaveChannel,
+         [](sf::Packet& p){ p << Type::LeaveChannel << Channel; },
+         [](PacketReader& r){ return readType(r) + readTexts(r, 1); }},
+        {Type::ChannelMessage,
+         [](sf::Packet& p){ p << Type::ChannelMessage << Channel << ClientType::Normie << Name << Text; },
+         [](PacketReader& r){ ClientType type; auto t = readType(r) + readTexts(r, 1); r >> type; return t + readTexts(r, 2); }},
+        {Type::DirectMessage,
+         [](sf::Packet& p){ p << Type::DirectMessage << ClientType::Normie << Name << Text; },
+         [](PacketReader& r){ ClientType type; auto t = readType(r); r >> type; return t + readTexts(r, 2); }},
+        {Type::UnknownRecipient,
+         [](sf::Packet& p){ p << Type::UnknownRecipient << Name; },
+         [](PacketReader& r){ return readType(r) + readTexts(r, 1); }},
+    };
+    return packets;
+}
+
+#endif // SAMPLES_H
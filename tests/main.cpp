@@ -1,4 +1,15 @@
 #include "tst_MockServer.h"
+#include "tst_OutboundQueue.h"
+#include "tst_ClientRegistry.h"
+#include "tst_SlabPool.h"
+#include "tst_PacketReader.h"
+#include "tst_ChatHistory.h"
+#include "tst_Journal.h"
+#include "tst_Blocklist.h"
+#include "tst_Metrics.h"
+#include "tst_Tracing.h"
+#include "tst_MemoryTransport.h"
+#include "tst_Messages.h"
 
 int main(int argc, char *argv[])
 {
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include "blocklist.h"
+#include <string>
+#include <filesystem>
+
+TEST(BlocklistTest, MatchesAddressesInsideBlockedRanges)
+{
+    Blocklist blocklist;
+    EXPECT_TRUE(blocklist.insert("10.1.0.0/16"));
+    EXPECT_TRUE(blocklist.insert("192.168.0.7"));
+    EXPECT_TRUE(blocklist.insert("2001:db8::/32"));
+    EXPECT_FALSE(blocklist.insert("10.1.0.0/16"));
+    EXPECT_FALSE(blocklist.insert("10.1.0.0/33"));
+    EXPECT_FALSE(blocklist.insert("not an address"));
+    EXPECT_EQ(blocklist.size(), 3u);
+
+    EXPECT_TRUE(blocklist.matches("10.1.255.3"));
+    EXPECT_FALSE(blocklist.matches("10.2.0.1"));
+    EXPECT_TRUE(blocklist.matches("192.168.0.7"));
+    EXPECT_FALSE(blocklist.matches("192.168.0.8"));
+    EXPECT_TRUE(blocklist.matches("2001:db8:42::1"));
+    EXPECT_FALSE(blocklist.matches("2001:db9::1"));
+    EXPECT_TRUE(blocklist.matches("::ffff:10.1.2.3"));
+}
+
+TEST(BlocklistTest, ErasesOnlyExactRanges)
+{
+    Blocklist blocklist;
+    blocklist.insert("10.0.0.0/8");
+    blocklist.insert("10.1.2.3");
+    EXPECT_FALSE(blocklist.erase("10.1.0.0/16"));
+    EXPECT_TRUE(blocklist.erase("10.0.0.0/8"));
+    EXPECT_FALSE(blocklist.matches("10.1.2.4"));
+    EXPECT_TRUE(blocklist.matches("10.1.2.3"));
+    EXPECT_TRUE(blocklist.contains("10.1.2.3/32"));
+
+    std::vector<std::string> ranges = blocklist.getRanges();
+    ASSERT_EQ(ranges.size(), 1u);
+    EXPECT_EQ(ranges.front(), "10.1.2.3");
+    blocklist.clear();
+    EXPECT_EQ(blocklist.size(), 0u);
+    EXPECT_FALSE(blocklist.matches("10.1.2.3"));
+}
+
+TEST(BlocklistTest, SavesAndLoadsRanges)
+{
+    std::string path = testing::TempDir() + "blocklist_test.bin";
+    Blocklist blocklist;
+    blocklist.insert("10.1.0.0/16");
+    blocklist.insert("192.168.0.7");
+    blocklist.insert("2001:db8::/32");
+    ASSERT_TRUE(blocklist.save(path));
+
+    Blocklist loaded;
+    loaded.insert("172.16.0.1");
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.getRanges(), blocklist.getRanges());
+    EXPECT_FALSE(loaded.matches("172.16.0.1"));
+
+    // a truncated file leaves the loaded ranges alone
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    EXPECT_FALSE(loaded.load(path));
+    EXPECT_EQ(loaded.size(), 3u);
+    std::filesystem::remove(path);
+}
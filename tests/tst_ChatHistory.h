@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include "history.h"
+#include <string>
+
+class ChatHistoryTest : public testing::Test
+{
+protected:
+    Frame frameOf(const std::string& l_text){
+        sf::Packet packet;
+        packet << Type::ServerMessage << l_text;
+        return makeFrame(packet);
+    }
+};
+
+TEST_F(ChatHistoryTest, EvictsOldestFramesBeyondCapacity)
+{
+    Frame frame = frameOf("0123456789");
+    ChatHistory history(frame->size() * 2);
+    history.record(frameOf("aaaaaaaaaa"));
+    history.record(frameOf("bbbbbbbbbb"));
+    history.record(frame);
+    EXPECT_EQ(history.size(), 2u);
+    EXPECT_EQ(history.bytes(), frame->size() * 2);
+
+    history.record(std::make_shared<std::vector<char>>(frame->size() * 3));
+    EXPECT_EQ(history.size(), 2u);
+    history.setCapacity(0);
+    EXPECT_EQ(history.size(), 0u);
+    std::uint64_t sequence;
+    EXPECT_FALSE(history.replay(sequence));
+}
+
+TEST_F(ChatHistoryTest, ReplayConcatenatesFramesInOrder)
+{
+    ChatHistory history;
+    Frame first = frameOf("first");
+    Frame second = frameOf("second");
+    EXPECT_EQ(history.record(first), 1u);
+    EXPECT_EQ(history.record(second), 2u);
+    std::uint64_t sequence = 0;
+    Frame replay = history.replay(sequence);
+    EXPECT_EQ(sequence, 2u);
+    ASSERT_TRUE(replay);
+    std::vector<char> expected(first->begin(), first->end());
+    expected.insert(expected.end(), second->begin(), second->end());
+    EXPECT_EQ(*replay, expected);
+    EXPECT_EQ(history.replay(sequence), replay);
+
+    history.record(first);
+    EXPECT_NE(history.replay(sequence), replay);
+    EXPECT_EQ(sequence, 3u);
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "server.h"
+
+TEST(ClientRegistryTest, FindingClientsByNameAndIp)
+{
+    ClientRegistry registry;
+    ClientServerData first, second;
+    ClientHandle a = registry.add(&first, nullptr, "127.0.0.1");
+    ClientHandle b = registry.add(&second, nullptr, "10.0.0.2");
+    registry.setName(b, "nelnir", ClientType::Normie);
+
+    EXPECT_EQ(registry.findByIp("127.0.0.1"), a);
+    EXPECT_EQ(registry.findByName("nelnir"), b);
+    EXPECT_FALSE(registry.findByName("marcin").isValid());
+    EXPECT_EQ(registry.get(b), &second);
+    EXPECT_EQ(registry.size(), 2u);
+
+    // a logged in client wins over one still logging in from the same address
+    ClientServerData third;
+    ClientHandle c = registry.add(&third, nullptr, "10.0.0.2");
+    EXPECT_EQ(registry.findByIp("10.0.0.2"), b);
+    registry.remove(b);
+    EXPECT_EQ(registry.findByIp("10.0.0.2"), c);
+}
+
+TEST(ClientRegistryTest, RemovedHandleGoesStale)
+{
+    ClientRegistry registry;
+    ClientServerData first, second;
+    ClientHandle a = registry.add(&first, nullptr, "127.0.0.1");
+    registry.setName(a, "marcin", ClientType::Normie);
+    registry.remove(a);
+
+    EXPECT_EQ(registry.get(a), nullptr);
+    EXPECT_FALSE(registry.findByName("marcin").isValid());
+    EXPECT_FALSE(registry.findByIp("127.0.0.1").isValid());
+
+    // the slot is reused under a new generation
+    ClientHandle b = registry.add(&second, nullptr, "127.0.0.1");
+    EXPECT_EQ(b.m_slot, a.m_slot);
+    EXPECT_NE(b, a);
+    EXPECT_EQ(registry.get(a), nullptr);
+    EXPECT_EQ(registry.get(b), &second);
+}
+
+TEST(ClientRegistryTest, IndexesKeepUpWithGrowingAndRemoving)
+{
+    ClientRegistry registry;
+    std::vector<ClientServerData> clients(300);
+    std::vector<ClientHandle> handles;
+    for(size_t i = 0; i < clients.size(); ++i){
+        handles.push_back(registry.add(&clients[i], nullptr, "10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256)));
+        registry.setName(handles.back(), "client" + std::to_string(i), ClientType::Normie);
+    }
+    for(size_t i = 0; i < clients.size(); i += 2){
+        registry.remove(handles[i]);
+    }
+    for(size_t i = 0; i < clients.size(); ++i){
+        ClientHandle expected = i % 2 ? handles[i] : ClientHandle();
+        EXPECT_EQ(registry.findByName("client" + std::to_string(i)), expected);
+        EXPECT_EQ(registry.findByIp("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256)), expected);
+    }
+    EXPECT_EQ(registry.size(), clients.size() / 2);
+}
+
+TEST(ClientRegistryTest, LookingUpMembersBySlot)
+{
+    ClientRegistry registry;
+    ClientServerData first, second;
+    ClientHandle a = registry.add(&first, nullptr, "127.0.0.1");
+    ClientHandle b = registry.add(&second, nullptr, "10.0.0.2");
+    registry.setName(b, "nelnir", ClientType::Administrator);
+
+    RegistryMember member;
+    EXPECT_FALSE(registry.getMember(a.m_slot, member));
+    ASSERT_TRUE(registry.getMember(b.m_slot, member));
+    EXPECT_EQ(member.m_handle, b);
+    EXPECT_EQ(member.m_name, "nelnir");
+    EXPECT_EQ(member.m_type, ClientType::Administrator);
+
+    registry.remove(b);
+    EXPECT_FALSE(registry.getMember(b.m_slot, member));
+    EXPECT_FALSE(registry.getMember(b.m_slot + 100, member));
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "journal.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class JournalTest : public testing::Test
+{
+    virtual void SetUp(){
+        m_directory = (std::filesystem::temp_directory_path() / "client-server-journal-test").string();
+        std::filesystem::remove_all(m_directory);
+    }
+    virtual void TearDown(){
+        std::filesystem::remove_all(m_directory);
+    }
+protected:
+    std::string m_directory;
+
+    std::vector<std::string> tail(Journal& l_journal, const size_t& l_bytes){
+        std::vector<std::string> payloads;
+        l_journal.replayTail(l_bytes, [&payloads](const JournalRecord& l_record){
+            payloads.emplace_back(l_record.m_payload);
+        });
+        return payloads;
+    }
+};
+
+TEST_F(JournalTest, ReopeningContinuesAfterTheLastRecord)
+{
+    Journal journal;
+    ASSERT_TRUE(journal.open(m_directory));
+    EXPECT_EQ(journal.append(JournalKind::Message, "first"), 1u);
+    EXPECT_EQ(journal.append(JournalKind::Kick, "second"), 2u);
+    journal.sync();
+    journal.close();
+
+    ASSERT_TRUE(journal.open(m_directory));
+    EXPECT_EQ(journal.getLastSequence(), 2u);
+    EXPECT_EQ(tail(journal, -1), std::vector<std::string>({"first", "second"}));
+    EXPECT_EQ(journal.append(JournalKind::Message, "third"), 3u);
+    journal.close();
+
+    ASSERT_TRUE(journal.open(m_directory));
+    EXPECT_EQ(journal.getSegmentCount(), 2u);
+    EXPECT_EQ(tail(journal, -1), std::vector<std::string>({"first", "second", "third"}));
+}
+
+TEST_F(JournalTest, RotatesSegmentsAndKeepsTheNewestTail)
+{
+    Journal journal;
+    journal.setSegmentBytes(64);
+    journal.setRetainedBytes(256);
+    ASSERT_TRUE(journal.open(m_directory));
+    // synced one by one, so every record is its own batch
+    for(int i = 0; i < 40; ++i){
+        journal.append(JournalKind::Message, "message " + std::to_string(i));
+        journal.sync();
+    }
+    journal.close();
+
+    ASSERT_TRUE(journal.open(m_directory));
+    EXPECT_EQ(journal.getLastSequence(), 40u);
+    EXPECT_LE(journal.getSegmentCount(), 6u);
+    // 13 bytes of header and 10 of payload per record
+    EXPECT_EQ(tail(journal, 3 * 23), std::vector<std::string>({"message 37", "message 38", "message 39"}));
+    auto all = tail(journal, -1);
+    ASSERT_FALSE(all.empty());
+    EXPECT_EQ(all.back(), "message 39");
+    EXPECT_LT(all.size(), 40u);
+}
@@ -0,0 +1,307 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "server.h"
+#include "client.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(MemoryTransportTest, ConnectingNeedsAListener)
+{
+    MemoryNetwork network;
+    EXPECT_EQ(network.connect("127.0.0.1", 1000, sf::milliseconds(10)), nullptr);
+    auto backlog = network.listen(1000);
+    ASSERT_NE(backlog, nullptr);
+    EXPECT_EQ(network.listen(1000), nullptr);
+    EXPECT_NE(network.connect("127.0.0.1", 1000, sf::milliseconds(10)), nullptr);
+    EXPECT_EQ(backlog->m_pending.size(), 1u);
+    network.close(1000);
+    EXPECT_TRUE(backlog->m_pending.empty());
+    EXPECT_EQ(network.connect("127.0.0.1", 1000, sf::milliseconds(10)), nullptr);
+}
+
+TEST(MemoryTransportTest, PacketsGoBothWays)
+{
+    MemoryNetwork network;
+    auto backlog = network.listen(1000);
+    auto client = network.connect("127.0.0.1", 1000, sf::Time::Zero);
+    auto server = std::move(backlog->m_pending.front());
+    sf::Packet packet;
+    packet << "siema" << sf::Uint32(7);
+    EXPECT_EQ(client->send(packet), sf::Socket::Done);
+    packet.clear();
+    ASSERT_EQ(server->receive(packet), sf::Socket::Done);
+    std::string text;
+    sf::Uint32 number;
+    packet >> text >> number;
+    EXPECT_EQ(text, "siema");
+    EXPECT_EQ(number, 7u);
+
+    server->setBlocking(false);
+    EXPECT_EQ(server->receive(packet), sf::Socket::NotReady);
+    packet.clear();
+    packet << "back";
+    EXPECT_EQ(server->send(packet), sf::Socket::Done);
+    ASSERT_EQ(client->receive(packet), sf::Socket::Done);
+    packet >> text;
+    EXPECT_EQ(text, "back");
+
+    client->disconnect();
+    EXPECT_EQ(server->receive(packet), sf::Socket::Disconnected);
+    EXPECT_EQ(server->send(packet), sf::Socket::Disconnected);
+}
+
+TEST(MemoryTransportTest, FullPipeWakesTheWriterOnRead)
+{
+    MemoryNetwork network(16);
+    auto backlog = network.listen(1000);
+    auto client = network.connect("127.0.0.1", 1000, sf::Time::Zero);
+    auto server = std::move(backlog->m_pending.front());
+    int readable = 0, writable = 0;
+    client->setNotifier([&readable, &writable](bool l_readable, bool l_writable){ readable += l_readable; writable += l_writable; });
+    client->setBlocking(false);
+
+    sf::Packet packet;
+    packet << "twelve bytes";
+    // a packet larger than the pipe still fits while it is empty
+    EXPECT_EQ(client->send(packet), sf::Socket::Done);
+    EXPECT_EQ(client->send(packet), sf::Socket::NotReady);
+    EXPECT_EQ(writable, 0);
+    ASSERT_EQ(server->receive(packet), sf::Socket::Done);
+    EXPECT_EQ(writable, 1);
+    EXPECT_EQ(client->send(packet), sf::Socket::Done);
+
+    EXPECT_EQ(readable, 0);
+    EXPECT_EQ(server->send(packet), sf::Socket::Done);
+    EXPECT_EQ(readable, 1);
+}
+
+/// Client counting server messages, drained by the test or run() by a thread of its own
+class CountingClient : public Client
+{
+public:
+    CountingClient() : m_serverMessages(0) {}
+
+    void onInitialization() {}
+    /// handles everything already received, false once the connection is gone
+    bool drain()
+    {
+        m_client.m_connection->setBlocking(false);
+        sf::Packet packet;
+        while(true){
+            auto status = m_client.m_connection->receive(packet);
+            if(status == sf::Socket::NotReady){
+                return true;
+            }
+            if(status != sf::Socket::Done){
+                return false;
+            }
+            unpack(packet);
+        }
+    }
+    size_t getServerMessages() const { return m_serverMessages; }
+protected:
+    std::atomic<size_t> m_serverMessages;
+
+    std::string onServerPasswordNeeded() { return ""; }
+    void onSuccessfullyConnected() {}
+    void onErrorWithSendingData() {}
+    void onErrorWithReceivingData() {}
+    void onDisconnected() {}
+    void onServerWrongPassword() {}
+    void onArgumentsError(const char*) {}
+    void onUnableToConnect() {}
+    void onServerIsFull() {}
+    void onBlockedFromServer() {}
+    void onError(const std::string&) {}
+    void onMessageReceived(std::string_view, std::string_view, const ClientType&) {}
+    void onServerMessageReceived(std::string_view) { ++m_serverMessages; }
+    void onKick() {}
+    void onPromotion(const std::string&, const bool&) {}
+    void onConnectionNotificationReceived(std::string_view, const Type&) {}
+    void onServerExit() {}
+    void onChannelJoined(std::string_view, const sf::Uint32&) {}
+    void onChannelLeft(std::string_view) {}
+    void onChannelMessageReceived(std::string_view, std::string_view, std::string_view, const ClientType&) {}
+    void onDirectMessageReceived(std::string_view, std::string_view, const ClientType&) {}
+    void onUnknownRecipient(std::string_view) {}
+};
+
+TEST(MemoryTransportTest, ThousandSessionsGetABroadcast)
+{
+    const size_t sessions = 1000;
+    auto network = std::make_shared<MemoryNetwork>();
+    testing::NiceMock<MockServer> server;
+    server.setPort(1000);
+    server.setListener(std::make_unique<MemoryListener>(network));
+    std::thread thread(&MockServer::run, &server);
+
+    std::vector<std::unique_ptr<CountingClient>> clients;
+    for(size_t i = 0; i < sessions; ++i){
+        clients.push_back(std::make_unique<CountingClient>());
+        clients.back()->setNickname("client" + std::to_string(i));
+        clients.back()->setTransport(network);
+        ASSERT_EQ(clients.back()->connect(1000, "127.0.0.1"), Status::Connected);
+        // everybody hears about every newcomer, keep the pipes from filling up
+        if(i % 64 == 63){
+            for(auto& client : clients){
+                ASSERT_TRUE(client->drain());
+            }
+        }
+    }
+    EXPECT_TRUE(waitFor([&server, &sessions](){ return server.getStats().m_connected == sessions; }));
+
+    server.sendMessageToAllClients("testing");
+    EXPECT_TRUE(waitFor([&clients](){
+        size_t received = 0;
+        for(auto& client : clients){
+            client->drain();
+            received += client->getServerMessages();
+        }
+        return received == clients.size();
+    }));
+
+    server.quit();
+    thread.join();
+}
+
+TEST(MemoryTransportTest, ClientReconnectsAfterServerRestart)
+{
+    auto network = std::make_shared<MemoryNetwork>();
+    auto server = std::make_unique<testing::NiceMock<MockServer>>();
+    server->setPort(1000);
+    server->setListener(std::make_unique<MemoryListener>(network));
+    std::thread thread(&MockServer::run, server.get());
+
+    CountingClient client;
+    client.setNickname("marcin");
+    client.setTransport(network);
+    client.setReconnect(50);
+    client.setReconnectBackoff(1ms, 20ms);
+    ASSERT_EQ(client.connect(1000, "127.0.0.1"), Status::Connected);
+    std::thread running(&CountingClient::run, &client);
+    EXPECT_TRUE(waitFor([&server](){ return server->getStats().m_connected == 1; }));
+
+    // the client hears Type::ServerExit, then the port stays closed until the new server listens
+    server->quit();
+    thread.join();
+    server = std::make_unique<testing::NiceMock<MockServer>>();
+    server->setPort(1000);
+    server->setListener(std::make_unique<MemoryListener>(network));
+    thread = std::thread(&MockServer::run, server.get());
+    EXPECT_TRUE(waitFor([&server](){ return server->getStats().m_connected == 1; }));
+
+    server->sendMessageToAllClients("testing");
+    EXPECT_TRUE(waitFor([&client](){ return client.getServerMessages() == 1; }));
+    client.quit();
+    running.join();
+    server->quit();
+    thread.join();
+}
+
+TEST(MemoryTransportTest, ChangedPasswordEndsReconnecting)
+{
+    auto network = std::make_shared<MemoryNetwork>();
+    auto server = std::make_unique<testing::NiceMock<MockServer>>();
+    server->setPort(1000);
+    server->setPassword("old");
+    server->setListener(std::make_unique<MemoryListener>(network));
+    std::thread thread(&MockServer::run, server.get());
+
+    CountingClient client;
+    client.setNickname("marcin");
+    client.setTransport(network);
+    client.setReconnect(50);
+    client.setReconnectBackoff(1ms, 20ms);
+    ASSERT_EQ(client.connect(1000, "127.0.0.1", "old"), Status::Connected);
+    std::thread running(&CountingClient::run, &client);
+    EXPECT_TRUE(waitFor([&server](){ return server->getStats().m_connected == 1; }));
+
+    server->quit();
+    thread.join();
+    server = std::make_unique<testing::NiceMock<MockServer>>();
+    server->setPort(1000);
+    server->setPassword("new");
+    server->setListener(std::make_unique<MemoryListener>(network));
+    thread = std::thread(&MockServer::run, server.get());
+
+    // the first rejection ends run(), the old password is not tried again
+    running.join();
+    EXPECT_TRUE(waitFor([&server](){ return server->getStats().m_connected == 0; }));
+    EXPECT_EQ(server->getMetrics().m_handshakeFailures, 1u);
+    server->quit();
+    thread.join();
+}
+
+/// takes anything sent to it, every receive fails like on a socket in an error state
+class BrokenConnection : public Connection
+{
+public:
+    sf::Socket::Status send(const void*, std::size_t l_size, std::size_t& l_sent) { l_sent = l_size; return sf::Socket::Done; }
+    sf::Socket::Status send(sf::Packet&) { return sf::Socket::Done; }
+    sf::Socket::Status receive(sf::Packet&) { return sf::Socket::Error; }
+    void disconnect() {}
+    void setBlocking(const bool&) {}
+};
+
+/// hands out a single BrokenConnection
+class BrokenListener : public Listener
+{
+public:
+    BrokenListener() : m_pending(true) {}
+    bool listen(const sf::Uint16&) { return true; }
+    void close() {}
+    bool accept(PeerAddress& l_address)
+    {
+        if(!m_pending){
+            return false;
+        }
+        m_pending = false;
+        sf::Uint8 localhost[] = {127, 0, 0, 1};
+        std::copy(localhost, localhost + 4, l_address.m_bytes);
+        l_address.m_length = 4;
+        return true;
+    }
+    std::unique_ptr<Connection> adopt() { return std::make_unique<BrokenConnection>(); }
+    void reject(const char*, const size_t&) {}
+private:
+    bool m_pending;
+};
+
+TEST(MemoryTransportTest, ReceiveErrorDropsTheConnection)
+{
+    testing::NiceMock<MockServer> server;
+    server.setListener(std::make_unique<BrokenListener>());
+    std::thread thread(&MockServer::run, &server);
+    // the slot taken for the login is given back with the record
+    EXPECT_TRUE(waitFor([&server](){ return server.getMetrics().m_disconnected == 1; }));
+    EXPECT_EQ(server.getMetrics().m_receiveErrors, 1u);
+    EXPECT_EQ(server.getStats().m_connected, 0u);
+    EXPECT_EQ(server.getStats().m_handshaking, 0u);
+    server.quit();
+    thread.join();
+}
+
+TEST(MemoryTransportTest, KickingFromAnotherThread)
+{
+    auto network = std::make_shared<MemoryNetwork>();
+    testing::NiceMock<MockServer> server;
+    server.setPort(1000);
+    server.setListener(std::make_unique<MemoryListener>(network));
+    std::thread thread(&MockServer::run, &server);
+
+    CountingClient client;
+    client.setNickname("marcin");
+    client.setTransport(network);
+    ASSERT_EQ(client.connect(1000, "127.0.0.1"), Status::Connected);
+    EXPECT_TRUE(waitFor([&server](){ return server.getStats().m_normies == 1; }));
+    // the shard is waiting on its reactor meanwhile, it stops watching the connection by itself
+    EXPECT_TRUE(server.kick("marcin"));
+    EXPECT_FALSE(server.kick("marcin"));
+    EXPECT_EQ(server.getStats().m_connected, 0u);
+    EXPECT_TRUE(waitFor([&client](){ return !client.drain(); }));
+    server.quit();
+    thread.join();
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "server.h"
+#include "client.h"
+#include <vector>
+
+static_assert(MinPayload<toClient::Message> == 2 + 2 + 4 + 4, "Message is a type, a client type and two texts");
+static_assert(MinPayload<toClient::Kick> == 2, "Kick is nothing but its type");
+static_assert(MinPayload<toClient::JoinChannel> == 2 + 4 + 4, "JoinChannel is a type, a text and a count");
+
+/// the payload of l_frame, without the length prefix
+static sf::Packet payloadOf(const Frame& l_frame)
+{
+    sf::Packet packet;
+    packet.append(l_frame->data() + sizeof(sf::Uint32), l_frame->size() - sizeof(sf::Uint32));
+    return packet;
+}
+
+TEST(MessagesTest, EncodeMatchesPacketLayout)
+{
+    sf::Packet packet;
+    packet << Type::SomebodyPromotion << ClientType::Administrator << std::string("marcin") << true;
+    Frame frame = encode(toClient::SomebodyPromotion{ClientType::Administrator, "marcin", true});
+    EXPECT_EQ(*frame, *makeFrame(packet));
+    EXPECT_EQ(frame->size(), sizeof(sf::Uint32) + payloadSize(toClient::SomebodyPromotion{ClientType::Administrator, "marcin", true}));
+
+    packet.clear();
+    packet << Type::ServerExit;
+    EXPECT_EQ(*encode(toClient::ServerExit{}), *makeFrame(packet));
+}
+
+TEST(MessagesTest, DecodeReadsWhatEncodeWrote)
+{
+    sf::Packet packet = payloadOf(encode(toServer::ChannelMessage{"general", "siema"}));
+    PacketReader reader(packet);
+    Type type;
+    toServer::ChannelMessage message;
+    ASSERT_TRUE(reader >> type);
+    EXPECT_EQ(type, Type::ChannelMessage);
+    ASSERT_TRUE(decode(reader, message));
+    EXPECT_EQ(message.channel, "general");
+    EXPECT_EQ(message.text, "siema");
+    EXPECT_TRUE(reader.endOfPacket());
+
+    // a packet cut short fails instead of reading garbage
+    sf::Packet truncated;
+    truncated << Type::ChannelMessage << std::string("general");
+    PacketReader shortReader(truncated);
+    ASSERT_TRUE(shortReader >> type);
+    EXPECT_FALSE(decode(shortReader, message));
+}
+
+/// records what dispatchToClient hands over
+struct RecordingHandler
+{
+    std::vector<Type> m_received;
+    std::string m_name;
+
+    void on(const toClient::Message& l_message) { m_received.push_back(Type::Message); m_name = l_message.name; }
+    void on(const toClient::Connection& l_message) { m_received.push_back(l_message.kind); m_name = l_message.name; }
+    template <class T>
+    void on(const T&) { m_received.push_back(Type::Password); }
+};
+
+TEST(MessagesTest, DispatchCallsTheMatchingHandler)
+{
+    RecordingHandler handler;
+    sf::Packet packet = payloadOf(encode(toClient::Connection{"marcin", Type::Disconnection}));
+    PacketReader reader(packet);
+    EXPECT_TRUE(dispatchToClient(reader, handler));
+    packet = payloadOf(encode(toClient::Message{ClientType::Normie, "kasia", "siema"}));
+    PacketReader second(packet);
+    EXPECT_TRUE(dispatchToClient(second, handler));
+    EXPECT_EQ(handler.m_received, std::vector<Type>({Type::Disconnection, Type::Message}));
+    EXPECT_EQ(handler.m_name, "kasia");
+
+    // the server never sends a password, nor a message without its fields
+    packet.clear();
+    packet << Type::Password << std::string("secret");
+    PacketReader unknown(packet);
+    EXPECT_FALSE(dispatchToClient(unknown, handler));
+    packet.clear();
+    packet << Type::Message << ClientType::Normie;
+    PacketReader truncated(packet);
+    EXPECT_FALSE(dispatchToClient(truncated, handler));
+    EXPECT_EQ(handler.m_received.size(), 2u);
+}
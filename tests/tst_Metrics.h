@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include "metrics.h"
+#include "../../Shared/frame.h"
+
+TEST(MetricsTest, SortsPacketsByKind)
+{
+    sf::Packet packet;
+    packet << Type::DirectMessage << std::string("text");
+    Frame frame = makeFrame(packet);
+    EXPECT_STREQ(packetKindName(packetKind(frame->data() + 4, frame->size() - 4)), "DirectMessage");
+
+    char compact[] = {static_cast<char>(Opcode::Notice), 1};
+    EXPECT_STREQ(packetKindName(packetKind(compact, sizeof(compact))), "Notice");
+    char unknown[] = {0x7f, 0x7f};
+    EXPECT_EQ(packetKind(unknown, sizeof(unknown)), PacketKinds - 1);
+    EXPECT_EQ(packetKind(unknown, 0), PacketKinds - 1);
+}
+
+TEST(MetricsTest, HistogramPercentilesFollowBuckets)
+{
+    Histogram histogram;
+    for(int i = 0; i < 98; ++i){
+        histogram.record(3);
+    }
+    histogram.record(100);
+    histogram.record(1000);
+    HistogramSnapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.m_count, 100u);
+    EXPECT_EQ(snapshot.m_sum, 98u * 3 + 1100);
+    EXPECT_EQ(snapshot.percentile(0.5), 4u);
+    EXPECT_EQ(snapshot.percentile(0.99), 128u);
+    EXPECT_EQ(snapshot.percentile(1), 1000u);
+
+    HistogramSnapshot merged;
+    merged.merge(snapshot);
+    merged.merge(snapshot);
+    EXPECT_EQ(merged.m_count, 200u);
+    EXPECT_EQ(merged.m_max, 1000u);
+}
@@ -2,22 +2,40 @@
 #include <gmock/gmock.h>
 #include "server.h"
 #include "client.h"
+#include <atomic>
+#include <functional>
 #include <thread>
 #include <vector>
 using namespace std::chrono_literals;
+using namespace std::string_view_literals;
 using testing::AtLeast;
 
+/// polls l_done until it holds or a generous deadline passes, so a slow machine only costs time
+bool waitFor(const std::function<bool()>& l_done)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(!l_done()){
+        if(std::chrono::steady_clock::now() > deadline){
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
 class MockServer : public Server
 {
 public:
-    MOCK_METHOD1(onClientBlocked, void(std::unique_ptr<ClientServerData>&));
+    MOCK_METHOD1(onClientBlocked, void(const std::string&));
     MOCK_METHOD1(onClientRejected, void(std::unique_ptr<ClientServerData>&));
     MOCK_METHOD1(onClientConnected, void(std::unique_ptr<ClientServerData>&));
     MOCK_METHOD1(onClientDisconnected, void(std::unique_ptr<ClientServerData>&));
-    MOCK_METHOD2(onClientMessageReceived, void(std::unique_ptr<ClientServerData>&, const std::string&));
+    MOCK_METHOD2(onClientMessageReceived, void(std::unique_ptr<ClientServerData>&, std::string_view));
     MOCK_METHOD2(onClientPromoted, void(std::unique_ptr<ClientServerData>&, const bool&));
     MOCK_METHOD1(onErrorWithSendingData, void(std::unique_ptr<ClientServerData>&));
     MOCK_METHOD1(onErrorWithReceivingData, void(std::unique_ptr<ClientServerData>&));
+    MOCK_METHOD1(onClientTooSlow, void(std::unique_ptr<ClientServerData>&));
+    MOCK_METHOD1(onHandshakeTimeout, void(std::unique_ptr<ClientServerData>&));
     MOCK_METHOD1(onArgumentsError, void(const char*));
     MOCK_METHOD1(error, void(const std::string&));
 };
@@ -38,110 +56,195 @@ public:
     MOCK_METHOD1(onError, void(const std::string&));
     MOCK_METHOD0(onServerPasswordNeeded, std::string());
 
-    MOCK_METHOD3(onMessageReceived, void(const std::string&, const std::string&, const ClientType& l_type));
-    MOCK_METHOD1(onServerMessageReceived, void(const std::string&));
+    MOCK_METHOD3(onMessageReceived, void(std::string_view, std::string_view, const ClientType& l_type));
+    MOCK_METHOD1(onServerMessageReceived, void(std::string_view));
     MOCK_METHOD0(onKick, void());
     MOCK_METHOD2(onPromotion, void(const std::string&, const bool&));
-    MOCK_METHOD2(onConnectionNotificationReceived, void(const std::string&, const Type&));
+    MOCK_METHOD2(onConnectionNotificationReceived, void(std::string_view, const Type&));
     MOCK_METHOD0(onServerExit, void());
+    MOCK_METHOD2(onChannelJoined, void(std::string_view, const sf::Uint32&));
+    MOCK_METHOD1(onChannelLeft, void(std::string_view));
+    MOCK_METHOD4(onChannelMessageReceived, void(std::string_view, std::string_view, std::string_view, const ClientType& l_type));
+    MOCK_METHOD3(onDirectMessageReceived, void(std::string_view, std::string_view, const ClientType& l_type));
+    MOCK_METHOD1(onUnknownRecipient, void(std::string_view));
 };
 
 class ServerClientTest : public testing::Test
 {
     virtual void SetUp(){
         t_server = nullptr;
+        m_network = std::make_shared<MemoryNetwork>();
+        m_calls = 0;
     }
     virtual void TearDown(){
-        for(auto& itr : m_clients){
-            if(itr.second){
-                if(itr.second->joinable()) itr.second->join();
-                delete itr.second;
-            }
-             delete itr.first;
+        // clients leave first, the server stops once it has seen every one of them go
+        for(size_t i = 0; i < m_clients.size(); ++i){
+            stopClient(i);
+            delete m_clients[i].first;
         }
         m_clients.clear();
 
-
-        if(t_server->joinable()) t_server->join();
-        delete t_server;
+        if(t_server){
+            EXPECT_TRUE(waitFor([this](){ return m_server.getStats().m_connected == 0; }));
+            m_server.quit();
+            if(t_server->joinable()) t_server->join();
+            delete t_server;
+        }
     }
 protected:
     MockServer m_server;
     std::thread* t_server;
+    /// sessions run over in-memory pipes, reset it before starting the server to go over tcp
+    std::shared_ptr<MemoryNetwork> m_network;
     std::vector<std::pair<MockClient*, std::thread*>> m_clients;
+    /// calls made by the expectations given counted(), for waitFor() to wait on
+    std::atomic<int> m_calls;
+
+    auto counted(){
+        return testing::InvokeWithoutArgs([this](){ ++m_calls; });
+    }
+    bool waitForCalls(const int& l_calls){
+        return waitFor([this, l_calls](){ return m_calls == l_calls; });
+    }
+    /// until l_clients are connected and done logging in
+    bool waitForLogins(const sf::Uint32& l_clients){
+        return waitFor([this, l_clients](){
+            ServerStats stats = m_server.getStats();
+            return stats.m_connected == l_clients && stats.m_handshaking == 0;
+        });
+    }
 
     void startServer(const sf::Uint16& l_port,
-                     const std::chrono::milliseconds& time = 100ms,
                      const sf::Uint32& l_max = -1,
                      const std::string& l_password = ""){
         m_server.setPort(l_port);
         m_server.setPassword(l_password);
         m_server.setMaxNumberOfClients(l_max);
+        if(m_network){
+            m_server.setListener(std::make_unique<MemoryListener>(m_network));
+        }
         t_server = new std::thread(&MockServer::run, &m_server);
-        std::thread([&](){ std::this_thread::sleep_for(time); m_server.quit();}).detach();
     }
     bool startClient(const sf::Uint16& l_port,
                      const sf::IpAddress& l_ip,
                      const std::string& l_nick,
-                     const std::chrono::milliseconds& time = 200ms,
                      const bool& l_run = false,
-                     const std::string& l_password = ""){
+                     const std::string& l_password = "",
+                     const Protocol& l_protocol = Protocol::V2){
         m_clients.emplace_back(std::make_pair(new MockClient, nullptr));
         m_clients.back().first->setNickname(l_nick);
+        m_clients.back().first->setProtocol(l_protocol);
+        if(m_network){
+            m_clients.back().first->setTransport(m_network);
+        }
         Status status = m_clients.back().first->connect(l_port, l_ip, l_password);
         if(l_run && status == Status::Connected){
             m_clients.back().second = new std::thread(&MockClient::run, m_clients.back().first);
-            std::thread([&time](MockClient* client){ std::this_thread::sleep_for(time); client->quit();}, m_clients.back().first).detach();
             return true;
         }
         return false;
     }
+    /// quits a running client and waits for it, the client itself stays for its expectations
+    void stopClient(const size_t& l_index){
+        auto& client = m_clients[l_index];
+        if(client.second){
+            client.first->quit();
+            if(client.second->joinable()) client.second->join();
+            delete client.second;
+            client.second = nullptr;
+        }
+    }
 };
 
 TEST_F(ServerClientTest, ConnectingAndDisconnecting)
 {
     EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(1);
     EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(1);
-    startServer(53000, 25ms);
+    startServer(53000);
+    startClient(53000, "localhost", "marcin");
+    EXPECT_TRUE(waitForLogins(1));
+}
+
+TEST_F(ServerClientTest, ConnectingOverTcp)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(1);
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(1);
+    m_network.reset();
+    startServer(53000);
     startClient(53000, "localhost", "marcin");
+    EXPECT_TRUE(waitForLogins(1));
 }
 
 TEST_F(ServerClientTest, ConnectingToServerWithAPassword)
 {
     EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(1);
     EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(1);
-    startServer(53000, 25ms, -1, "pass");
-    startClient(53000, "localhost", "marcin", 0ms, false, "pass");
+    startServer(53000, -1, "pass");
+    startClient(53000, "localhost", "marcin", false, "pass");
+    EXPECT_TRUE(waitForLogins(1));
 }
 
 TEST_F(ServerClientTest, SendingMessages)
 {
     EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
     EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
-    EXPECT_CALL(m_server, onClientMessageReceived(testing::_, "siema"));
-    startServer(53000, 350ms);
-    EXPECT_TRUE(startClient(53000, "localhost", "marcin", 150ms, true));
+    EXPECT_CALL(m_server, onClientMessageReceived(testing::_, "siema"sv));
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
 
-    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived("nelnir", Type::Connection));
+    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived("nelnir"sv, Type::Connection)).WillOnce(counted());
 
-    EXPECT_TRUE(startClient(53000, "localhost", "nelnir", 250ms, true));
+    EXPECT_TRUE(startClient(53000, "localhost", "nelnir", true));
 
-    EXPECT_CALL(*m_clients.back().first, onMessageReceived("siema", "marcin", testing::_));
-    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived("marcin", Type::Disconnection));
+    EXPECT_CALL(*m_clients.back().first, onMessageReceived("siema"sv, "marcin"sv, testing::_)).WillOnce(counted());
+    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived("marcin"sv, Type::Disconnection)).WillOnce(counted());
 
+    EXPECT_TRUE(waitForLogins(2));
     m_clients.front().first->sendToServer("siema");
+    EXPECT_TRUE(waitForCalls(2));
+    stopClient(0);
+    EXPECT_TRUE(waitForCalls(3));
+}
+
+TEST_F(ServerClientTest, NamingSendersThatJoinedEarlier)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientMessageReceived(testing::_, testing::_)).Times(3);
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
+    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived(testing::_, testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(*m_clients.back().first, onMessageReceived(testing::_, testing::_, testing::_)).Times(testing::AnyNumber());
+
+    EXPECT_TRUE(startClient(53000, "localhost", "nelnir", true));
+    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived(testing::_, testing::_)).Times(testing::AnyNumber());
+    {
+        // the messages wait for the one lookup, then come in order
+        testing::InSequence sequence;
+        EXPECT_CALL(*m_clients.back().first, onMessageReceived("first"sv, "marcin"sv, testing::_)).WillOnce(counted());
+        EXPECT_CALL(*m_clients.back().first, onMessageReceived("second"sv, "marcin"sv, testing::_)).WillOnce(counted());
+        EXPECT_CALL(*m_clients.back().first, onMessageReceived("third"sv, "marcin"sv, testing::_)).WillOnce(counted());
+    }
+
+    EXPECT_TRUE(waitForLogins(2));
+    m_clients.front().first->sendToServer("first");
+    m_clients.front().first->sendToServer("second");
+    m_clients.front().first->sendToServer("third");
+    EXPECT_TRUE(waitForCalls(3));
+    EXPECT_EQ(m_server.getMetrics().m_packetsIn[packetKind(Opcode::Member)], 1u);
 }
 
 TEST_F(ServerClientTest, RecevingMessageFromServer)
 {
     EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
     EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
-    startServer(53000, 250ms);
-    EXPECT_TRUE(startClient(53000, "localhost", "marcin", 150ms, true));
-    EXPECT_CALL(*m_clients.front().first, onServerMessageReceived("testing"));
-    EXPECT_CALL(*m_clients.front().first, onServerExit()).Times(testing::AnyNumber());
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
+    EXPECT_CALL(*m_clients.front().first, onServerMessageReceived("testing"sv)).WillOnce(counted());
 
+    EXPECT_TRUE(waitForLogins(1));
     m_server.sendMessageToAllClients("testing");
+    EXPECT_TRUE(waitForCalls(1));
 }
 
 TEST_F(ServerClientTest, PromotingClients)
@@ -149,13 +252,239 @@ TEST_F(ServerClientTest, PromotingClients)
     EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
     EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
 
-    startServer(53000, 250ms);
+    startServer(53000);
     EXPECT_CALL(m_server, onClientPromoted(testing::_, testing::_)).Times(testing::AnyNumber());
 
-    EXPECT_TRUE(startClient(53000, "localhost", "marcin", 150ms, true));
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
     EXPECT_EQ(m_clients.front().first->getType(), ClientType::Normie);
-    EXPECT_CALL(*m_clients.front().first, onPromotion(testing::_, true));
+    EXPECT_CALL(*m_clients.front().first, onPromotion(testing::_, true)).WillOnce(counted());
+    EXPECT_TRUE(waitForLogins(1));
     m_server.promote("localhost", ClientType::Administrator);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // the client takes its new type before it reports the promotion
+    EXPECT_TRUE(waitForCalls(1));
     EXPECT_EQ(m_clients.front().first->getType(), ClientType::Administrator);
 }
+
+TEST_F(ServerClientTest, KickingAndPromotingSkipHandshakingClients)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientPromoted(testing::_, testing::_)).Times(0);
+    startServer(53000, -1, "pass");
+    auto connection = m_network->connect("127.0.0.1", 53000, sf::seconds(1));
+    ASSERT_NE(connection, nullptr);
+    sf::Packet packet;
+    Type type;
+    ASSERT_EQ(connection->receive(packet), sf::Socket::Done);
+    packet >> type;
+    EXPECT_EQ(type, Type::ServerPasswordNeeded);
+
+    // waiting for the password, the peer is not a client the console can reach yet
+    EXPECT_FALSE(m_server.kick("127.0.0.1", false));
+    EXPECT_FALSE(m_server.promote("127.0.0.1", ClientType::Administrator));
+    connection->setBlocking(false);
+    EXPECT_EQ(connection->receive(packet), sf::Socket::NotReady);
+
+    // and its login goes on as if nothing happened
+    connection->setBlocking(true);
+    Frame password = encode(toServer::Password{"pass"});
+    std::size_t sent = 0;
+    ASSERT_EQ(connection->send(password->data(), password->size(), sent), sf::Socket::Done);
+    packet.clear();
+    ASSERT_EQ(connection->receive(packet), sf::Socket::Done);
+    packet >> type;
+    EXPECT_EQ(type, Type::ServerConnected);
+    connection->disconnect();
+}
+
+TEST_F(ServerClientTest, CountingClients)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientPromoted(testing::_, testing::_)).Times(testing::AnyNumber());
+
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
+    EXPECT_CALL(*m_clients.front().first, onPromotion(testing::_, testing::_)).Times(testing::AnyNumber());
+    EXPECT_TRUE(waitForLogins(1));
+    ServerStats stats = m_server.getStats();
+    EXPECT_EQ(stats.m_connected, 1u);
+    EXPECT_EQ(stats.m_handshaking, 0u);
+    EXPECT_EQ(stats.m_normies, 1u);
+
+    m_server.promote("marcin", ClientType::Administrator);
+    stats = m_server.getStats();
+    EXPECT_EQ(stats.m_normies, 0u);
+    EXPECT_EQ(stats.m_administrators, 1u);
+
+    stopClient(0);
+    EXPECT_TRUE(waitFor([this](){ return m_server.getStats().m_connected == 0; }));
+    stats = m_server.getStats();
+    EXPECT_EQ(stats.m_connected, 0u);
+    EXPECT_EQ(stats.m_administrators, 0u);
+}
+
+TEST_F(ServerClientTest, MixingProtocolVersions)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientMessageReceived(testing::_, "siema"sv)).Times(2);
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true, "", Protocol::V1));
+    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived(testing::_, testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(*m_clients.back().first, onMessageReceived("siema"sv, "nelnir"sv, testing::_)).WillOnce(counted());
+
+    EXPECT_TRUE(startClient(53000, "localhost", "nelnir", true));
+    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived(testing::_, testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(*m_clients.back().first, onMessageReceived("siema"sv, "marcin"sv, testing::_)).WillOnce(counted());
+
+    EXPECT_TRUE(waitForLogins(2));
+    auto v2 = m_clients.back().first;
+    EXPECT_TRUE(waitFor([v2](){ return v2->getProtocol() == Protocol::V2; }));
+    EXPECT_EQ(m_clients.front().first->getProtocol(), Protocol::V1);
+    m_clients.front().first->sendToServer("siema");
+    m_clients.back().first->sendToServer("siema");
+    EXPECT_TRUE(waitForCalls(2));
+}
+
+TEST_F(ServerClientTest, ReplayingHistoryOnJoin)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientMessageReceived(testing::_, "siema"sv)).WillOnce(counted());
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
+    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived(testing::_, testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(*m_clients.back().first, onServerMessageReceived("testing"sv)).WillOnce(counted());
+    m_clients.back().first->sendToServer("siema");
+    EXPECT_TRUE(waitForCalls(1));
+    m_server.sendMessageToAllClients("testing");
+    EXPECT_TRUE(waitForCalls(2));
+
+    EXPECT_TRUE(startClient(53000, "localhost", "nelnir", true));
+    EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived(testing::_, testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(*m_clients.back().first, onMessageReceived("siema"sv, "marcin"sv, testing::_)).WillOnce(counted());
+    EXPECT_CALL(*m_clients.back().first, onServerMessageReceived("testing"sv)).WillOnce(counted());
+    EXPECT_TRUE(waitForCalls(4));
+}
+
+TEST_F(ServerClientTest, ChannelMessagesReachOnlyMembers)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    startServer(53000);
+    for(auto nick : {"marcin", "nelnir", "other"}){
+        EXPECT_TRUE(startClient(53000, "localhost", nick, true));
+        EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived(testing::_, testing::_)).Times(testing::AnyNumber());
+    }
+    auto sender = m_clients[0].first, member = m_clients[1].first, outsider = m_clients[2].first;
+    EXPECT_CALL(*sender, onChannelJoined("room"sv, 1u)).WillOnce(counted());
+    EXPECT_CALL(*member, onChannelJoined("room"sv, 2u)).WillOnce(counted());
+    EXPECT_CALL(*member, onChannelMessageReceived("room"sv, "siema"sv, "marcin"sv, testing::_)).WillOnce(counted());
+    EXPECT_CALL(*sender, onChannelMessageReceived(testing::_, testing::_, testing::_, testing::_)).Times(0);
+    EXPECT_CALL(*outsider, onChannelMessageReceived(testing::_, testing::_, testing::_, testing::_)).Times(0);
+
+    EXPECT_TRUE(waitForLogins(3));
+    sender->joinChannel("room");
+    EXPECT_TRUE(waitForCalls(1));
+    member->joinChannel("room");
+    EXPECT_TRUE(waitForCalls(2));
+    auto channels = m_server.getChannels();
+    ASSERT_EQ(channels.size(), 1u);
+    EXPECT_EQ(channels.front().second, 2u);
+    sender->sendToChannel("room", "siema");
+    EXPECT_TRUE(waitForCalls(3));
+    // members are gone once their clients quit
+    stopClient(0);
+    stopClient(1);
+    EXPECT_TRUE(waitFor([this](){ return m_server.getChannels().empty(); }));
+}
+
+TEST_F(ServerClientTest, DirectMessagesReachOnlyTheRecipient)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    startServer(53000);
+    for(auto nick : {"marcin", "nelnir", "other"}){
+        EXPECT_TRUE(startClient(53000, "localhost", nick, true));
+        EXPECT_CALL(*m_clients.back().first, onConnectionNotificationReceived(testing::_, testing::_)).Times(testing::AnyNumber());
+    }
+    auto sender = m_clients[0].first, recipient = m_clients[1].first, outsider = m_clients[2].first;
+    EXPECT_CALL(*recipient, onDirectMessageReceived("siema"sv, "marcin"sv, testing::_)).WillOnce(counted());
+    EXPECT_CALL(*outsider, onDirectMessageReceived(testing::_, testing::_, testing::_)).Times(0);
+    EXPECT_CALL(*sender, onUnknownRecipient("nobody"sv)).WillOnce(counted());
+    EXPECT_TRUE(waitForLogins(3));
+    sender->sendDirectMessage("nelnir", "siema");
+    sender->sendDirectMessage("nobody", "siema");
+    EXPECT_TRUE(waitForCalls(2));
+}
+
+TEST_F(ServerClientTest, ThrottlingFloodingClients)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    // the name sent while logging in is not metered, the three tokens are all for messages
+    RateLimits limits;
+    limits.m_messages = RateLimit(1, 3);
+    m_server.setConnectionLimits(limits);
+    EXPECT_CALL(m_server, onClientMessageReceived(testing::_, "spam"sv)).Times(3);
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
+    for(int i = 0; i < 5; ++i){
+        m_clients.back().first->sendToServer("spam");
+    }
+    EXPECT_TRUE(waitFor([this](){ return m_server.getStats().m_throttledMessages == 2; }));
+}
+
+TEST_F(ServerClientTest, ThrottledPacketsCostNoTokens)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    RateLimits limits;
+    limits.m_messages = RateLimit(1, 3);
+    limits.m_bytes = RateLimit(1, 32);
+    m_server.setConnectionLimits(limits);
+    EXPECT_CALL(m_server, onClientMessageReceived(testing::_, "spam"sv)).Times(3).WillRepeatedly(counted());
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
+    // too big for the byte bucket, the message bucket keeps its tokens
+    m_clients.back().first->sendToServer(std::string(64, 'x'));
+    for(int i = 0; i < 3; ++i){
+        m_clients.back().first->sendToServer("spam");
+    }
+    EXPECT_TRUE(waitForCalls(3));
+    ServerStats stats = m_server.getStats();
+    EXPECT_EQ(stats.m_throttledBytes, 1u);
+    EXPECT_EQ(stats.m_throttledMessages, 0u);
+}
+
+TEST_F(ServerClientTest, BlockingAddressRanges)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(0);
+    EXPECT_CALL(m_server, onClientBlocked("127.0.0.1"));
+    EXPECT_FALSE(m_server.block("127.0.0/8"));
+    EXPECT_TRUE(m_server.block("127.0.0.0/8"));
+    EXPECT_TRUE(m_server.isBlocked("127.0.0.1"));
+    startServer(53000);
+    EXPECT_FALSE(startClient(53000, "localhost", "marcin"));
+}
+
+TEST_F(ServerClientTest, CountingPacketsInMetrics)
+{
+    EXPECT_CALL(m_server, onClientConnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientDisconnected(testing::_)).Times(testing::AnyNumber());
+    EXPECT_CALL(m_server, onClientMessageReceived(testing::_, "counted"sv)).Times(2).WillRepeatedly(counted());
+    startServer(53000);
+    EXPECT_TRUE(startClient(53000, "localhost", "marcin", true));
+    m_clients.back().first->sendToServer("counted");
+    m_clients.back().first->sendToServer("counted");
+    EXPECT_TRUE(waitForCalls(2));
+    MetricsSnapshot metrics = m_server.getMetrics();
+    EXPECT_EQ(metrics.m_accepted, 1u);
+    EXPECT_EQ(metrics.m_connected, 1u);
+    // the login packet counts as a Message too
+    EXPECT_EQ(metrics.m_packetsIn[static_cast<size_t>(Type::Message)] + metrics.m_packetsIn[packetKind(Opcode::Message)], 3u);
+    EXPECT_EQ(metrics.m_packetsOut[static_cast<size_t>(Type::ServerConnected)], 1u);
+    EXPECT_GT(metrics.m_bytesIn, 0u);
+    EXPECT_GT(metrics.m_loop.m_count, 0u);
+}
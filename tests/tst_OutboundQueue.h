@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "outboundqueue.h"
+#include <string>
+#include <vector>
+
+class OutboundQueueTest : public testing::Test
+{
+    virtual void SetUp(){
+        ASSERT_EQ(m_listener.listen(53001), sf::Socket::Done);
+        ASSERT_EQ(m_receiver.connect("localhost", 53001, sf::seconds(1)), sf::Socket::Done);
+        ASSERT_EQ(m_listener.accept(m_sender), sf::Socket::Done);
+    }
+    virtual void TearDown(){
+        m_sender.disconnect();
+        m_receiver.disconnect();
+        m_listener.close();
+    }
+protected:
+    sf::TcpListener m_listener;
+    sf::TcpSocket m_sender;
+    sf::TcpSocket m_receiver;
+
+    Frame frameOf(const Type& l_type, const std::string& l_text){
+        sf::Packet packet;
+        packet << l_type << l_text;
+        return makeFrame(packet);
+    }
+    std::vector<std::string> receive(const size_t& l_count){
+        std::vector<std::string> texts;
+        for(size_t i = 0; i < l_count; ++i){
+            sf::Packet packet;
+            Type type;
+            std::string text;
+            if(m_receiver.receive(packet) != sf::Socket::Done) break;
+            packet >> type >> text;
+            texts.push_back(text);
+        }
+        return texts;
+    }
+};
+
+TEST_F(OutboundQueueTest, FlushWritesFramesInOrder)
+{
+    OutboundQueue queue(4);
+    EXPECT_TRUE(queue.push(frameOf(Type::Message, "first"), SlowConsumerPolicy::Disconnect));
+    EXPECT_TRUE(queue.push(frameOf(Type::Message, "second"), SlowConsumerPolicy::Disconnect));
+    EXPECT_EQ(queue.flush(m_sender), sf::Socket::Done);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.bytes(), 0u);
+    EXPECT_EQ(receive(2), std::vector<std::string>({"first", "second"}));
+}
+
+TEST_F(OutboundQueueTest, DisconnectPolicyRejectsWhenFull)
+{
+    OutboundQueue queue(2);
+    EXPECT_TRUE(queue.push(frameOf(Type::Message, "a"), SlowConsumerPolicy::Disconnect));
+    EXPECT_TRUE(queue.push(frameOf(Type::Message, "b"), SlowConsumerPolicy::Disconnect));
+    EXPECT_FALSE(queue.push(frameOf(Type::Message, "c"), SlowConsumerPolicy::Disconnect));
+    EXPECT_EQ(queue.size(), 2u);
+}
+
+TEST_F(OutboundQueueTest, DropOldestKeepsNewestFrames)
+{
+    OutboundQueue queue(2);
+    queue.push(frameOf(Type::Message, "a"), SlowConsumerPolicy::DropOldest);
+    queue.push(frameOf(Type::Message, "b"), SlowConsumerPolicy::DropOldest);
+    EXPECT_TRUE(queue.push(frameOf(Type::Message, "c"), SlowConsumerPolicy::DropOldest));
+    EXPECT_EQ(queue.size(), 2u);
+    EXPECT_EQ(queue.dropped(), 1u);
+    EXPECT_EQ(queue.flush(m_sender), sf::Socket::Done);
+    EXPECT_EQ(receive(2), std::vector<std::string>({"b", "c"}));
+}
+
+TEST_F(OutboundQueueTest, ConflateReplacesFrameOfTheSameType)
+{
+    OutboundQueue queue(2);
+    queue.push(frameOf(Type::Message, "old"), SlowConsumerPolicy::Conflate);
+    queue.push(frameOf(Type::ServerMessage, "server"), SlowConsumerPolicy::Conflate);
+    EXPECT_TRUE(queue.push(frameOf(Type::Message, "new"), SlowConsumerPolicy::Conflate));
+    EXPECT_EQ(queue.size(), 2u);
+    EXPECT_EQ(queue.flush(m_sender), sf::Socket::Done);
+    EXPECT_EQ(receive(2), std::vector<std::string>({"new", "server"}));
+}
+
+TEST_F(OutboundQueueTest, ConflateReplacesCompactFrameOfTheSameOpcode)
+{
+    auto compact = [](const Opcode& l_opcode, const sf::Uint32& l_sender, const std::string& l_text){
+        FrameWriter writer;
+        writer << l_opcode;
+        if(l_opcode == Opcode::Message){
+            writer.varint(l_sender);
+        }
+        writer.text(l_text);
+        return writer.finish();
+    };
+    OutboundQueue queue(2);
+    queue.push(compact(Opcode::Message, 1, "old"), SlowConsumerPolicy::Conflate);
+    queue.push(compact(Opcode::ServerMessage, 0, "server"), SlowConsumerPolicy::Conflate);
+    // another sender, the same kind of frame
+    EXPECT_TRUE(queue.push(compact(Opcode::Message, 2, "new"), SlowConsumerPolicy::Conflate));
+    EXPECT_EQ(queue.size(), 2u);
+    EXPECT_EQ(queue.flush(m_sender), sf::Socket::Done);
+
+    sf::Packet packet;
+    ASSERT_EQ(m_receiver.receive(packet), sf::Socket::Done);
+    PacketReader reader(packet);
+    Opcode opcode;
+    sf::Uint32 sender = 0;
+    std::string_view text;
+    reader >> opcode;
+    reader.varint(sender).text(text);
+    EXPECT_EQ(opcode, Opcode::Message);
+    EXPECT_EQ(sender, 2u);
+    EXPECT_EQ(text, "new");
+}
+
+TEST_F(OutboundQueueTest, CorkedFlushGathersLongBacklog)
+{
+    OutboundQueue queue(200);
+    std::vector<std::string> texts;
+    for(int i = 0; i < 150; ++i){
+        texts.push_back(std::to_string(i));
+        EXPECT_TRUE(queue.push(frameOf(Type::Message, texts.back()), SlowConsumerPolicy::Disconnect));
+    }
+    EXPECT_EQ(queue.flush(m_sender, true), sf::Socket::Done);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(receive(150), texts);
+}
@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+#include "server.h"
+
+TEST(PacketReaderTest, ReadingWhatPacketWrote)
+{
+    sf::Packet packet;
+    packet << Type::Message << ClientType::Administrator << std::string("marcin") << std::string("siema") << true;
+
+    PacketReader reader(packet);
+    Type type;
+    ClientType clientType;
+    std::string_view name, text;
+    bool flag = false;
+    EXPECT_TRUE(reader >> type >> clientType >> name >> text >> flag);
+    EXPECT_EQ(type, Type::Message);
+    EXPECT_EQ(clientType, ClientType::Administrator);
+    EXPECT_EQ(name, "marcin");
+    EXPECT_EQ(text, "siema");
+    EXPECT_TRUE(flag);
+    EXPECT_TRUE(reader.endOfPacket());
+    // the views point into the packet, nothing was copied
+    EXPECT_GE(text.data(), static_cast<const char*>(packet.getData()));
+    EXPECT_LT(text.data(), static_cast<const char*>(packet.getData()) + packet.getDataSize());
+
+    std::string_view missing;
+    EXPECT_FALSE(reader >> missing);
+}
+
+TEST(PacketReaderTest, FrameWriterMatchesPacketLayout)
+{
+    sf::Packet packet;
+    packet << Type::Message << ClientType::Normie << std::string("marcin") << std::string("siema");
+
+    FrameWriter writer;
+    writer << Type::Message << ClientType::Normie << std::string("marcin") << std::string_view("siema");
+    EXPECT_EQ(*writer.finish(), *makeFrame(packet));
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "slabpool.h"
+#include "server.h"
+#include <chrono>
+#include <thread>
+
+TEST(SlabPoolTest, RecyclingSlots)
+{
+    SlabPool<std::string, 4> pool;
+    void* first = pool.allocate();
+    void* second = pool.allocate();
+    EXPECT_NE(first, second);
+    EXPECT_EQ(pool.inUse(), 2u);
+    EXPECT_EQ(pool.capacity(), 4u);
+
+    pool.deallocate(first);
+    EXPECT_EQ(pool.allocate(), first);
+
+    for(int i = 0; i < 3; ++i){
+        pool.allocate();
+    }
+    EXPECT_EQ(pool.capacity(), 8u);
+    EXPECT_EQ(pool.inUse(), 5u);
+}
+
+TEST(SlabPoolTest, ClientRecordsComeFromThePool)
+{
+    auto& pool = ClientServerData::pool();
+    size_t used = pool.inUse();
+    void* address;
+    {
+        auto client = std::make_unique<ClientServerData>();
+        address = client.get();
+        EXPECT_EQ(pool.inUse(), used + 1);
+    }
+    EXPECT_EQ(pool.inUse(), used);
+    auto client = std::make_unique<ClientServerData>();
+    EXPECT_EQ(client.get(), address);
+}
+
+TEST(SlabPoolTest, AcceptedSocketsComeFromThePool)
+{
+    auto& pool = PooledTcpConnection::pool();
+    size_t used = pool.inUse();
+    TcpListener listener;
+    ASSERT_TRUE(listener.listen(53001));
+    sf::TcpSocket peer;
+    ASSERT_EQ(peer.connect("127.0.0.1", 53001, sf::seconds(1)), sf::Socket::Done);
+    PeerAddress address;
+    for(int i = 0; i < 100 && !listener.accept(address); ++i){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    {
+        std::unique_ptr<Connection> connection = listener.adopt();
+        EXPECT_EQ(pool.inUse(), used + 1);
+    }
+    EXPECT_EQ(pool.inUse(), used);
+    listener.close();
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "tracing.h"
+#include <string>
+#include <thread>
+
+namespace
+{
+    size_t countThreads(const std::string& l_json)
+    {
+        size_t count = 0;
+        for(size_t at = l_json.find("thread_name"); at != std::string::npos; at = l_json.find("thread_name", at + 1)){
+            ++count;
+        }
+        return count;
+    }
+}
+
+TEST(TracingTest, RecordsNothingWhileOff)
+{
+    Tracer tracer;
+    EXPECT_EQ(tracer.begin(), 0u);
+    tracer.record(TracePoint::Enqueue, 1);
+    EXPECT_EQ(tracer.currentPacket(), 0u);
+    EXPECT_EQ(tracer.toJson().find("\"ph\":\"i\""), std::string::npos);
+}
+
+TEST(TracingTest, ExportsPacketsSeenByManyThreads)
+{
+    Tracer tracer;
+    tracer.setCapacity(4);
+    std::uint64_t packet = tracer.begin();
+    ASSERT_NE(packet, 0u);
+    EXPECT_EQ(tracer.currentPacket(), packet);
+    tracer.record(TracePoint::HandlerEnter, packet);
+    tracer.record(TracePoint::HandlerExit, packet);
+    std::thread([&tracer, packet](){
+        tracer.record(TracePoint::Enqueue, packet);
+        tracer.record(TracePoint::Flush, packet);
+    }).join();
+    Tracer::setCurrent(0);
+
+    std::string json = tracer.toJson();
+    EXPECT_NE(json.find("\"ph\":\"B\",\"name\":\"handler\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"flush\",\"pid\":1,\"tid\":2"), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"b\",\"cat\":\"packet\""), std::string::npos);
+
+    // the ring keeps only the newest events
+    for(int i = 0; i < 4; ++i){
+        tracer.record(TracePoint::Decode, packet + 1);
+    }
+    EXPECT_EQ(tracer.toJson().find("\"name\":\"receive\""), std::string::npos);
+}
+
+TEST(TracingTest, AlternatingTracersKeepOneRingPerThread)
+{
+    Tracer first, second;
+    first.setCapacity(4);
+    second.setCapacity(4);
+    for(int i = 0; i < 10; ++i){
+        first.record(TracePoint::Decode, 1);
+        second.record(TracePoint::Decode, 1);
+    }
+    std::thread([&first](){ first.record(TracePoint::Flush, 1); }).join();
+
+    EXPECT_EQ(countThreads(first.toJson()), 2u);
+    EXPECT_EQ(countThreads(second.toJson()), 1u);
+}